@@ -0,0 +1,287 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "arena.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#define POOL_ALIGN 64
+
+// Счетчики ведет каждый поток в своем TLS: общая кэш-линия с атомарными
+// сложениями на каждое выделение свела бы на нет смысл арены потока.
+// Живые потоки связаны в список для AllocStatsGet, итог завершившегося
+// переносится в retired_stats
+struct ThreadStats {
+  struct AllocStats counts;
+  struct ThreadStats *prev;
+  struct ThreadStats *next;
+};
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ThreadStats *live_stats;
+static struct AllocStats retired_stats;
+static pthread_key_t stats_key;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static __thread struct ThreadStats thread_stats;
+static __thread int thread_stats_ready;
+
+static void AddStats(struct AllocStats *dst, const struct AllocStats *src) {
+  dst->arena_allocs += __atomic_load_n(&src->arena_allocs, __ATOMIC_RELAXED);
+  dst->arena_bytes += __atomic_load_n(&src->arena_bytes, __ATOMIC_RELAXED);
+  dst->pool_allocs += __atomic_load_n(&src->pool_allocs, __ATOMIC_RELAXED);
+  dst->system_allocs += __atomic_load_n(&src->system_allocs, __ATOMIC_RELAXED);
+  dst->system_bytes += __atomic_load_n(&src->system_bytes, __ATOMIC_RELAXED);
+}
+
+static void RetireThreadStats(void *arg) {
+  struct ThreadStats *t = arg;
+  pthread_mutex_lock(&stats_mutex);
+  AddStats(&retired_stats, &t->counts);
+  if (t->prev != NULL)
+    t->prev->next = t->next;
+  else
+    live_stats = t->next;
+  if (t->next != NULL) t->next->prev = t->prev;
+  pthread_mutex_unlock(&stats_mutex);
+  // Выделения из деструкторов, отработавших позже, заведут счетчики заново
+  t->counts = (struct AllocStats){0};
+  thread_stats_ready = 0;
+}
+
+static void CreateStatsKey(void) {
+  pthread_key_create(&stats_key, RetireThreadStats);
+}
+
+static struct ThreadStats *LocalStats(void) {
+  if (!thread_stats_ready) {
+    pthread_once(&stats_once, CreateStatsKey);
+    pthread_mutex_lock(&stats_mutex);
+    thread_stats.prev = NULL;
+    thread_stats.next = live_stats;
+    if (live_stats != NULL) live_stats->prev = &thread_stats;
+    live_stats = &thread_stats;
+    pthread_mutex_unlock(&stats_mutex);
+    pthread_setspecific(stats_key, &thread_stats);
+    thread_stats_ready = 1;
+  }
+  return &thread_stats;
+}
+
+// Пишет только свой поток: обычная запись, атомарная лишь для читателя
+#define COUNT(field, n)                                           \
+  do {                                                             \
+    uint64_t *counter_ = &LocalStats()->counts.field;              \
+    __atomic_store_n(counter_, *counter_ + (n), __ATOMIC_RELAXED); \
+  } while (0)
+
+/* Арена */
+
+// Заголовок блока; данные начинаются с кэш-линии после него
+struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t size;
+};
+
+#define BLOCK_HEADER POOL_ALIGN
+
+static uint8_t *BlockData(struct ArenaBlock *block) {
+  return (uint8_t *)block + BLOCK_HEADER;
+}
+
+void ArenaInit(struct Arena *arena, size_t block_size) {
+  arena->first = NULL;
+  arena->last = NULL;
+  arena->current = NULL;
+  arena->cur = NULL;
+  arena->end = NULL;
+  arena->block_size = block_size > 0 ? block_size : ARENA_BLOCK_SIZE;
+}
+
+static void Enter(struct Arena *arena, struct ArenaBlock *block) {
+  arena->current = block;
+  arena->cur = BlockData(block);
+  arena->end = arena->cur + block->size;
+}
+
+// Следующий свободный блок, где поместится need байт. Пропущенные
+// маленькие блоки простаивают до ближайшего ArenaRewind
+static int NextBlock(struct Arena *arena, size_t need) {
+  struct ArenaBlock *block = arena->current ? arena->current->next : arena->first;
+  while (block != NULL && block->size < need) block = block->next;
+  if (block == NULL) {
+    size_t size = need > arena->block_size ? need : arena->block_size;
+    void *memory;
+    if (posix_memalign(&memory, POOL_ALIGN, BLOCK_HEADER + size) != 0) return -1;
+    COUNT(system_allocs, 1);
+    COUNT(system_bytes, BLOCK_HEADER + size);
+    block = memory;
+    block->next = NULL;
+    block->size = size;
+    if (arena->last != NULL)
+      arena->last->next = block;
+    else
+      arena->first = block;
+    arena->last = block;
+  }
+  Enter(arena, block);
+  return 0;
+}
+
+static uint8_t *AlignUp(uint8_t *p, size_t align) {
+  return (uint8_t *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+void *ArenaAlloc(struct Arena *arena, size_t size, size_t align) {
+  if (align == 0) align = ARENA_ALIGN;
+  uint8_t *p = AlignUp(arena->cur, align);
+  if (arena->current == NULL || p > arena->end || size > (size_t)(arena->end - p)) {
+    // Данные блока выровнены по кэш-линии, больший сдвиг добавляем к размеру
+    if (NextBlock(arena, size + (align > POOL_ALIGN ? align : 0)) < 0) return NULL;
+    p = AlignUp(arena->cur, align);
+  }
+  arena->cur = p + size;
+  COUNT(arena_allocs, 1);
+  COUNT(arena_bytes, size);
+  return p;
+}
+
+struct ArenaMark ArenaSave(const struct Arena *arena) {
+  struct ArenaMark mark = {arena->current, arena->cur};
+  return mark;
+}
+
+void ArenaRewind(struct Arena *arena, struct ArenaMark mark) {
+  arena->current = mark.block;
+  arena->cur = mark.cur;
+  arena->end = mark.block != NULL ? BlockData(mark.block) + mark.block->size : NULL;
+}
+
+void ArenaReset(struct Arena *arena) {
+  struct ArenaMark start = {NULL, NULL};
+  ArenaRewind(arena, start);
+}
+
+void ArenaDestroy(struct Arena *arena) {
+  struct ArenaBlock *block = arena->first;
+  while (block != NULL) {
+    struct ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  ArenaInit(arena, arena->block_size);
+}
+
+// Сама арена лежит в TLS потока; ключ нужен только для деструктора,
+// который отдает ее блоки при завершении потока
+static __thread struct Arena thread_arena;
+static __thread int thread_arena_ready;
+static pthread_key_t thread_arena_key;
+static pthread_once_t thread_arena_once = PTHREAD_ONCE_INIT;
+
+static void FreeThreadArena(void *arena) {
+  ArenaDestroy(arena);
+}
+
+static void CreateThreadArenaKey(void) {
+  pthread_key_create(&thread_arena_key, FreeThreadArena);
+}
+
+struct Arena *ArenaThread(void) {
+  if (!thread_arena_ready) {
+    pthread_once(&thread_arena_once, CreateThreadArenaKey);
+    ArenaInit(&thread_arena, ARENA_BLOCK_SIZE);
+    pthread_setspecific(thread_arena_key, &thread_arena);
+    thread_arena_ready = 1;
+  }
+  return &thread_arena;
+}
+
+/* Пул */
+
+// Заголовок сляба: слябы связаны в список для PoolDestroy
+struct Slab {
+  struct Slab *next;
+};
+
+void PoolInit(struct Pool *pool, size_t object_size, size_t per_slab) {
+  // Объект хранит указатель списка свободных и выровнен по кэш-линии
+  if (object_size < sizeof(void *)) object_size = sizeof(void *);
+  pool->object_size = (object_size + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+  pool->per_slab = per_slab > 0 ? per_slab : 1;
+  pool->free_list = NULL;
+  pool->slabs = NULL;
+  pool->in_use = 0;
+  pool->peak = 0;
+  pool->slab_count = 0;
+}
+
+static int PoolGrow(struct Pool *pool) {
+  void *memory;
+  size_t size = POOL_ALIGN + pool->object_size * pool->per_slab;
+  if (posix_memalign(&memory, POOL_ALIGN, size) != 0) return -1;
+  COUNT(system_allocs, 1);
+  COUNT(system_bytes, size);
+
+  struct Slab *slab = memory;
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->slab_count++;
+
+  // Объекты сляба нанизываются на список свободных в прямом порядке
+  uint8_t *first = (uint8_t *)memory + POOL_ALIGN;
+  for (size_t i = pool->per_slab; i-- > 0;) {
+    void *object = first + i * pool->object_size;
+    *(void **)object = pool->free_list;
+    pool->free_list = object;
+  }
+  return 0;
+}
+
+void *PoolAlloc(struct Pool *pool) {
+  if (pool->free_list == NULL && PoolGrow(pool) < 0) return NULL;
+  void *object = pool->free_list;
+  pool->free_list = *(void **)object;
+  if (++pool->in_use > pool->peak) pool->peak = pool->in_use;
+  COUNT(pool_allocs, 1);
+  return object;
+}
+
+void PoolFree(struct Pool *pool, void *object) {
+  if (object == NULL) return;
+  *(void **)object = pool->free_list;
+  pool->free_list = object;
+  pool->in_use--;
+}
+
+void PoolDestroy(struct Pool *pool) {
+  struct Slab *slab = pool->slabs;
+  while (slab != NULL) {
+    struct Slab *next = slab->next;
+    free(slab);
+    slab = next;
+  }
+  pool->slabs = NULL;
+  pool->free_list = NULL;
+  pool->in_use = 0;
+  pool->slab_count = 0;
+}
+
+/* Счетчики */
+
+void AllocStatsGet(struct AllocStats *out) {
+  pthread_mutex_lock(&stats_mutex);
+  *out = retired_stats;
+  for (struct ThreadStats *t = live_stats; t != NULL; t = t->next) AddStats(out, &t->counts);
+  pthread_mutex_unlock(&stats_mutex);
+}
+
+void AllocStatsPrint(FILE *out) {
+  struct AllocStats s;
+  AllocStatsGet(&s);
+  fprintf(out,
+          "allocations: %" PRIu64 " from arenas (%" PRIu64 " KB), %" PRIu64
+          " from pools, %" PRIu64 " system (%" PRIu64 " KB)\n",
+          s.arena_allocs, s.arena_bytes / 1024, s.pool_allocs, s.system_allocs,
+          s.system_bytes / 1024);
+}
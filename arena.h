@@ -0,0 +1,92 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Два распределителя для горячих путей, где malloc и free на каждый
+ * запрос стоят дороже самой работы и делят между потоками блокировку
+ * кучи.
+ *
+ * Арена - выделение сдвигом указателя в заранее взятых блоках. Отдельных
+ * free нет: память возвращается вся сразу через ArenaRewind к отметке или
+ * ArenaReset, а блоки остаются у арены и переиспользуются следующим
+ * запросом. У каждого потока своя арена (ArenaThread), поэтому блокировок
+ * нет вовсе.
+ *
+ * Пул - объекты одного размера. Память берется у системы слябами по
+ * нескольку десятков объектов и больше не возвращается до PoolDestroy:
+ * освобожденный объект попадает в список свободных и выдается следующим.
+ * Тысячи соединений с одинаковыми буферами не фрагментируют кучу, а
+ * выделение и освобождение стоят пару присваиваний. Пул не защищен
+ * блокировкой - им пользуется один поток.
+ */
+
+#define ARENA_ALIGN 16
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct ArenaBlock;
+
+struct Arena {
+  struct ArenaBlock *first;
+  struct ArenaBlock *last;
+  struct ArenaBlock *current;  /* NULL - еще ничего не выделено */
+  uint8_t *cur;
+  uint8_t *end;
+  size_t block_size;
+};
+
+/* Положение арены; ArenaRewind возвращает все, выделенное после него. */
+struct ArenaMark {
+  struct ArenaBlock *block;
+  uint8_t *cur;
+};
+
+void ArenaInit(struct Arena *arena, size_t block_size);
+
+/* align - степень двойки или 0 (тогда ARENA_ALIGN). Запрос больше блока
+ * получает собственный блок. NULL - не хватило памяти. */
+void *ArenaAlloc(struct Arena *arena, size_t size, size_t align);
+
+struct ArenaMark ArenaSave(const struct Arena *arena);
+void ArenaRewind(struct Arena *arena, struct ArenaMark mark);
+void ArenaReset(struct Arena *arena);
+
+/* Отдает все блоки системе. */
+void ArenaDestroy(struct Arena *arena);
+
+/* Арена текущего потока; освобождается при его завершении. */
+struct Arena *ArenaThread(void);
+
+struct Pool {
+  size_t object_size;
+  size_t per_slab;
+  void *free_list;
+  void *slabs;
+  size_t in_use;
+  size_t peak;
+  size_t slab_count;
+};
+
+void PoolInit(struct Pool *pool, size_t object_size, size_t per_slab);
+void *PoolAlloc(struct Pool *pool);
+void PoolFree(struct Pool *pool, void *object);
+void PoolDestroy(struct Pool *pool);
+
+/* Счетчики на весь процесс: сколько выделений обслужили арены и пулы и
+ * сколько раз они сами ходили в malloc. Каждый поток считает у себя,
+ * AllocStatsGet суммирует живые и завершившиеся потоки. */
+struct AllocStats {
+  uint64_t arena_allocs;
+  uint64_t arena_bytes;
+  uint64_t pool_allocs;
+  uint64_t system_allocs;
+  uint64_t system_bytes;
+};
+
+void AllocStatsGet(struct AllocStats *stats);
+void AllocStatsPrint(FILE *out);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef COMPUTE_H
+#define COMPUTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * libcompute - вычислительные ядра всех лабораторных в одном месте:
+ * минимум и максимум, сумма, произведение по модулю, их многопоточные
+ * версии и общий параллельный reduce. Собирается статической
+ * (libcompute.a) и динамической (libcompute.so) библиотекой с -O3;
+ * ядра по массивам собраны в нескольких версиях под разные наборы
+ * инструкций, нужная выбирается при загрузке программы.
+ *
+ * Число потоков 0 - по числу процессоров. Память под задания и частичные
+ * результаты берется из арены вызывающего потока (arena.h), так что
+ * повторные вызовы не ходят в malloc.
+ */
+
+struct MinMax {
+  int min;
+  int max;
+};
+
+struct SumArgs {
+  int *array;
+  int begin;
+  int end;
+};
+
+/* Заполняет массив псевдослучайными числами rand() от seed. */
+void GenerateArray(int *array, unsigned int array_size, unsigned int seed);
+
+/* Минимум и максимум array[begin..end); на пустом отрезке - INT_MAX, INT_MIN. */
+struct MinMax GetMinMax(const int *array, unsigned int begin, unsigned int end);
+
+long long Sum(const struct SumArgs *args);
+
+/* a * b mod mod для любых a, b и mod > 0. */
+uint64_t MultModulo(uint64_t a, uint64_t b, uint64_t mod);
+
+/* begin * (begin + 1) * ... * end mod mod; при begin > end - 1 % mod. */
+uint64_t ProductModulo(uint64_t begin, uint64_t end, uint64_t mod);
+
+/*
+ * Общий reduce: [0, n) делится на threads почти равных кусков, map
+ * считает частичный результат куска [begin, end) в partial (partial_size
+ * байт), combine по порядку кусков вливает очередной partial в acc.
+ * Первый кусок считается в вызывающем потоке. Итог - в result; при n == 0
+ * это map на пустом отрезке. Если потоки не создаются, их куски тоже
+ * считаются в вызывающем потоке - результат от этого не меняется.
+ */
+typedef void (*ComputeMapFn)(size_t begin, size_t end, void *partial, void *arg);
+typedef void (*ComputeCombineFn)(void *acc, const void *partial, void *arg);
+
+void ComputeParallelReduce(size_t n, int threads, size_t partial_size, ComputeMapFn map,
+                           ComputeCombineFn combine, void *arg, void *result);
+
+/* Многопоточные версии ядер поверх ComputeParallelReduce; у массивов
+ * n не больше INT_MAX, как и у однопоточных. */
+struct MinMax ParallelMinMax(const int *array, size_t n, int threads);
+long long ParallelSum(const int *array, size_t n, int threads);
+uint64_t ParallelProductModulo(uint64_t begin, uint64_t end, uint64_t mod, int threads);
+
+#endif
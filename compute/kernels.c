@@ -0,0 +1,80 @@
+#include "compute.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+// Ядра по массивам собираются в нескольких версиях; ifunc выбирает
+// подходящую процессору при загрузке, так что -march не нужен
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define COMPUTE_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define COMPUTE_CLONES
+#endif
+
+void GenerateArray(int *array, unsigned int array_size, unsigned int seed) {
+  srand(seed);
+  for (unsigned int i = 0; i < array_size; i++) {
+    array[i] = rand();
+  }
+}
+
+COMPUTE_CLONES
+struct MinMax GetMinMax(const int *array, unsigned int begin, unsigned int end) {
+  // Без ветвлений: цикл векторизуется в pminsd/pmaxsd
+  int min = INT_MAX, max = INT_MIN;
+  for (unsigned int i = begin; i < end; i++) {
+    min = array[i] < min ? array[i] : min;
+    max = array[i] > max ? array[i] : max;
+  }
+  struct MinMax min_max = {min, max};
+  return min_max;
+}
+
+COMPUTE_CLONES
+long long Sum(const struct SumArgs *args) {
+  // Сумма копится в 64 битах: в int она переполнялась уже на сотне
+  // тысяч элементов rand()
+  const int *array = args->array;
+  long long sum = 0;
+  for (int i = args->begin; i < args->end; i++) {
+    sum += array[i];
+  }
+  return sum;
+}
+
+// Модуль помещается в 32 бита - произведение остатков помещается в 64
+static inline int ModIsSmall(uint64_t m) {
+  return m <= UINT32_MAX;
+}
+
+static inline uint64_t MulMod(uint64_t a, uint64_t b, uint64_t m) {
+  if (ModIsSmall(m)) return a * b % m;
+  return (uint64_t)((unsigned __int128)a * b % m);
+}
+
+uint64_t MultModulo(uint64_t a, uint64_t b, uint64_t mod) {
+  return MulMod(a % mod, b % mod, mod);
+}
+
+// Выбор между 64- и 128-битным умножением делается один раз на весь цикл
+uint64_t ProductModulo(uint64_t begin, uint64_t end, uint64_t mod) {
+  if (begin > end) return 1 % mod;
+  // Среди mod подряд идущих чисел обязательно есть кратное mod
+  if (end - begin >= mod - 1) return 0;
+
+  uint64_t acc = 1 % mod;
+  uint64_t i = begin % mod;
+  uint64_t count = end - begin + 1;
+  if (ModIsSmall(mod)) {
+    for (uint64_t n = 0; n < count; n++) {
+      acc = acc * i % mod;
+      if (++i == mod) i = 0;
+    }
+  } else {
+    for (uint64_t n = 0; n < count; n++) {
+      acc = (uint64_t)((unsigned __int128)acc * i % mod);
+      if (++i == mod) i = 0;
+    }
+  }
+  return acc;
+}
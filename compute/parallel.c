@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include "compute.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+
+#define CACHE_LINE 64
+
+// Задание потока; частичный результат лежит отдельно, на своих кэш-линиях
+struct ReduceTask {
+  size_t begin;
+  size_t end;
+  void *partial;
+  ComputeMapFn map;
+  void *arg;
+  pthread_t thread;
+  int started;
+};
+
+static void *ReduceThread(void *arg) {
+  struct ReduceTask *task = arg;
+  task->map(task->begin, task->end, task->partial, task->arg);
+  return NULL;
+}
+
+static int ThreadCount(int threads, size_t n) {
+  if (threads <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (int)cpus : 1;
+  }
+  // Потоков не больше, чем элементов, иначе у лишних пустые куски
+  if ((size_t)threads > n) threads = n > 0 ? (int)n : 1;
+  return threads;
+}
+
+void ComputeParallelReduce(size_t n, int threads, size_t partial_size, ComputeMapFn map,
+                           ComputeCombineFn combine, void *arg, void *result) {
+  threads = ThreadCount(threads, n);
+  struct Arena *arena = ArenaThread();
+  struct ArenaMark mark = ArenaSave(arena);
+  size_t stride = (partial_size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+  struct ReduceTask *tasks = NULL;
+  uint8_t *partials = NULL;
+  if (threads > 1) {
+    tasks = ArenaAlloc(arena, sizeof(struct ReduceTask) * threads, 0);
+    partials = ArenaAlloc(arena, stride * threads, CACHE_LINE);
+  }
+  // Один поток или не хватило памяти - весь отрезок в вызывающем потоке
+  if (tasks == NULL || partials == NULL) {
+    ArenaRewind(arena, mark);
+    map(0, n, result, arg);
+    return;
+  }
+
+  size_t step = n / threads, remainder = n % threads, current = 0;
+  for (int i = 0; i < threads; i++) {
+    struct ReduceTask *task = &tasks[i];
+    task->begin = current;
+    task->end = current + step + ((size_t)i < remainder ? 1 : 0);
+    task->partial = partials + stride * i;
+    task->map = map;
+    task->arg = arg;
+    current = task->end;
+    // Первый кусок - в вызывающем потоке; не создался поток - тоже
+    task->started = i > 0 && pthread_create(&task->thread, NULL, ReduceThread, task) == 0;
+  }
+  for (int i = 0; i < threads; i++)
+    if (!tasks[i].started) ReduceThread(&tasks[i]);
+
+  for (int i = 0; i < threads; i++) {
+    if (tasks[i].started) pthread_join(tasks[i].thread, NULL);
+    if (i == 0)
+      memcpy(result, tasks[0].partial, partial_size);
+    else
+      combine(result, tasks[i].partial, arg);
+  }
+  ArenaRewind(arena, mark);
+}
+
+static void MinMaxMap(size_t begin, size_t end, void *partial, void *arg) {
+  *(struct MinMax *)partial = GetMinMax(arg, (unsigned int)begin, (unsigned int)end);
+}
+
+static void MinMaxCombine(void *acc, const void *partial, void *arg) {
+  (void)arg;
+  struct MinMax *a = acc;
+  const struct MinMax *p = partial;
+  if (p->min < a->min) a->min = p->min;
+  if (p->max > a->max) a->max = p->max;
+}
+
+struct MinMax ParallelMinMax(const int *array, size_t n, int threads) {
+  struct MinMax result = GetMinMax(array, 0, 0);
+  ComputeParallelReduce(n, threads, sizeof(result), MinMaxMap, MinMaxCombine, (void *)array,
+                        &result);
+  return result;
+}
+
+static void SumMap(size_t begin, size_t end, void *partial, void *arg) {
+  struct SumArgs args = {arg, (int)begin, (int)end};
+  *(long long *)partial = Sum(&args);
+}
+
+static void SumCombine(void *acc, const void *partial, void *arg) {
+  (void)arg;
+  *(long long *)acc += *(const long long *)partial;
+}
+
+long long ParallelSum(const int *array, size_t n, int threads) {
+  long long result = 0;
+  ComputeParallelReduce(n, threads, sizeof(result), SumMap, SumCombine, (void *)array, &result);
+  return result;
+}
+
+struct ProductRange {
+  uint64_t first;
+  uint64_t mod;
+};
+
+static void ProductMap(size_t begin, size_t end, void *partial, void *arg) {
+  const struct ProductRange *range = arg;
+  *(uint64_t *)partial = begin < end ? ProductModulo(range->first + begin,
+                                                     range->first + end - 1, range->mod)
+                                     : 1 % range->mod;
+}
+
+static void ProductCombine(void *acc, const void *partial, void *arg) {
+  const struct ProductRange *range = arg;
+  *(uint64_t *)acc = MultModulo(*(uint64_t *)acc, *(const uint64_t *)partial, range->mod);
+}
+
+uint64_t ParallelProductModulo(uint64_t begin, uint64_t end, uint64_t mod, int threads) {
+  if (begin > end) return 1 % mod;
+  if (end - begin >= mod - 1) return 0;
+  struct ProductRange range = {begin, mod};
+  uint64_t result = 1 % mod;
+  ComputeParallelReduce((size_t)(end - begin + 1), threads, sizeof(result), ProductMap,
+                        ProductCombine, &range, &result);
+  return result;
+}
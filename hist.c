@@ -0,0 +1,87 @@
+#include "hist.h"
+
+#include <string.h>
+
+static unsigned HistIndex(uint64_t value) {
+  if (value < 2 * HIST_SUB_COUNT)
+    return (unsigned)value;
+  unsigned msb = 63 - (unsigned)__builtin_clzll(value);
+  unsigned shift = msb - HIST_SUB_BITS;
+  return 2 * HIST_SUB_COUNT + (shift - 1) * HIST_SUB_COUNT +
+         (unsigned)((value >> shift) - HIST_SUB_COUNT);
+}
+
+/* Верхняя граница корзины - так перцентили не занижаются. */
+static uint64_t HistValueAt(unsigned index) {
+  if (index < 2 * HIST_SUB_COUNT)
+    return index;
+  unsigned rel = index - 2 * HIST_SUB_COUNT;
+  unsigned shift = rel / HIST_SUB_COUNT + 1;
+  uint64_t offset = rel % HIST_SUB_COUNT + HIST_SUB_COUNT;
+  return ((offset + 1) << shift) - 1;
+}
+
+void HistInit(struct Hist *h) {
+  memset(h, 0, sizeof(*h));
+  h->min = UINT64_MAX;
+}
+
+void HistRecord(struct Hist *h, uint64_t value) {
+  h->counts[HistIndex(value)]++;
+  h->total++;
+  h->sum += (double)value;
+  if (value < h->min)
+    h->min = value;
+  if (value > h->max)
+    h->max = value;
+}
+
+void HistMerge(struct Hist *dst, const struct Hist *src) {
+  for (unsigned i = 0; i < HIST_BUCKETS; i++)
+    dst->counts[i] += src->counts[i];
+  dst->total += src->total;
+  dst->sum += src->sum;
+  if (src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+}
+
+uint64_t HistPercentile(const struct Hist *h, double percentile) {
+  if (h->total == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->total + 0.5);
+  if (rank < 1)
+    rank = 1;
+  if (rank > h->total)
+    rank = h->total;
+
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      uint64_t value = HistValueAt(i);
+      return value > h->max ? h->max : value;
+    }
+  }
+  return h->max;
+}
+
+double HistMean(const struct Hist *h) {
+  return h->total ? h->sum / (double)h->total : 0.0;
+}
+
+void HistPrint(FILE *out, const char *name, const struct Hist *h,
+               double scale, const char *unit) {
+  if (h->total == 0) {
+    fprintf(out, "%s: no samples\n", name);
+    return;
+  }
+  fprintf(out,
+          "%s (%s): count=%llu min=%.2f mean=%.2f p50=%.2f p90=%.2f "
+          "p99=%.2f p99.9=%.2f max=%.2f\n",
+          name, unit, (unsigned long long)h->total, h->min / scale,
+          HistMean(h) / scale, HistPercentile(h, 50.0) / scale,
+          HistPercentile(h, 90.0) / scale, HistPercentile(h, 99.0) / scale,
+          HistPercentile(h, 99.9) / scale, h->max / scale);
+}
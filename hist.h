@@ -0,0 +1,41 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Гистограмма задержек в стиле HDR: первые 256 значений хранятся точно,
+ * дальше каждая степень двойки делится на 128 под-корзин, поэтому
+ * относительная погрешность перцентилей не превышает 1/128 (~0.8%).
+ */
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS (2 * HIST_SUB_COUNT + (63 - HIST_SUB_BITS) * HIST_SUB_COUNT)
+
+struct Hist {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+  double sum;
+};
+
+void HistInit(struct Hist *h);
+void HistRecord(struct Hist *h, uint64_t value);
+void HistMerge(struct Hist *dst, const struct Hist *src);
+uint64_t HistPercentile(const struct Hist *h, double percentile);
+double HistMean(const struct Hist *h);
+
+/* Печатает count/min/mean/p50/p90/p99/p99.9/max, деля значения на scale. */
+void HistPrint(FILE *out, const char *name, const struct Hist *h,
+               double scale, const char *unit);
+
+static inline uint64_t MonotonicNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#endif
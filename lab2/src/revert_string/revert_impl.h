@@ -0,0 +1,18 @@
+#ifndef REVERT_IMPL_H
+#define REVERT_IMPL_H
+
+#include <stddef.h>
+
+/* Внутренние примитивы librevert, версия выбирается под процессор.
+ * Из librevert.so они не экспортируются: вызовы между ее файлами идут
+ * напрямую, а не через PLT. */
+#define REVERT_INTERNAL __attribute__((visibility("hidden")))
+
+/* Меняет местами m байт от lo и m байт перед hi, разворачивая их;
+ * диапазоны не должны пересекаться. */
+REVERT_INTERNAL void RevertSwapRanges(char *lo, char *hi, size_t m);
+
+/* Пишет src[0..n) задом наперед в n байт, которые кончаются на dst_end. */
+REVERT_INTERNAL void RevertCopyRange(char *dst_end, const char *src, size_t n);
+
+#endif
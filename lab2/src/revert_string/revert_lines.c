@@ -0,0 +1,488 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "revert_string.h"
+
+/*
+ * Переворачивает каждую строку входа. Вход читается большими блоками,
+ * блок обрезается по последнему '\n', а хвост переносится в начало
+ * следующего - так каждый блок состоит из целых строк и обрабатывается
+ * независимо. Три роли работают одновременно: главный поток читает,
+ * рабочие переворачивают строки на месте, поток записи отдает готовые
+ * блоки строго по порядку, собирая подряд идущие в один writev.
+ */
+
+#define MAX_THREADS 64
+
+static const char *unit_names[] = {"bytes", "codepoints", "graphemes"};
+
+struct LinesConfig {
+  enum RevertUnit unit;
+  int threads;
+  size_t block_size;
+  const char *output;
+  bool stats;
+};
+
+enum SlotState { SLOT_FREE, SLOT_FILLED, SLOT_DONE };
+
+struct Slot {
+  char *buf;
+  size_t cap;
+  size_t len;
+  uint64_t lines;
+  enum SlotState state;
+};
+
+// Блок с номером seq лежит в slots[seq % slot_count]; читатель берет
+// слот, только когда поток записи его освободил
+struct Pipeline {
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  struct Slot *slots;
+  int slot_count;
+  uint64_t filled;
+  uint64_t taken;
+  uint64_t written;
+  bool eof;
+  bool failed;
+  enum RevertUnit unit;
+  int out_fd;
+  uint64_t lines;
+  uint64_t bytes;
+};
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// "64", "4K", "16M", "1G"
+static bool ParseSize(const char *str, size_t *size) {
+  char *end = NULL;
+  unsigned long long value = strtoull(str, &end, 10);
+  if (end == str) return false;
+  switch (*end) {
+    case 'K': case 'k': value <<= 10; end++; break;
+    case 'M': case 'm': value <<= 20; end++; break;
+    case 'G': case 'g': value <<= 30; end++; break;
+    default: break;
+  }
+  if (*end != '\0' || value == 0) return false;
+  *size = value;
+  return true;
+}
+
+// CR перед LF остается на месте, чтобы строки Windows не теряли конец
+static void ReverseLine(char *line, size_t len, enum RevertUnit unit) {
+  if (len > 0 && line[len - 1] == '\r') len--;
+  if (len > 1) RevertBuffer(line, len, unit);
+}
+
+// Переворачивает строки buf[0..len) и возвращает их число. Переводы строк
+// ищутся по 64 байта: четыре сравнения SSE2 дают маску, из которой
+// позиции достаются без ветвлений на каждый байт
+static uint64_t ReverseLines(char *buf, size_t len, enum RevertUnit unit) {
+  uint64_t lines = 0;
+  size_t start = 0;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i newline = _mm_set1_epi8('\n');
+  for (; i + 64 <= len; i += 64) {
+    uint64_t mask = 0;
+    for (int k = 0; k < 4; k++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(buf + i + 16 * k));
+      mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << (16 * k);
+    }
+    while (mask != 0) {
+      size_t pos = i + (size_t)__builtin_ctzll(mask);
+      ReverseLine(buf + start, pos - start, unit);
+      start = pos + 1;
+      lines++;
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  while (i < len) {
+    char *nl = memchr(buf + i, '\n', len - i);
+    if (nl == NULL) break;
+    size_t pos = (size_t)(nl - buf);
+    ReverseLine(buf + start, pos - start, unit);
+    start = pos + 1;
+    lines++;
+    i = pos + 1;
+  }
+  // Последняя строка файла без '\n'
+  if (start < len) {
+    ReverseLine(buf + start, len - start, unit);
+    lines++;
+  }
+  return lines;
+}
+
+static void Fail(struct Pipeline *p) {
+  pthread_mutex_lock(&p->lock);
+  p->failed = true;
+  pthread_cond_broadcast(&p->changed);
+  pthread_mutex_unlock(&p->lock);
+}
+
+static void *WorkerThread(void *arg) {
+  struct Pipeline *p = arg;
+  for (;;) {
+    pthread_mutex_lock(&p->lock);
+    while (!p->failed && p->taken == p->filled && !p->eof)
+      pthread_cond_wait(&p->changed, &p->lock);
+    if (p->failed || p->taken == p->filled) {
+      pthread_mutex_unlock(&p->lock);
+      return NULL;
+    }
+    struct Slot *slot = &p->slots[p->taken++ % p->slot_count];
+    pthread_mutex_unlock(&p->lock);
+
+    uint64_t lines = ReverseLines(slot->buf, slot->len, p->unit);
+
+    pthread_mutex_lock(&p->lock);
+    slot->lines = lines;
+    slot->state = SLOT_DONE;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+  }
+}
+
+// writev может записать не все: досылаем остаток
+static bool WriteAll(int fd, struct iovec *iov, int count) {
+  while (count > 0) {
+    ssize_t n = writev(fd, iov, count);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("writev");
+      return false;
+    }
+    while (count > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return true;
+}
+
+static void *WriterThread(void *arg) {
+  struct Pipeline *p = arg;
+  int max_batch = p->slot_count < IOV_MAX ? p->slot_count : IOV_MAX;
+  struct iovec *iov = malloc(sizeof(struct iovec) * max_batch);
+  if (iov == NULL) {
+    Fail(p);
+    return NULL;
+  }
+
+  for (;;) {
+    pthread_mutex_lock(&p->lock);
+    while (!p->failed && !(p->eof && p->written == p->filled) &&
+           !(p->written < p->filled &&
+             p->slots[p->written % p->slot_count].state == SLOT_DONE))
+      pthread_cond_wait(&p->changed, &p->lock);
+    if (p->failed || p->written == p->filled) {
+      pthread_mutex_unlock(&p->lock);
+      break;
+    }
+    // Все готовые подряд блоки уходят одним вызовом
+    int count = 0;
+    while (count < max_batch && p->written + count < p->filled) {
+      struct Slot *slot = &p->slots[(p->written + count) % p->slot_count];
+      if (slot->state != SLOT_DONE) break;
+      iov[count].iov_base = slot->buf;
+      iov[count].iov_len = slot->len;
+      count++;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    if (!WriteAll(p->out_fd, iov, count)) {
+      Fail(p);
+      break;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    for (int k = 0; k < count; k++) {
+      struct Slot *slot = &p->slots[p->written % p->slot_count];
+      p->bytes += slot->len;
+      p->lines += slot->lines;
+      slot->state = SLOT_FREE;
+      p->written++;
+    }
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+  }
+  free(iov);
+  return NULL;
+}
+
+// Дочитывает в слот, пока он не заполнится или не кончится вход
+static bool FillSlot(int fd, struct Slot *slot, size_t *fill, bool *eof) {
+  while (*fill < slot->cap) {
+    ssize_t n = read(fd, slot->buf + *fill, slot->cap - *fill);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("read");
+      return false;
+    }
+    if (n == 0) {
+      *eof = true;
+      break;
+    }
+    *fill += n;
+  }
+  return true;
+}
+
+static bool Reserve(char **buf, size_t *cap, size_t need) {
+  if (*cap >= need) return true;
+  size_t new_cap = *cap > 0 ? *cap : 4096;
+  while (new_cap < need) new_cap *= 2;
+  char *grown = realloc(*buf, new_cap);
+  if (grown == NULL) {
+    fprintf(stderr, "Can not allocate %zu bytes\n", new_cap);
+    return false;
+  }
+  *buf = grown;
+  *cap = new_cap;
+  return true;
+}
+
+// Читатель - вызывающий поток. Хвост блока после последнего '\n' лежит в
+// carry, пока не освободится следующий слот
+static bool ReadBlocks(struct Pipeline *p, int in_fd, size_t block_size) {
+  char *carry = NULL;
+  size_t carry_len = 0;
+  size_t carry_cap = 0;
+  bool eof = false;
+  bool ok = true;
+
+  while (ok && !eof) {
+    pthread_mutex_lock(&p->lock);
+    struct Slot *slot = &p->slots[p->filled % p->slot_count];
+    while (!p->failed && slot->state != SLOT_FREE)
+      pthread_cond_wait(&p->changed, &p->lock);
+    bool failed = p->failed;
+    pthread_mutex_unlock(&p->lock);
+    if (failed) break;
+
+    ok = Reserve(&slot->buf, &slot->cap, block_size + carry_len);
+    if (!ok) break;
+    memcpy(slot->buf, carry, carry_len);
+    size_t fill = carry_len;
+    size_t cut = 0;
+    // Строка длиннее блока: слот растет, пока в нем не найдется '\n'
+    for (;;) {
+      size_t scanned = fill;
+      ok = FillSlot(in_fd, slot, &fill, &eof);
+      if (!ok) break;
+      if (eof) {
+        cut = fill;
+        break;
+      }
+      // В перенесенном хвосте и уже просмотренной части '\n' нет
+      char *nl = memrchr(slot->buf + scanned, '\n', fill - scanned);
+      if (nl != NULL) {
+        cut = (size_t)(nl - slot->buf) + 1;
+        break;
+      }
+      ok = Reserve(&slot->buf, &slot->cap, slot->cap * 2);
+      if (!ok) break;
+    }
+    if (!ok) break;
+
+    carry_len = fill - cut;
+    ok = Reserve(&carry, &carry_cap, carry_len);
+    if (!ok) break;
+    memcpy(carry, slot->buf + cut, carry_len);
+    if (cut == 0) continue;
+
+    pthread_mutex_lock(&p->lock);
+    slot->len = cut;
+    slot->state = SLOT_FILLED;
+    p->filled++;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+  }
+
+  pthread_mutex_lock(&p->lock);
+  p->eof = true;
+  if (!ok) p->failed = true;
+  pthread_cond_broadcast(&p->changed);
+  pthread_mutex_unlock(&p->lock);
+  free(carry);
+  return ok;
+}
+
+static bool RevertStream(int in_fd, int out_fd, const struct LinesConfig *config,
+                         uint64_t *lines, uint64_t *bytes) {
+  struct Pipeline p;
+  memset(&p, 0, sizeof(p));
+  pthread_mutex_init(&p.lock, NULL);
+  pthread_cond_init(&p.changed, NULL);
+  p.unit = config->unit;
+  p.out_fd = out_fd;
+  // По блоку на рабочего, еще столько же в очереди на запись и один
+  // читается - тогда ни одна роль не ждет другую при ровном потоке
+  p.slot_count = 2 * config->threads + 2;
+  p.slots = calloc(p.slot_count, sizeof(struct Slot));
+  if (p.slots == NULL) {
+    fprintf(stderr, "Can not allocate slots\n");
+    return false;
+  }
+  posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  pthread_t workers[MAX_THREADS];
+  pthread_t writer;
+  int started = 0;
+  bool writer_started = pthread_create(&writer, NULL, WriterThread, &p) == 0;
+  bool ok = writer_started;
+  for (int i = 0; ok && i < config->threads; i++) {
+    ok = pthread_create(&workers[i], NULL, WorkerThread, &p) == 0;
+    if (ok) started++;
+  }
+  if (!ok) {
+    perror("pthread_create");
+    Fail(&p);
+  } else {
+    ok = ReadBlocks(&p, in_fd, config->block_size);
+  }
+
+  for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+  if (writer_started) pthread_join(writer, NULL);
+  ok = ok && !p.failed;
+
+  *lines += p.lines;
+  *bytes += p.bytes;
+  for (int i = 0; i < p.slot_count; i++) free(p.slots[i].buf);
+  free(p.slots);
+  pthread_cond_destroy(&p.changed);
+  pthread_mutex_destroy(&p.lock);
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  struct LinesConfig config;
+  memset(&config, 0, sizeof(config));
+  config.unit = REVERT_BYTES;
+  config.block_size = 4 << 20;
+
+  bool ok = true;
+  while (ok) {
+    static struct option options[] = {{"unit", required_argument, 0, 0},
+                                      {"threads", required_argument, 0, 0},
+                                      {"block-size", required_argument, 0, 0},
+                                      {"output", required_argument, 0, 0},
+                                      {"stats", no_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            ok = false;
+            for (int i = 0; i < 3; i++) {
+              if (strcmp(optarg, unit_names[i]) == 0) {
+                config.unit = (enum RevertUnit)i;
+                ok = true;
+              }
+            }
+            break;
+          case 1:
+            config.threads = atoi(optarg);
+            ok = config.threads > 0 && config.threads <= MAX_THREADS;
+            break;
+          case 2: ok = ParseSize(optarg, &config.block_size); break;
+          case 3: config.output = optarg; break;
+          case 4: config.stats = true; break;
+          default: printf("Index %d is out of options\n", option_index);
+        }
+        break;
+      default:
+        ok = false;
+    }
+  }
+
+  if (!ok) {
+    fprintf(stderr,
+            "Using: %s [--unit bytes|codepoints|graphemes] [--threads N] "
+            "[--block-size 4M] [--output file] [--stats] [file|- ...]\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (config.threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    config.threads = cpus < 1 ? 1 : cpus > MAX_THREADS ? MAX_THREADS : (int)cpus;
+  }
+
+  int out_fd = STDOUT_FILENO;
+  if (config.output != NULL) {
+    out_fd = open(config.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+      perror(config.output);
+      return 1;
+    }
+  }
+
+  uint64_t lines = 0;
+  uint64_t bytes = 0;
+  uint64_t start = NowNs();
+  // Без файлов - стандартный ввод; файлы идут подряд, как у cat
+  int file_count = argc - optind;
+  for (int i = 0; ok && i < (file_count > 0 ? file_count : 1); i++) {
+    const char *path = file_count > 0 ? argv[optind + i] : "-";
+    int in_fd = STDIN_FILENO;
+    if (strcmp(path, "-") != 0) {
+      in_fd = open(path, O_RDONLY);
+      if (in_fd < 0) {
+        perror(path);
+        ok = false;
+        break;
+      }
+    }
+    ok = RevertStream(in_fd, out_fd, &config, &lines, &bytes);
+    if (in_fd != STDIN_FILENO) close(in_fd);
+  }
+  double seconds = (NowNs() - start) / 1e9;
+
+  if (out_fd != STDOUT_FILENO && close(out_fd) != 0) {
+    perror(config.output);
+    ok = false;
+  }
+  if (config.stats) {
+    fprintf(stderr, "%llu lines, %llu bytes, %.3f s, %.1f MB/s, %d threads, impl %s\n",
+            (unsigned long long)lines, (unsigned long long)bytes, seconds,
+            seconds > 0 ? bytes / seconds / 1e6 : 0.0, config.threads,
+            RevertStringImpl());
+  }
+  return ok ? 0 : 1;
+}
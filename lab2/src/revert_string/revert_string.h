@@ -1,4 +1,37 @@
+#ifndef REVERT_STRING_H
+#define REVERT_STRING_H
+
+#include <stddef.h>
 
 /* function to revert string */
 void RevertString(char *str);
 
+/* name of the implementation selected for this CPU:
+ * "avx512vbmi", "avx2", "ssse3" or "scalar" */
+const char *RevertStringImpl(void);
+
+/* what is kept intact while the order is reverted */
+enum RevertUnit {
+	REVERT_BYTES,      /* single bytes, as RevertString does */
+	REVERT_CODEPOINTS, /* UTF-8 sequences; an invalid byte is a unit of its own */
+	REVERT_GRAPHEMES,  /* user-perceived characters: a base code point with its
+	                      combining marks, emoji ZWJ sequences and modifiers,
+	                      flag pairs, CR LF */
+};
+
+/* revert len bytes of str in place, no terminator needed */
+void RevertBuffer(char *str, size_t len, enum RevertUnit unit);
+
+/* write len bytes of src reverted into dst; the buffers must not overlap,
+ * no terminator is added */
+void RevertCopy(char *dst, const char *src, size_t len, enum RevertUnit unit);
+
+/* inputs shorter than this are reverted in the calling thread */
+#define REVERT_PARALLEL_MIN (1024 * 1024)
+
+/* the same on up to threads threads (0 - one per online CPU) */
+void RevertBufferParallel(char *str, size_t len, enum RevertUnit unit, int threads);
+void RevertCopyParallel(char *dst, const char *src, size_t len, enum RevertUnit unit,
+                        int threads);
+
+#endif
@@ -0,0 +1,481 @@
+#include "revert_string.h"
+#include "revert_impl.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Переворот с сохранением единиц (символов UTF-8, графем) делается в два
+ * шага: сначала каждая многобайтовая единица разворачивается на месте,
+ * затем весь буфер разворачивается побайтово - и единицы снова читаются
+ * правильно, но идут в обратном порядке. Оба шага линейные; ASCII-участки
+ * первый шаг пропускает блоками по 16 байт, а блоки из ASCII и
+ * двухбайтовых символов обрабатывает одной перестановкой SSE2.
+ *
+ * Границы единиц ищутся разбором от начала. Байт, который не является
+ * продолжением UTF-8, всегда начинает символ, а ASCII-байт (кроме LF
+ * после CR) всегда начинает графему, поэтому по таким местам буфер можно
+ * резать на куски для потоков и для блочной копии.
+ */
+
+// Копия идет блоками: разворот байтов и правка единиц блока, пока он в кеше
+#define COPY_BLOCK (64 * 1024)
+// Меньше этого на поток не дается - иначе создание потока дороже работы
+#define PARALLEL_CHUNK (256 * 1024)
+#define MAX_THREADS 64
+
+static int IsContinuation(unsigned char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+// Длина последовательности UTF-8 с s[i] и код символа в cp. Неверная или
+// обрезанная последовательность - это один байт и cp = -1
+static size_t DecodeUtf8(const unsigned char *s, size_t i, size_t end, int32_t *cp)
+{
+    unsigned char c = s[i];
+    size_t n;
+    int32_t value;
+
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    }
+    if (c >= 0xC0 && c < 0xE0) {
+        n = 2;
+        value = c & 0x1F;
+    } else if (c >= 0xE0 && c < 0xF0) {
+        n = 3;
+        value = c & 0x0F;
+    } else if (c >= 0xF0 && c < 0xF8) {
+        n = 4;
+        value = c & 0x07;
+    } else {
+        *cp = -1;
+        return 1;
+    }
+    if (end - i < n) {
+        *cp = -1;
+        return 1;
+    }
+    for (size_t k = 1; k < n; k++) {
+        if (!IsContinuation(s[i + k])) {
+            *cp = -1;
+            return 1;
+        }
+        value = (value << 6) | (s[i + k] & 0x3F);
+    }
+    *cp = value;
+    return n;
+}
+
+// Символы, которые присоединяются к предыдущему: комбинируемые знаки
+// основных письменностей, ZWNJ/ZWJ, селекторы вариантов, модификаторы
+// цвета кожи, теги флагов, гласные и финали хангыля. Это приближение
+// свойства Grapheme_Extend из UAX #29 без полных таблиц Unicode
+static const int32_t extend_ranges[][2] = {
+    {0x0300, 0x036F},   {0x0483, 0x0489},   {0x0591, 0x05BD},   {0x0610, 0x061A},
+    {0x064B, 0x065F},   {0x0670, 0x0670},   {0x06D6, 0x06DC},   {0x0900, 0x0903},
+    {0x093A, 0x094F},   {0x0E31, 0x0E31},   {0x0E34, 0x0E3A},   {0x0E47, 0x0E4E},
+    {0x1160, 0x11FF},   {0x1AB0, 0x1AFF},   {0x1DC0, 0x1DFF},   {0x200C, 0x200D},
+    {0x20D0, 0x20FF},   {0xFE00, 0xFE0F},   {0xFE20, 0xFE2F},   {0x1F3FB, 0x1F3FF},
+    {0xE0020, 0xE007F}, {0xE0100, 0xE01EF},
+};
+
+// Таблица упорядочена, поэтому поиск останавливается на первом диапазоне
+// правее cp: для кириллицы и греческого это второй диапазон
+static int IsExtend(int32_t cp)
+{
+    for (size_t i = 0; i < sizeof(extend_ranges) / sizeof(extend_ranges[0]); i++) {
+        if (cp < extend_ranges[i][0])
+            return 0;
+        if (cp <= extend_ranges[i][1])
+            return 1;
+    }
+    return 0;
+}
+
+static int IsRegionalIndicator(int32_t cp)
+{
+    return cp >= 0x1F1E6 && cp <= 0x1F1FF;
+}
+
+static int IsHangulLeading(int32_t cp)
+{
+    return cp >= 0x1100 && cp <= 0x115F;
+}
+
+// Длина графемы с s[i]: базовый символ и все, что к нему присоединяется
+static size_t GraphemeLength(const unsigned char *s, size_t i, size_t end)
+{
+    int32_t cp;
+    size_t pos = i + DecodeUtf8(s, i, end, &cp);
+
+    if (cp == '\r') {
+        if (pos < end && s[pos] == '\n')
+            pos++;
+        return pos - i;
+    }
+    // Управляющие символы и неверные байты ни к чему не присоединяются
+    if (cp < 0x20 || cp == 0x7F)
+        return pos - i;
+
+    int32_t prev = cp;
+    int regional = IsRegionalIndicator(cp);
+    // ASCII никогда не продолжает графему - на этом держатся точки разреза
+    while (pos < end && s[pos] >= 0x80) {
+        int32_t next;
+        size_t n = DecodeUtf8(s, pos, end, &next);
+        if (next < 0)
+            break;
+        if (IsExtend(next)) {
+            // расширение годится после любого символа
+        } else if (prev == 0x200D) {
+            // ZWJ склеивает эмодзи в одну графему
+        } else if (regional == 1 && IsRegionalIndicator(next)) {
+            regional = 2; // флаг - ровно пара региональных индикаторов
+        } else if (IsHangulLeading(prev) &&
+                   (IsHangulLeading(next) || (next >= 0xAC00 && next <= 0xD7A3))) {
+            // начальная согласная хангыля с последующим слогом
+        } else {
+            break;
+        }
+        prev = next;
+        pos += n;
+    }
+    return pos - i;
+}
+
+// Сколько байт от s подряд - ASCII (при stop_cr - еще и не CR)
+static size_t AsciiRun(const unsigned char *s, size_t n, int stop_cr)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (n - i >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        int mask = _mm_movemask_epi8(v);
+        if (stop_cr)
+            mask |= _mm_movemask_epi8(_mm_cmpeq_epi8(v, cr));
+        if (mask != 0)
+            break;
+        i += 16;
+    }
+#endif
+    while (i < n && s[i] < 0x80 && !(stop_cr && s[i] == '\r'))
+        i++;
+    return i;
+}
+
+#ifdef __SSE2__
+// Лидеры двухбайтовых символов, которые не бывают комбинируемыми знаками:
+// латиница, греческий, кириллица (U+0080-U+02FF, U+0380-U+047F)
+static int SafeLeads(__m128i v)
+{
+    __m128i a = _mm_sub_epi8(v, _mm_set1_epi8((char)0xC2));
+    __m128i b = _mm_sub_epi8(v, _mm_set1_epi8((char)0xCE));
+    __m128i in_a = _mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(9)), a);
+    __m128i in_b = _mm_cmpeq_epi8(_mm_min_epu8(b, _mm_set1_epi8(3)), b);
+    return _mm_movemask_epi8(_mm_or_si128(in_a, in_b));
+}
+
+// Блок из 16 байт, где есть только ASCII и двухбайтовые символы (текст на
+// кириллице), разворачивается за раз: каждый лидер меняется местами со
+// своим продолжением. block - место блока в target; в копии (mirrored)
+// блок уже развернут побайтово и продолжение стоит перед лидером.
+// Возвращает число обработанных байт: 16, 15 (последний символ блока
+// продолжается за ним) или 0 - блок не подходит. Для графем next - байт
+// после блока (-1 в конце куска): если за блоком комбинируемый знак,
+// последний символ блока трогать нельзя
+static size_t FlipPairs16(char *block, int mirrored, int graphemes, int next)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i *)block);
+    __m128i lead_v = _mm_cmpeq_epi8(_mm_and_si128(v, _mm_set1_epi8((char)0xE0)),
+                                    _mm_set1_epi8((char)0xC0));
+    __m128i cont_v = _mm_cmpeq_epi8(_mm_and_si128(v, _mm_set1_epi8((char)0xC0)),
+                                    _mm_set1_epi8((char)0x80));
+    int high = _mm_movemask_epi8(v);
+    int lead = _mm_movemask_epi8(lead_v);
+    int cont = _mm_movemask_epi8(cont_v);
+
+    // трех- и четырехбайтовые символы, неверные байты
+    if ((lead | cont) != high)
+        return 0;
+    if (graphemes) {
+        if ((lead & ~SafeLeads(v)) != 0 ||
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))) != 0)
+            return 0;
+    }
+
+    // Лидер на краю блока остается на месте - его символ начнется со
+    // следующего блока
+    int tail = mirrored ? lead & 0x0001 : lead & 0x8000;
+    if (tail != 0) {
+        const __m128i keep = mirrored ? _mm_setr_epi8(0, -1, -1, -1, -1, -1, -1, -1,
+                                                      -1, -1, -1, -1, -1, -1, -1, -1)
+                                      : _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                                                      -1, -1, -1, -1, -1, -1, -1, 0);
+        lead_v = _mm_and_si128(lead_v, keep);
+        lead &= ~tail;
+    }
+    if (cont != (mirrored ? lead >> 1 : (lead << 1) & 0xFFFF))
+        return 0;
+    if (graphemes && tail == 0 && next >= 0x80 &&
+        !((next >= 0xC2 && next <= 0xCB) || (next >= 0xCE && next <= 0xD1)))
+        return 0;
+
+    __m128i after = _mm_srli_si128(v, 1);
+    __m128i before = _mm_slli_si128(v, 1);
+    __m128i for_lead = mirrored ? before : after;
+    __m128i for_cont = mirrored ? after : before;
+    __m128i result = _mm_or_si128(_mm_and_si128(lead_v, for_lead),
+                                  _mm_and_si128(cont_v, for_cont));
+    result = _mm_or_si128(result, _mm_andnot_si128(_mm_or_si128(lead_v, cont_v), v));
+    _mm_storeu_si128((__m128i *)block, result);
+    return tail != 0 ? 15 : 16;
+}
+#endif
+
+static void ReverseSpan(char *p, size_t n)
+{
+    if (n == 2) {
+        char temp = p[0];
+        p[0] = p[1];
+        p[1] = temp;
+        return;
+    }
+    if (n > 32) {
+        RevertSwapRanges(p, p + n, n / 2);
+        return;
+    }
+    for (size_t i = 0; i < n / 2; i++) {
+        char temp = p[i];
+        p[i] = p[n - i - 1];
+        p[n - i - 1] = temp;
+    }
+}
+
+// Разворачивает каждую многобайтовую единицу src[begin..end). Для
+// переворота на месте target == src и единица разворачивается там же
+// (mirror == 0); для копии target - уже развернутый побайтово буфер длины
+// mirror, и единица [a, a + n) лежит в нем с позиции mirror - a - n
+static void FlipUnits(char *target, const char *src, size_t begin, size_t end, size_t mirror,
+                      enum RevertUnit unit)
+{
+    const unsigned char *s = (const unsigned char *)src;
+    int graphemes = unit == REVERT_GRAPHEMES;
+    size_t i = begin;
+
+    while (i < end) {
+        if (s[i] < 0x80 && !(graphemes && s[i] == '\r')) {
+            size_t run = AsciiRun(s + i, end - i, graphemes);
+            // последний ASCII-символ может взять на себя комбинируемые знаки
+            if (graphemes && i + run < end)
+                run--;
+            i += run;
+            if (run > 0)
+                continue;
+        }
+
+#ifdef __SSE2__
+        if (end - i >= 16) {
+            char *block = mirror ? target + mirror - i - 16 : target + i;
+            int next = i + 16 < end ? s[i + 16] : -1;
+            size_t done = FlipPairs16(block, mirror != 0, graphemes, next);
+            if (done > 0) {
+                i += done;
+                continue;
+            }
+        }
+#endif
+
+        int32_t cp;
+        size_t n = graphemes ? GraphemeLength(s, i, end) : DecodeUtf8(s, i, end, &cp);
+        if (n > 1)
+            ReverseSpan(mirror ? target + mirror - i - n : target + i, n);
+        i += n;
+    }
+}
+
+// Ближайшая к pos (не раньше) граница единицы, на которой можно резать
+static size_t UnitBoundary(const char *str, size_t pos, size_t end, enum RevertUnit unit)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    if (unit == REVERT_CODEPOINTS) {
+        while (pos < end && IsContinuation(s[pos]))
+            pos++;
+    } else if (unit == REVERT_GRAPHEMES) {
+        while (pos < end && !(s[pos] < 0x80 && !(s[pos] == '\n' && pos > 0 && s[pos - 1] == '\r')))
+            pos++;
+    }
+    return pos;
+}
+
+// Копия куска src[begin..end), который начинается и кончается на границах
+// единиц, в его место в dst
+static void CopyChunk(char *dst, const char *src, size_t len, size_t begin, size_t end,
+                      enum RevertUnit unit)
+{
+    while (begin < end) {
+        size_t stop = end;
+        if (stop - begin > COPY_BLOCK)
+            stop = UnitBoundary(src, begin + COPY_BLOCK, end, unit);
+        RevertCopyRange(dst + len - begin, src + begin, stop - begin);
+        if (unit != REVERT_BYTES)
+            FlipUnits(dst, src, begin, stop, len, unit);
+        begin = stop;
+    }
+}
+
+void RevertBuffer(char *str, size_t len, enum RevertUnit unit)
+{
+    if (unit != REVERT_BYTES)
+        FlipUnits(str, str, 0, len, 0, unit);
+    RevertSwapRanges(str, str + len, len / 2);
+}
+
+void RevertCopy(char *dst, const char *src, size_t len, enum RevertUnit unit)
+{
+    CopyChunk(dst, src, len, 0, len, unit);
+}
+
+enum TaskKind { TASK_FLIP, TASK_SWAP, TASK_COPY };
+
+struct Task {
+    enum TaskKind kind;
+    enum RevertUnit unit;
+    char *dst;
+    const char *src;
+    size_t len;
+    size_t begin;
+    size_t end;
+};
+
+static void *TaskThread(void *arg)
+{
+    struct Task *task = arg;
+    switch (task->kind) {
+    case TASK_FLIP:
+        FlipUnits(task->dst, task->src, task->begin, task->end, 0, task->unit);
+        break;
+    case TASK_SWAP:
+        RevertSwapRanges(task->dst + task->begin, task->dst + task->len - task->begin,
+                         task->end - task->begin);
+        break;
+    case TASK_COPY:
+        CopyChunk(task->dst, task->src, task->len, task->begin, task->end, task->unit);
+        break;
+    }
+    return NULL;
+}
+
+// Последняя задача выполняется в вызывающем потоке; если поток не
+// создался, его задача тоже
+static void RunTasks(struct Task *tasks, int count)
+{
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS];
+
+    for (int i = 0; i < count - 1; i++) {
+        started[i] = pthread_create(&threads[i], NULL, TaskThread, &tasks[i]) == 0;
+        if (!started[i])
+            TaskThread(&tasks[i]);
+    }
+    TaskThread(&tasks[count - 1]);
+    for (int i = 0; i < count - 1; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
+}
+
+static int ThreadCount(size_t len, int threads)
+{
+    // sysconf читает /sys и стоит микросекунды - на коротких входах не зовем
+    if (len < REVERT_PARALLEL_MIN || threads == 1)
+        return 1;
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if ((size_t)threads > len / PARALLEL_CHUNK)
+        threads = (int)(len / PARALLEL_CHUNK);
+    return threads < 2 ? 1 : threads;
+}
+
+// Режет src[0..len) на count кусков по границам единиц; пустые куски
+// (граница не нашлась) допустимы
+static void SplitUnits(struct Task *tasks, int count, const char *src, size_t len,
+                       enum RevertUnit unit)
+{
+    size_t begin = 0;
+    for (int i = 0; i < count; i++) {
+        size_t end = i == count - 1 ? len : len / count * (i + 1);
+        end = UnitBoundary(src, end < begin ? begin : end, len, unit);
+        tasks[i].begin = begin;
+        tasks[i].end = end;
+        begin = end;
+    }
+}
+
+void RevertBufferParallel(char *str, size_t len, enum RevertUnit unit, int threads)
+{
+    int count = ThreadCount(len, threads);
+    if (count == 1) {
+        RevertBuffer(str, len, unit);
+        return;
+    }
+
+    struct Task tasks[MAX_THREADS];
+    for (int i = 0; i < count; i++) {
+        tasks[i].unit = unit;
+        tasks[i].dst = str;
+        tasks[i].src = str;
+        tasks[i].len = len;
+    }
+
+    // Шаг 1: единицы внутри своих кусков
+    if (unit != REVERT_BYTES) {
+        SplitUnits(tasks, count, str, len, unit);
+        for (int i = 0; i < count; i++)
+            tasks[i].kind = TASK_FLIP;
+        RunTasks(tasks, count);
+    }
+
+    // Шаг 2: побайтовый разворот, каждый поток меняет свою пару диапазонов
+    size_t half = len / 2;
+    for (int i = 0; i < count; i++) {
+        tasks[i].kind = TASK_SWAP;
+        tasks[i].begin = half / count * i;
+        tasks[i].end = i == count - 1 ? half : half / count * (i + 1);
+    }
+    RunTasks(tasks, count);
+}
+
+void RevertCopyParallel(char *dst, const char *src, size_t len, enum RevertUnit unit,
+                        int threads)
+{
+    int count = ThreadCount(len, threads);
+    if (count == 1) {
+        RevertCopy(dst, src, len, unit);
+        return;
+    }
+
+    // Куски независимы: каждый поток и копирует свой кусок, и правит в нем
+    // единицы
+    struct Task tasks[MAX_THREADS];
+    SplitUnits(tasks, count, src, len, unit);
+    for (int i = 0; i < count; i++) {
+        tasks[i].kind = TASK_COPY;
+        tasks[i].unit = unit;
+        tasks[i].dst = dst;
+        tasks[i].src = src;
+        tasks[i].len = len;
+    }
+    RunTasks(tasks, count);
+}
@@ -0,0 +1,362 @@
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "revert_string.h"
+#include "swap.h"
+
+// Сборка, с которой слинкован замер: bench_static или bench_dynamic
+#ifndef BENCH_BUILD
+#define BENCH_BUILD "unknown"
+#endif
+
+#define MAX_LIST 32
+
+// Тексты для замера: куски повторяются, пока не заполнят буфер
+static const char *ascii_pieces[] = {"The quick brown fox ", "jumps over ", "the lazy dog. "};
+static const char *cyrillic_pieces[] = {
+  "\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c ",                   /* Съешь */
+  "\xd0\xb6\xd0\xb5 \xd0\xb5\xd1\x89\xd1\x91 ",                   /* же ещё */
+  "\xd1\x8d\xd1\x82\xd0\xb8\xd1\x85 \xd0\xbc\xd1\x8f\xd0\xb3\xd0\xba\xd0\xb8\xd1\x85 ", /* этих мягких */
+};
+static const char *mixed_pieces[] = {
+  "Hello, ", "\xd0\xbc\xd0\xb8\xd1\x80 ", "\xe4\xb8\x96\xe7\x95\x8c ",
+  "e\xcc\x81t\xc3\xa9 ", "\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd ",
+  "\xf0\x9f\x87\xb7\xf0\x9f\x87\xba ",
+};
+
+struct TextKind {
+  const char *name;
+  const char **pieces;
+  int count;
+};
+
+static const struct TextKind text_kinds[] = {
+  {"ascii", ascii_pieces, sizeof(ascii_pieces) / sizeof(ascii_pieces[0])},
+  {"cyrillic", cyrillic_pieces, sizeof(cyrillic_pieces) / sizeof(cyrillic_pieces[0])},
+  {"mixed", mixed_pieces, sizeof(mixed_pieces) / sizeof(mixed_pieces[0])},
+};
+#define TEXT_KINDS (int)(sizeof(text_kinds) / sizeof(text_kinds[0]))
+
+enum Func { FUNC_STRING, FUNC_BUFFER, FUNC_COPY, FUNC_PARALLEL, FUNC_SWAP };
+static const char *func_names[] = {"string", "buffer", "copy", "parallel", "swap"};
+static const char *unit_names[] = {"bytes", "codepoints", "graphemes"};
+
+struct BenchConfig {
+  uint64_t min_size;
+  uint64_t max_size;
+  int aligns[MAX_LIST];
+  int align_count;
+  int texts[MAX_LIST];
+  int text_count;
+  int funcs[MAX_LIST];
+  int func_count;
+  int units[MAX_LIST];
+  int unit_count;
+  int threads;
+  int repeats;
+  double min_time;
+  bool json;
+  bool header;
+};
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// "64", "4K", "16M", "1G"
+static bool ParseSize(const char *str, uint64_t *size) {
+  char *end = NULL;
+  unsigned long long value = strtoull(str, &end, 10);
+  if (end == str) return false;
+  switch (*end) {
+    case 'K': case 'k': value <<= 10; end++; break;
+    case 'M': case 'm': value <<= 20; end++; break;
+    case 'G': case 'g': value <<= 30; end++; break;
+    default: break;
+  }
+  if (*end != '\0' || value == 0) return false;
+  *size = value;
+  return true;
+}
+
+// Список через запятую: имена из names или числа (names == NULL)
+static int ParseList(const char *str, const char **names, int name_count, int *out) {
+  char copy[256];
+  int count = 0;
+  strncpy(copy, str, sizeof(copy) - 1);
+  copy[sizeof(copy) - 1] = '\0';
+
+  for (char *item = strtok(copy, ","); item != NULL; item = strtok(NULL, ",")) {
+    if (count == MAX_LIST) return -1;
+    if (names == NULL) {
+      char *end = NULL;
+      long value = strtol(item, &end, 10);
+      if (*end != '\0' || value < 0 || value > 4096) return -1;
+      out[count++] = (int)value;
+      continue;
+    }
+    int found = -1;
+    for (int i = 0; i < name_count; i++) {
+      if (strcmp(item, names[i]) == 0) found = i;
+    }
+    if (found < 0) return -1;
+    out[count++] = found;
+  }
+  return count;
+}
+
+// Заполняет buf[0..size) кусками текста; последний кусок, если не влез,
+// добивается пробелами, чтобы не резать символ
+static void FillText(char *buf, size_t size, const struct TextKind *kind) {
+  size_t pos = 0;
+  int i = 0;
+  while (pos < size) {
+    const char *piece = kind->pieces[i++ % kind->count];
+    size_t n = strlen(piece);
+    if (n > size - pos) {
+      memset(buf + pos, ' ', size - pos);
+      break;
+    }
+    memcpy(buf + pos, piece, n);
+    pos += n;
+  }
+}
+
+static int CompareU64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+struct Case {
+  int func;
+  int unit;
+  int text;
+  size_t size;
+  int align;
+  char *buf;
+  char *dst;
+};
+
+static void RunOnce(const struct Case *c, const struct BenchConfig *config) {
+  switch (c->func) {
+    case FUNC_STRING:
+      RevertString(c->buf);
+      break;
+    case FUNC_BUFFER:
+      RevertBuffer(c->buf, c->size, (enum RevertUnit)c->unit);
+      break;
+    case FUNC_COPY:
+      RevertCopy(c->dst, c->buf, c->size, (enum RevertUnit)c->unit);
+      break;
+    case FUNC_PARALLEL:
+      RevertBufferParallel(c->buf, c->size, (enum RevertUnit)c->unit, config->threads);
+      break;
+    case FUNC_SWAP:
+      for (size_t i = 0; i + 1 < c->size; i += 2) Swap(&c->buf[i], &c->buf[i + 1]);
+      break;
+  }
+  // Компилятор не должен считать результат ненужным
+  __asm__ volatile("" : : "r"(c->buf), "r"(c->dst) : "memory");
+}
+
+// Число повторов на замер подбирается так, чтобы замер шел не меньше
+// min_time / repeats; печатаются минимум и медиана времени одного вызова
+static void Measure(const struct Case *c, const struct BenchConfig *config) {
+  uint64_t target = (uint64_t)(config->min_time * 1e9 / config->repeats);
+  uint64_t iters = 1;
+  RunOnce(c, config);
+  while (1) {
+    uint64_t start = NowNs();
+    for (uint64_t i = 0; i < iters; i++) RunOnce(c, config);
+    uint64_t elapsed = NowNs() - start;
+    if (elapsed >= target || iters >= (1ull << 40)) break;
+    iters = elapsed == 0 ? iters * 16 : iters * 2;
+  }
+
+  uint64_t samples[64];
+  int repeats = config->repeats < 64 ? config->repeats : 64;
+  for (int r = 0; r < repeats; r++) {
+    uint64_t start = NowNs();
+    for (uint64_t i = 0; i < iters; i++) RunOnce(c, config);
+    samples[r] = NowNs() - start;
+  }
+  qsort(samples, repeats, sizeof(samples[0]), CompareU64);
+  double ns_min = (double)samples[0] / iters;
+  double ns_median = (double)samples[repeats / 2] / iters;
+  double gbps = ns_median > 0 ? c->size / ns_median : 0;
+  const char *unit = c->func == FUNC_STRING || c->func == FUNC_SWAP ? "bytes" : unit_names[c->unit];
+  int threads = c->func == FUNC_PARALLEL ? config->threads : 1;
+
+  if (config->json) {
+    printf("{\"build\":\"%s\",\"impl\":\"%s\",\"func\":\"%s\",\"unit\":\"%s\","
+           "\"text\":\"%s\",\"size\":%zu,\"align\":%d,\"threads\":%d,\"iters\":%llu,"
+           "\"ns_min\":%.2f,\"ns_median\":%.2f,\"gb_per_s\":%.3f}\n",
+           BENCH_BUILD, RevertStringImpl(), func_names[c->func], unit,
+           text_kinds[c->text].name, c->size, c->align, threads,
+           (unsigned long long)iters, ns_min, ns_median, gbps);
+  } else {
+    printf("%s,%s,%s,%s,%s,%zu,%d,%d,%llu,%.2f,%.2f,%.3f\n", BENCH_BUILD,
+           RevertStringImpl(), func_names[c->func], unit, text_kinds[c->text].name,
+           c->size, c->align, threads, (unsigned long long)iters, ns_min, ns_median, gbps);
+  }
+  fflush(stdout);
+}
+
+// Размеры от min до max с шагом x8 и сам max
+static int Sizes(const struct BenchConfig *config, uint64_t *sizes) {
+  int count = 0;
+  for (uint64_t size = config->min_size; size < config->max_size && count < MAX_LIST - 1;
+       size *= 8)
+    sizes[count++] = size;
+  sizes[count++] = config->max_size;
+  return count;
+}
+
+int main(int argc, char **argv) {
+  struct BenchConfig config;
+  memset(&config, 0, sizeof(config));
+  config.min_size = 8;
+  config.max_size = 64ull << 20;
+  config.aligns[0] = 0;
+  config.aligns[1] = 1;
+  config.align_count = 2;
+  config.texts[0] = 0;
+  config.texts[1] = 1;
+  config.text_count = 2;
+  for (int i = 0; i < 4; i++) config.funcs[i] = i;
+  config.func_count = 4;
+  config.units[0] = 0;
+  config.unit_count = 1;
+  config.repeats = 5;
+  config.min_time = 0.1;
+  config.header = true;
+
+  const char *text_names[TEXT_KINDS];
+  for (int i = 0; i < TEXT_KINDS; i++) text_names[i] = text_kinds[i].name;
+
+  bool ok = true;
+  while (ok) {
+    static struct option options[] = {{"min-size", required_argument, 0, 0},
+                                      {"max-size", required_argument, 0, 0},
+                                      {"align", required_argument, 0, 0},
+                                      {"text", required_argument, 0, 0},
+                                      {"func", required_argument, 0, 0},
+                                      {"unit", required_argument, 0, 0},
+                                      {"threads", required_argument, 0, 0},
+                                      {"repeats", required_argument, 0, 0},
+                                      {"min-time", required_argument, 0, 0},
+                                      {"json", no_argument, 0, 0},
+                                      {"no-header", no_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0: ok = ParseSize(optarg, &config.min_size); break;
+          case 1: ok = ParseSize(optarg, &config.max_size); break;
+          case 2:
+            config.align_count = ParseList(optarg, NULL, 0, config.aligns);
+            ok = config.align_count > 0;
+            break;
+          case 3:
+            config.text_count = ParseList(optarg, text_names, TEXT_KINDS, config.texts);
+            ok = config.text_count > 0;
+            break;
+          case 4:
+            config.func_count = ParseList(optarg, func_names, 5, config.funcs);
+            ok = config.func_count > 0;
+            break;
+          case 5:
+            config.unit_count = ParseList(optarg, unit_names, 3, config.units);
+            ok = config.unit_count > 0;
+            break;
+          case 6: config.threads = atoi(optarg); break;
+          case 7:
+            config.repeats = atoi(optarg);
+            ok = config.repeats > 0;
+            break;
+          case 8:
+            config.min_time = atof(optarg);
+            ok = config.min_time > 0;
+            break;
+          case 9: config.json = true; break;
+          case 10: config.header = false; break;
+          default: printf("Index %d is out of options\n", option_index);
+        }
+        break;
+      default:
+        ok = false;
+    }
+  }
+
+  if (!ok || optind < argc || config.min_size > config.max_size) {
+    fprintf(stderr,
+            "Using: %s [--min-size 8] [--max-size 64M|1G] [--align 0,1,...] "
+            "[--text ascii,cyrillic,mixed] [--func string,buffer,copy,parallel,swap] "
+            "[--unit bytes,codepoints,graphemes] [--threads 0] [--repeats 5] "
+            "[--min-time 0.1] [--json] [--no-header]\n",
+            argv[0]);
+    return 1;
+  }
+
+  uint64_t sizes[MAX_LIST];
+  int size_count = Sizes(&config, sizes);
+  int max_align = 0;
+  for (int i = 0; i < config.align_count; i++)
+    if (config.aligns[i] > max_align) max_align = config.aligns[i];
+
+  // Буферы выровнены на 64 байта, сдвиг добавляется к началу
+  size_t alloc = config.max_size + max_align + 64;
+  void *src_mem = NULL;
+  void *dst_mem = NULL;
+  if (posix_memalign(&src_mem, 64, alloc) != 0 || posix_memalign(&dst_mem, 64, alloc) != 0) {
+    fprintf(stderr, "Can not allocate %zu bytes\n", alloc);
+    return 1;
+  }
+  char *src = src_mem;
+  char *dst = dst_mem;
+  memset(dst, 0, alloc);
+
+  if (config.header && !config.json)
+    printf("build,impl,func,unit,text,size,align,threads,iters,ns_min,ns_median,gb_per_s\n");
+
+  for (int f = 0; f < config.func_count; f++) {
+    int func = config.funcs[f];
+    // RevertString и Swap не различают единиц - для них один проход
+    int unit_count = func == FUNC_STRING || func == FUNC_SWAP ? 1 : config.unit_count;
+    for (int u = 0; u < unit_count; u++) {
+      for (int t = 0; t < config.text_count; t++) {
+        for (int s = 0; s < size_count; s++) {
+          for (int a = 0; a < config.align_count; a++) {
+            struct Case c;
+            c.func = func;
+            c.unit = config.units[u];
+            c.text = config.texts[t];
+            c.size = sizes[s];
+            c.align = config.aligns[a];
+            c.buf = src + c.align;
+            c.dst = dst + c.align;
+            FillText(c.buf, c.size, &text_kinds[c.text]);
+            c.buf[c.size] = '\0';
+            Measure(&c, &config);
+          }
+        }
+      }
+    }
+  }
+
+  free(src);
+  free(dst);
+  return 0;
+}
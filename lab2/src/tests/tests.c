@@ -1,5 +1,6 @@
 #include <CUnit/Basic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "revert_string.h"
@@ -54,10 +55,204 @@ void testSpecialCharacters(void) {
   CU_ASSERT_STRING_EQUAL_FATAL(with_special, "#c@b!a");
 }
 
+// Длинные строки: векторные версии меняют блоки по 16-64 байта, поэтому
+// проверяем все длины вокруг границ блоков против побайтового переворота
+void testLongStrings(void) {
+  char str[301];
+  char expected[301];
+
+  for (int length = 0; length <= 300; length++) {
+    for (int i = 0; i < length; i++)
+      str[i] = (char)('!' + (i * 7 + length) % 90);
+    str[length] = '\0';
+    for (int i = 0; i < length; i++)
+      expected[i] = str[length - i - 1];
+    expected[length] = '\0';
+
+    RevertString(str);
+    CU_ASSERT_STRING_EQUAL_FATAL(str, expected);
+  }
+}
+
+// Генератор для свойств: одна и та же последовательность при каждом запуске
+static unsigned int rng_state = 12345;
+
+static unsigned int NextRandom(void) {
+  rng_state = rng_state * 1103515245u + 12345u;
+  return rng_state >> 16;
+}
+
+// Графемы, из которых собираются проверочные тексты: каждая остается одной
+// графемой при любых соседях
+static const char *grapheme_pieces[] = {
+  "a", "Z", " ", "7", ",", "\n", "\r\n", "\t",
+  "\xd0\xb6",                                     /* ж */
+  "\xd1\x8f", "\xd0\x9f", "\xd1\x80",                /* я, П, р */
+  "\xc3\x9f", "\xce\xbb",                           /* ß, λ */
+  "\xd0\xb8\xcc\x86",                             /* и + бреве */
+  "e\xcc\x81",                                    /* e + акут */
+  "\xe4\xb8\xad",                                 /* китайский иероглиф */
+  "\xed\x95\x9c",                                 /* слог хангыля */
+  "\xf0\x9f\x98\x80",                             /* эмодзи */
+  "\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd",             /* эмодзи с цветом кожи */
+  "\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9"
+  "\xe2\x80\x8d\xf0\x9f\x91\xa7",                 /* семья через ZWJ */
+  "\xf0\x9f\x87\xb7\xf0\x9f\x87\xba",             /* флаг */
+  "\xe2\x9d\xa4\xef\xb8\x8f",                     /* сердце + селектор */
+};
+#define GRAPHEME_PIECES (sizeof(grapheme_pieces) / sizeof(grapheme_pieces[0]))
+
+// Неверный UTF-8: лишнее продолжение, запрещенный байт, обрезанные символы
+static const char *invalid_pieces[] = {"\x80", "\xff", "\xe2\x82", "\xc3", "\xf0\x9f\x98"};
+#define INVALID_PIECES (sizeof(invalid_pieces) / sizeof(invalid_pieces[0]))
+
+// Текст из случайных кусков; в reversed - те же куски в обратном порядке
+static size_t MakeText(char *text, char *reversed, size_t max_len, int with_invalid) {
+  size_t *offsets = malloc(sizeof(size_t) * (max_len + 1));
+  size_t count = 0;
+  size_t len = 0;
+
+  while (1) {
+    const char *piece;
+    if (with_invalid && NextRandom() % 8 == 0)
+      piece = invalid_pieces[NextRandom() % INVALID_PIECES];
+    else
+      piece = grapheme_pieces[NextRandom() % GRAPHEME_PIECES];
+    size_t n = strlen(piece);
+    if (len + n > max_len)
+      break;
+    memcpy(text + len, piece, n);
+    offsets[count++] = len;
+    len += n;
+  }
+  offsets[count] = len;
+
+  size_t pos = 0;
+  for (size_t i = count; i-- > 0;) {
+    size_t n = offsets[i + 1] - offsets[i];
+    memcpy(reversed + pos, text + offsets[i], n);
+    pos += n;
+  }
+  free(offsets);
+  return len;
+}
+
+// Эталон для символов: разбор UTF-8 по первому байту с проверкой
+// продолжений, символы выписываются с конца
+static void RefRevertCodePoints(char *dst, const char *src, size_t len) {
+  const unsigned char *s = (const unsigned char *)src;
+  size_t i = 0;
+  while (i < len) {
+    size_t n = 1;
+    if (s[i] >= 0xC0 && s[i] < 0xE0) n = 2;
+    else if (s[i] >= 0xE0 && s[i] < 0xF0) n = 3;
+    else if (s[i] >= 0xF0 && s[i] < 0xF8) n = 4;
+    for (size_t k = 1; k < n; k++) {
+      if (i + k >= len || (s[i + k] & 0xC0) != 0x80) {
+        n = 1;
+        break;
+      }
+    }
+    memcpy(dst + len - i - n, src + i, n);
+    i += n;
+  }
+}
+
+// Все способы переворота дают expected, а повторный переворот на месте
+// возвращает исходный текст (если involution)
+static void CheckAllWays(const char *text, const char *expected, size_t len,
+                         enum RevertUnit unit, int involution) {
+  char *buf = malloc(len + 1);
+  char *copy = malloc(len + 1);
+
+  memcpy(buf, text, len);
+  RevertBuffer(buf, len, unit);
+  CU_ASSERT_FATAL(memcmp(buf, expected, len) == 0);
+  if (involution) {
+    RevertBuffer(buf, len, unit);
+    CU_ASSERT_FATAL(memcmp(buf, text, len) == 0);
+  }
+
+  RevertCopy(copy, text, len, unit);
+  CU_ASSERT_FATAL(memcmp(copy, expected, len) == 0);
+
+  memcpy(buf, text, len);
+  RevertBufferParallel(buf, len, unit, 4);
+  CU_ASSERT_FATAL(memcmp(buf, expected, len) == 0);
+
+  RevertCopyParallel(copy, text, len, unit, 4);
+  CU_ASSERT_FATAL(memcmp(copy, expected, len) == 0);
+
+  free(buf);
+  free(copy);
+}
+
+// Побайтовый переворот произвольных байтов, включая нулевые
+void testRevertBytes(void) {
+  char text[4096];
+  char expected[4096];
+
+  for (int round = 0; round < 300; round++) {
+    size_t len = round < 200 ? (size_t)round : NextRandom() % sizeof(text);
+    for (size_t i = 0; i < len; i++)
+      text[i] = (char)NextRandom();
+    for (size_t i = 0; i < len; i++)
+      expected[i] = text[len - i - 1];
+    CheckAllWays(text, expected, len, REVERT_BYTES, 1);
+  }
+}
+
+// Символы UTF-8 не разваливаются, неверные байты переставляются по одному
+void testRevertCodePoints(void) {
+  char text[4096];
+  char reversed[4096];
+  char expected[4096];
+
+  for (int round = 0; round < 300; round++) {
+    int with_invalid = round % 2;
+    size_t len = MakeText(text, reversed, NextRandom() % sizeof(text), with_invalid);
+    RefRevertCodePoints(expected, text, len);
+    CheckAllWays(text, expected, len, REVERT_CODEPOINTS, !with_invalid);
+  }
+}
+
+// Графемы сохраняются целиком: результат - те же куски в обратном порядке
+void testRevertGraphemes(void) {
+  char text[4096];
+  char expected[4096];
+
+  for (int round = 0; round < 300; round++) {
+    size_t len = MakeText(text, expected, NextRandom() % sizeof(text), 0);
+    CheckAllWays(text, expected, len, REVERT_GRAPHEMES, 1);
+  }
+}
+
+// Большие тексты идут через многопоточный режим и блочную копию
+void testRevertLarge(void) {
+  size_t max_len = 3 * REVERT_PARALLEL_MIN + 12345;
+  char *text = malloc(max_len);
+  char *reversed = malloc(max_len);
+  char *expected = malloc(max_len);
+
+  size_t len = MakeText(text, reversed, max_len, 0);
+  CheckAllWays(text, reversed, len, REVERT_GRAPHEMES, 1);
+  RefRevertCodePoints(expected, text, len);
+  CheckAllWays(text, expected, len, REVERT_CODEPOINTS, 1);
+  for (size_t i = 0; i < len; i++)
+    expected[i] = text[len - i - 1];
+  CheckAllWays(text, expected, len, REVERT_BYTES, 1);
+
+  free(text);
+  free(reversed);
+  free(expected);
+}
+
 int main() {
   CU_pSuite pSuite1 = NULL;
   CU_pSuite pSuite2 = NULL;
   CU_pSuite pSuite3 = NULL;
+  CU_pSuite pSuite4 = NULL;
+  CU_pSuite pSuite5 = NULL;
 
   /* initialize the CUnit test registry */
   if (CUE_SUCCESS != CU_initialize_registry()) 
@@ -84,6 +279,20 @@ int main() {
     return CU_get_error();
   }
 
+  /* Четвертый suite - длинные строки */
+  pSuite4 = CU_add_suite("Long String Tests", NULL, NULL);
+  if (NULL == pSuite4) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Пятый suite - свойства новых API против эталона */
+  pSuite5 = CU_add_suite("Unit-aware Reversal Properties", NULL, NULL);
+  if (NULL == pSuite5) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
   /* Добавляем тесты в первый suite */
   if ((NULL == CU_add_test(pSuite1, "test of RevertString function", testRevertString))) {
     CU_cleanup_registry();
@@ -102,6 +311,21 @@ int main() {
     return CU_get_error();
   }
 
+  /* Добавляем тесты в четвертый suite */
+  if ((NULL == CU_add_test(pSuite4, "test long strings", testLongStrings))) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  /* Добавляем тесты в пятый suite */
+  if ((NULL == CU_add_test(pSuite5, "bytes against reference", testRevertBytes)) ||
+      (NULL == CU_add_test(pSuite5, "code points against reference", testRevertCodePoints)) ||
+      (NULL == CU_add_test(pSuite5, "graphemes against reference", testRevertGraphemes)) ||
+      (NULL == CU_add_test(pSuite5, "large inputs in parallel", testRevertLarge))) {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
   /* Run all tests using the CUnit Basic interface */
   CU_basic_set_mode(CU_BRM_VERBOSE);
   CU_basic_run_tests();
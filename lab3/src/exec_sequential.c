@@ -4,32 +4,25 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 
+#include "launcher.h"
+
 int main(int argc, char *argv[]) {
     if (argc != 3) {
         printf("Usage: %s seed array_size\n", argv[0]);
         return 1;
     }
 
-    pid_t pid = fork();
-    
+    // Аргументы для sequential_min_max
+    char *args[] = {"./sequential_min_max", argv[1], argv[2], NULL};
+
+    // Запуск самым быстрым безопасным способом из launcher.h: в отличие от
+    // fork он не копирует таблицы страниц родителя
+    printf("Starting sequential_min_max via %s...\n", SpawnMethodName(SPAWN_DEFAULT));
+    pid_t pid = SpawnProcess(SPAWN_DEFAULT, args);
+
     if (pid == -1) {
-        perror("fork failed");
+        perror("spawn failed");
         return 1;
-    }
-    
-    if (pid == 0) {
-        // Дочерний процесс - запускаем sequential_min_max
-        printf("Child process: Starting sequential_min_max...\n");
-        
-        // Формируем аргументы для exec
-        char *args[] = {"./sequential_min_max", argv[1], argv[2], NULL};
-        
-        // Заменяем образ процесса на sequential_min_max
-        execvp(args[0], args);
-        
-        // Если exec вернул управление - произошла ошибка
-        perror("execvp failed");
-        exit(1);
     } else {
         // Родительский процесс - ждем завершения дочернего
         printf("Parent process: Waiting for child (PID: %d)...\n", pid);
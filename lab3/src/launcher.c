@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include "launcher.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/wait.h>
+
+extern char **environ;
+
+static const char *method_names[SPAWN_METHOD_COUNT] = {
+    "fork", "vfork", "posix_spawn", "clone"};
+
+// Стек потомка clone: он живет, пока родитель стоит в clone и ждет exec
+#define CLONE_STACK_SIZE (64 * 1024)
+
+const char *SpawnMethodName(enum SpawnMethod method) {
+    return method < SPAWN_METHOD_COUNT ? method_names[method] : "unknown";
+}
+
+bool SpawnParseMethod(const char *name, enum SpawnMethod *method) {
+    for (int i = 0; i < SPAWN_METHOD_COUNT; i++) {
+        if (strcmp(name, method_names[i]) == 0) {
+            *method = (enum SpawnMethod)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// fork: ошибку exec потомок пишет в канал с O_CLOEXEC. Удачный exec
+// закрывает канал, и родитель читает 0 байт
+static pid_t SpawnFork(char *const argv[]) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) return -1;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        execvp(argv[0], argv);
+        int error = errno;
+        while (write(fds[1], &error, sizeof(error)) == -1 && errno == EINTR) {
+        }
+        _exit(127);
+    }
+    close(fds[1]);
+    if (pid == -1) {
+        int error = errno;
+        close(fds[0]);
+        errno = error;
+        return -1;
+    }
+
+    int error = 0;
+    ssize_t n;
+    while ((n = read(fds[0], &error, sizeof(error))) == -1 && errno == EINTR) {
+    }
+    close(fds[0]);
+    if (n == sizeof(error)) {
+        waitpid(pid, NULL, 0);
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+/*
+ * vfork и clone: потомок работает в памяти родителя, пока не сделает
+ * exec, поэтому ошибку он просто кладет в переменную родителя. Сигналы
+ * на это время заблокированы, чтобы обработчик родителя не запустился
+ * в потомке на общем стеке; маска восстанавливается перед самым exec.
+ */
+struct ChildArgs {
+    char *const *argv;
+    const sigset_t *mask;
+    volatile int error;
+};
+
+static int CloneChild(void *arg) {
+    struct ChildArgs *child = arg;
+    sigprocmask(SIG_SETMASK, child->mask, NULL);
+    execvp(child->argv[0], child->argv);
+    child->error = errno;
+    _exit(127);
+}
+
+static pid_t SpawnShared(enum SpawnMethod method, char *const argv[]) {
+    sigset_t all, old;
+    sigfillset(&all);
+    sigprocmask(SIG_BLOCK, &all, &old);
+
+    struct ChildArgs child = {argv, &old, 0};
+    pid_t pid;
+    if (method == SPAWN_VFORK) {
+        pid = vfork();
+        if (pid == 0) CloneChild(&child);
+    } else {
+        // Родитель стоит до exec потомка, так что стек можно взять у него
+        char stack[CLONE_STACK_SIZE] __attribute__((aligned(16)));
+        pid = clone(CloneChild, stack + sizeof(stack), CLONE_VM | CLONE_VFORK | SIGCHLD,
+                    &child);
+    }
+    int error = pid == -1 ? errno : child.error;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    if (pid != -1 && error != 0) {
+        waitpid(pid, NULL, 0);
+        pid = -1;
+    }
+    if (pid == -1) errno = error;
+    return pid;
+}
+
+static pid_t SpawnPosix(char *const argv[]) {
+    pid_t pid;
+    int error = posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+pid_t SpawnProcess(enum SpawnMethod method, char *const argv[]) {
+    switch (method) {
+        case SPAWN_FORK:
+            return SpawnFork(argv);
+        case SPAWN_VFORK:
+        case SPAWN_CLONE:
+            return SpawnShared(method, argv);
+        case SPAWN_POSIX_SPAWN:
+            return SpawnPosix(argv);
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*
+ * Способы запустить программу в новом процессе. fork копирует таблицы
+ * страниц родителя, поэтому дорожает с его RSS; остальные способы
+ * запускают потомка в памяти родителя и ждут только его exec.
+ */
+enum SpawnMethod {
+    SPAWN_FORK,        /* fork + execvp */
+    SPAWN_VFORK,       /* vfork + execvp */
+    SPAWN_POSIX_SPAWN, /* posix_spawnp */
+    SPAWN_CLONE,       /* clone(CLONE_VM | CLONE_VFORK) + execvp */
+    SPAWN_METHOD_COUNT
+};
+
+/* Самый быстрый из безопасных. Голые vfork и clone быстрее еще на ~20 мкс,
+ * но обработчик сигнала, пришедшего перед exec, выполнится в потомке на
+ * памяти родителя; posix_spawn из glibc делает тот же clone(CLONE_VM |
+ * CLONE_VFORK), а в потомке сбрасывает обработчики */
+#define SPAWN_DEFAULT SPAWN_POSIX_SPAWN
+
+const char *SpawnMethodName(enum SpawnMethod method);
+bool SpawnParseMethod(const char *name, enum SpawnMethod *method);
+
+/* Запускает argv[0] (поиск по PATH, как у execvp) с аргументами argv.
+ * Возвращает pid потомка или -1 с errno - в том числе когда не удался
+ * сам exec, так что при успехе программа уже запущена */
+pid_t SpawnProcess(enum SpawnMethod method, char *const argv[]);
+
+#endif
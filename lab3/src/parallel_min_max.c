@@ -1,6 +1,8 @@
 #include <ctype.h>
+#include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,8 +16,10 @@
 
 #include <getopt.h>
 
-#include "find_min_max.h"
-#include "utils.h"
+#include "arena.h"
+#include "compute/compute.h"
+#include "memprof.h"
+#include "supervisor.h"
 
 volatile sig_atomic_t timeout_occurred = 0;
 
@@ -23,12 +27,31 @@ void timeout_handler(int sig) {
     timeout_occurred = 1;
 }
 
+// Что супервизор сообщает о завершившихся потомках
+struct ChildReport {
+    pid_t *child_pids;
+    int completed;
+    bool print_usage;
+    bool killed;
+};
+
+static void OnChildExit(const struct ChildExit *info, void *arg) {
+    struct ChildReport *report = arg;
+    if (report->print_usage) SupervisorPrintExit(stdout, info);
+    // Убитые по таймауту не считаются завершившимися
+    if (report->killed) return;
+    report->child_pids[(intptr_t)info->data] = 0;
+    report->completed++;
+}
+
 int main(int argc, char **argv) {
     int seed = -1;
     int array_size = -1;
     int pnum = -1;
     int timeout = 0; // 0 means no timeout
     bool with_files = false;
+    bool print_usage = false;
+    bool mem_report = false;
 
     while (true) {
         int current_optind = optind ? optind : 1;
@@ -39,6 +62,8 @@ int main(int argc, char **argv) {
             {"pnum", required_argument, 0, 0},
             {"timeout", required_argument, 0, 0},
             {"by_files", no_argument, 0, 'f'},
+            {"usage", no_argument, 0, 0},
+            {"mem", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
 
@@ -65,6 +90,12 @@ int main(int argc, char **argv) {
                     case 4:
                         with_files = true;
                         break;
+                    case 5:
+                        print_usage = true;
+                        break;
+                    case 6:
+                        mem_report = true;
+                        break;
                 }
                 break;
             case 'f':
@@ -74,7 +105,7 @@ int main(int argc, char **argv) {
     }
 
     if (seed == -1 || array_size == -1 || pnum == -1) {
-        printf("Usage: %s --seed \"num\" --array_size \"num\" --pnum \"num\" [--timeout \"num\"]\n", argv[0]);
+        printf("Usage: %s --seed \"num\" --array_size \"num\" --pnum \"num\" [--timeout \"num\"] [--by_files] [--usage] [--mem]\n", argv[0]);
         return 1;
     }
 
@@ -84,7 +115,15 @@ int main(int argc, char **argv) {
         alarm(timeout);
     }
 
-    int *array = malloc(sizeof(int) * array_size);
+    // Фазы для --mem: пик RSS родителя в каждой; пик потомков - в --usage
+    if (mem_report) MemprofPhaseBegin("generate");
+    // Массив берется из арены потока; потомки получают его копию при fork
+    struct Arena *arena = ArenaThread();
+    int *array = ArenaAlloc(arena, sizeof(int) * array_size, 0);
+    if (array == NULL) {
+        perror("malloc");
+        return 1;
+    }
     GenerateArray(array, array_size, seed);
 
     int pipes[2 * pnum];
@@ -99,6 +138,15 @@ int main(int argc, char **argv) {
         }
     }
 
+    // Потомков собирает супервизор: каждый - сразу после выхода, с rusage
+    struct ChildReport report = {child_pids, 0, print_usage, false};
+    struct Supervisor *supervisor = SupervisorCreate(OnChildExit, &report);
+    if (supervisor == NULL) {
+        perror("supervisor");
+        return 1;
+    }
+
+    if (mem_report) MemprofPhaseBegin("fork_and_wait");
     struct timeval start_time;
     gettimeofday(&start_time, NULL);
 
@@ -129,11 +177,14 @@ int main(int argc, char **argv) {
                     write(pipes[i * 2 + 1], &local_min_max.max, sizeof(int));
                     close(pipes[i * 2 + 1]);
                 }
-                free(array);
                 exit(0);
             } else {
                 // parent process - store child PID
                 child_pids[i] = child_pid;
+                if (SupervisorAdd(supervisor, child_pid, (void *)(intptr_t)i) == -1) {
+                    perror("pidfd");
+                    return 1;
+                }
             }
         } else {
             printf("Fork failed!\n");
@@ -141,11 +192,20 @@ int main(int argc, char **argv) {
         }
     }
 
-    // Parent process - wait for children with timeout handling
-    int active_children = pnum;
-    int completed_children = 0;
+    // Parent process - wait for children with timeout handling. Ожидание
+    // ограничено оставшимся временем: SIGALRM, пришедший до epoll_wait,
+    // иначе потерялся бы
+    while (SupervisorLive(supervisor) > 0) {
+        int wait_ms = -1;
+        if (timeout > 0) {
+            struct timeval now;
+            gettimeofday(&now, NULL);
+            long passed_ms = (now.tv_sec - start_time.tv_sec) * 1000 +
+                             (now.tv_usec - start_time.tv_usec) / 1000;
+            wait_ms = passed_ms >= timeout * 1000L ? 0 : (int)(timeout * 1000L - passed_ms);
+            if (wait_ms == 0) timeout_occurred = 1;
+        }
 
-    while (active_children > 0) {
         if (timeout_occurred) {
             printf("Timeout occurred! Killing child processes...\n");
             for (int i = 0; i < pnum; i++) {
@@ -153,40 +213,27 @@ int main(int argc, char **argv) {
                     kill(child_pids[i], SIGKILL);
                 }
             }
+            // Убитых тоже собираем, чтобы не оставить зомби
+            report.killed = true;
+            while (SupervisorLive(supervisor) > 0)
+                if (SupervisorWait(supervisor, -1) == -1 && errno != EINTR) break;
             break;
         }
 
-        // Non-blocking wait
-        int status;
-        pid_t finished_pid = waitpid(-1, &status, WNOHANG);
-        
-        if (finished_pid > 0) {
-            // A child finished
-            active_children--;
-            completed_children++;
-            
-            // Mark this PID as finished
-            for (int i = 0; i < pnum; i++) {
-                if (child_pids[i] == finished_pid) {
-                    child_pids[i] = 0; // Mark as finished
-                    break;
-                }
-            }
-        } else if (finished_pid == 0) {
-            // No child has finished yet, sleep briefly
-            usleep(10000); // 10ms
-        } else {
-            // Error in waitpid
-            perror("waitpid");
+        if (SupervisorWait(supervisor, wait_ms) == -1 && errno != EINTR) {
+            perror("epoll_wait");
             break;
         }
     }
+    int completed_children = report.completed;
+    SupervisorDestroy(supervisor);
 
     // Cancel alarm if all children finished before timeout
     if (timeout > 0) {
         alarm(0);
     }
 
+    if (mem_report) MemprofPhaseBegin("collect");
     struct MinMax min_max = {INT_MAX, INT_MIN};
 
     // Collect results from completed children
@@ -233,7 +280,7 @@ int main(int argc, char **argv) {
     double elapsed_time = (finish_time.tv_sec - start_time.tv_sec) * 1000.0;
     elapsed_time += (finish_time.tv_usec - start_time.tv_usec) / 1000.0;
 
-    free(array);
+    ArenaReset(arena);
 
     printf("Min: %d\n", min_max.min);
     printf("Max: %d\n", min_max.max);
@@ -243,6 +290,10 @@ int main(int argc, char **argv) {
     if (timeout_occurred) {
         printf("Program terminated due to timeout\n");
     }
+    if (mem_report) {
+        MemprofPhaseReport(stdout);
+        AllocStatsPrint(stdout);
+    }
     
     return 0;
 }
@@ -1,8 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "find_min_max.h"
-#include "utils.h"
+#include "arena.h"
+#include "compute/compute.h"
 
 int main(int argc, char **argv) {
   if (argc != 3) {
@@ -22,10 +22,15 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  int *array = malloc(array_size * sizeof(int));
+  struct Arena *arena = ArenaThread();
+  int *array = ArenaAlloc(arena, array_size * sizeof(int), 0);
+  if (array == NULL) {
+    printf("Out of memory\n");
+    return 1;
+  }
   GenerateArray(array, array_size, seed);
   struct MinMax min_max = GetMinMax(array, 0, array_size);
-  free(array);
+  ArenaReset(arena);
 
   printf("min: %d\n", min_max.min);
   printf("max: %d\n", min_max.max);
@@ -0,0 +1,187 @@
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "hist.h"
+#include "launcher.h"
+
+#define MAX_RSS 16
+
+/*
+ * Замер цены запуска процесса: каждый способ из launcher.h запускает
+ * программу count раз при разном RSS родителя. spawn - время до возврата
+ * из SpawnProcess (потомок уже сделал exec), run - вместе с waitpid.
+ */
+
+// Балласт: анонимная память, каждая страница которой тронута. Обычные
+// страницы по 4 КБ - чтобы fork копировал столько таблиц, сколько у
+// настоящей кучи, а не зависел от настройки THP
+static char *Ballast(size_t bytes) {
+    if (bytes == 0) return NULL;
+    char *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return NULL;
+    madvise(mem, bytes, MADV_NOHUGEPAGE);
+    memset(mem, 1, bytes);
+    return mem;
+}
+
+static bool RunOnce(enum SpawnMethod method, char *const argv[], struct Hist *spawn,
+                    struct Hist *run) {
+    uint64_t start = MonotonicNs();
+    pid_t pid = SpawnProcess(method, argv);
+    uint64_t spawned = MonotonicNs();
+    if (pid == -1) {
+        fprintf(stderr, "%s: %s: %s\n", SpawnMethodName(method), argv[0], strerror(errno));
+        return false;
+    }
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        perror("waitpid");
+        return false;
+    }
+    uint64_t finished = MonotonicNs();
+    if (spawn != NULL) {
+        HistRecord(spawn, spawned - start);
+        HistRecord(run, finished - start);
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool methods[SPAWN_METHOD_COUNT];
+    int rss_mb[MAX_RSS] = {0, 64, 512};
+    int rss_count = 3;
+    int count = 1000;
+    int warmup = 20;
+    bool csv = false;
+
+    for (int i = 0; i < SPAWN_METHOD_COUNT; i++) methods[i] = true;
+
+    bool ok = true;
+    while (ok) {
+        static struct option options[] = {
+            {"methods", required_argument, 0, 0},
+            {"rss", required_argument, 0, 0},
+            {"count", required_argument, 0, 0},
+            {"warmup", required_argument, 0, 0},
+            {"csv", no_argument, 0, 0},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        // "+" - разбор кончается на первом аргументе запускаемой программы
+        int c = getopt_long(argc, argv, "+", options, &option_index);
+
+        if (c == -1) break;
+
+        switch (c) {
+            case 0:
+                switch (option_index) {
+                    case 0: {
+                        for (int i = 0; i < SPAWN_METHOD_COUNT; i++) methods[i] = false;
+                        char *list = strdup(optarg);
+                        for (char *item = strtok(list, ","); ok && item != NULL;
+                             item = strtok(NULL, ",")) {
+                            enum SpawnMethod method;
+                            ok = SpawnParseMethod(item, &method);
+                            if (ok) methods[method] = true;
+                        }
+                        free(list);
+                        break;
+                    }
+                    case 1: {
+                        rss_count = 0;
+                        char *list = strdup(optarg);
+                        for (char *item = strtok(list, ","); ok && item != NULL;
+                             item = strtok(NULL, ",")) {
+                            ok = rss_count < MAX_RSS && atoi(item) >= 0;
+                            if (ok) rss_mb[rss_count++] = atoi(item);
+                        }
+                        free(list);
+                        ok = ok && rss_count > 0;
+                        break;
+                    }
+                    case 2:
+                        count = atoi(optarg);
+                        ok = count > 0;
+                        break;
+                    case 3:
+                        warmup = atoi(optarg);
+                        ok = warmup >= 0;
+                        break;
+                    case 4:
+                        csv = true;
+                        break;
+                    default:
+                        printf("Index %d is out of options\n", option_index);
+                }
+                break;
+            default:
+                ok = false;
+        }
+    }
+
+    if (!ok) {
+        printf("Usage: %s [--methods fork,vfork,posix_spawn,clone] [--rss 0,64,512 (MB)] "
+               "[--count 1000] [--warmup 20] [--csv] [program args...]\n",
+               argv[0]);
+        return 1;
+    }
+
+    // По умолчанию запускается /bin/true - замеряется только сам запуск
+    char *default_argv[] = {"/bin/true", NULL};
+    char **child_argv = optind < argc ? argv + optind : default_argv;
+
+    if (csv)
+        printf("method,rss_mb,count,spawn_p50_us,spawn_p90_us,spawn_p99_us,spawn_p999_us,"
+               "spawn_max_us,run_p50_us,run_p99_us\n");
+    else
+        printf("%-12s %7s %7s %9s %9s %9s %9s %9s %9s %9s\n", "method", "rss_mb", "count",
+               "p50", "p90", "p99", "p99.9", "max", "run_p50", "run_p99");
+
+    static struct Hist spawn, run;
+    for (int r = 0; r < rss_count; r++) {
+        size_t bytes = (size_t)rss_mb[r] << 20;
+        char *ballast = Ballast(bytes);
+        if (bytes > 0 && ballast == NULL) {
+            fprintf(stderr, "Can not allocate %d MB\n", rss_mb[r]);
+            return 1;
+        }
+
+        for (int m = 0; m < SPAWN_METHOD_COUNT; m++) {
+            if (!methods[m]) continue;
+            HistInit(&spawn);
+            HistInit(&run);
+            for (int i = 0; i < warmup; i++)
+                if (!RunOnce((enum SpawnMethod)m, child_argv, NULL, NULL)) return 1;
+            for (int i = 0; i < count; i++)
+                if (!RunOnce((enum SpawnMethod)m, child_argv, &spawn, &run)) return 1;
+
+            const char *name = SpawnMethodName((enum SpawnMethod)m);
+            double us = 1000.0;
+            if (csv)
+                printf("%s,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", name, rss_mb[r], count,
+                       HistPercentile(&spawn, 50.0) / us, HistPercentile(&spawn, 90.0) / us,
+                       HistPercentile(&spawn, 99.0) / us, HistPercentile(&spawn, 99.9) / us,
+                       spawn.max / us, HistPercentile(&run, 50.0) / us,
+                       HistPercentile(&run, 99.0) / us);
+            else
+                printf("%-12s %7d %7d %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name,
+                       rss_mb[r], count, HistPercentile(&spawn, 50.0) / us,
+                       HistPercentile(&spawn, 90.0) / us, HistPercentile(&spawn, 99.0) / us,
+                       HistPercentile(&spawn, 99.9) / us, spawn.max / us,
+                       HistPercentile(&run, 50.0) / us, HistPercentile(&run, 99.0) / us);
+            fflush(stdout);
+        }
+        if (ballast != NULL) munmap(ballast, bytes);
+    }
+    return 0;
+}
@@ -1,11 +0,0 @@
-#ifndef UTILS_H
-#define UTILS_H
-
-struct MinMax {
-  int min;
-  int max;
-};
-
-void GenerateArray(int *array, unsigned int array_size, unsigned int seed);
-
-#endif
@@ -4,22 +4,16 @@
 #include <string.h>
 #include <sys/time.h>
 #include <getopt.h>
-#include <pthread.h>
 
-#include "../../lab3/src/utils.h"  // для GenerateArray
-#include "sum_lib.h" // наша библиотека для суммирования
-
-
-void *ThreadSum(void *args) {
-  struct SumArgs *sum_args = (struct SumArgs *)args;
-  long long result = Sum(sum_args);
-  return (void *)(long)result;  // Для 64-битных систем
-}
+#include "arena.h"           // рабочий массив
+#include "compute/compute.h" // GenerateArray и ParallelSum из libcompute
+#include "memprof.h"         // пиковая память по фазам
 
 int main(int argc, char **argv) {
   uint32_t threads_num = 0;
   uint32_t array_size = 0;
   uint32_t seed = 0;
+  int mem_report = 0;
 
   // Обработка аргументов командной строки
   while (1) {
@@ -27,6 +21,7 @@ int main(int argc, char **argv) {
         {"threads_num", required_argument, 0, 0},
         {"array_size", required_argument, 0, 0},
         {"seed", required_argument, 0, 0},
+        {"mem", no_argument, 0, 0},
         {0, 0, 0, 0}
     };
 
@@ -47,51 +42,37 @@ int main(int argc, char **argv) {
           case 2:
             seed = atoi(optarg);
             break;
+          case 3:
+            mem_report = 1;
+            break;
         }
         break;
     }
   }
 
   if (threads_num == 0 || array_size == 0) {
-    printf("Usage: %s --threads_num \"num\" --array_size \"num\" --seed \"num\"\n", argv[0]);
+    printf("Usage: %s --threads_num \"num\" --array_size \"num\" --seed \"num\" [--mem]\n", argv[0]);
     return 1;
   }
 
   // Генерация массива (не входит в замер времени)
-  int *array = malloc(sizeof(int) * array_size);
-  GenerateArray(array, array_size, seed);
-
-  // Подготовка аргументов для потоков
-  struct SumArgs args[threads_num];
-  int chunk_size = array_size / threads_num;
-  
-  for (uint32_t i = 0; i < threads_num; i++) {
-    args[i].array = array;
-    args[i].begin = i * chunk_size;
-    args[i].end = (i == threads_num - 1) ? array_size : (i + 1) * chunk_size;
+  if (mem_report) MemprofPhaseBegin("generate");
+  struct Arena *arena = ArenaThread();
+  int *array = ArenaAlloc(arena, sizeof(int) * array_size, 0);
+  if (array == NULL) {
+    printf("Out of memory\n");
+    return 1;
   }
+  GenerateArray(array, array_size, seed);
 
-  pthread_t threads[threads_num];
-  
   // Начало замера времени
+  if (mem_report) MemprofPhaseBegin("sum");
   struct timeval start_time;
   gettimeofday(&start_time, NULL);
 
-  // Создание потоков
-  for (uint32_t i = 0; i < threads_num; i++) {
-    if (pthread_create(&threads[i], NULL, ThreadSum, (void *)&args[i])) {
-      printf("Error: pthread_create failed!\n");
-      return 1;
-    }
-  }
+  // Куски по потокам, их запуск и сложение частичных сумм - в libcompute
+  long long total_sum = ParallelSum(array, array_size, (int)threads_num);
 
-  // Сбор результатов
-  long long total_sum = 0;
-for (uint32_t i = 0; i < threads_num; i++) {
-  long long sum = 0;
-  pthread_join(threads[i], (void **)&sum);
-  total_sum += sum;
-}
   // Конец замера времени
   struct timeval finish_time;
   gettimeofday(&finish_time, NULL);
@@ -99,8 +80,12 @@ for (uint32_t i = 0; i < threads_num; i++) {
   double elapsed_time = (finish_time.tv_sec - start_time.tv_sec) * 1000.0;
   elapsed_time += (finish_time.tv_usec - start_time.tv_usec) / 1000.0;
 
-  free(array);
-  printf("Total: %d\n", total_sum);
+  ArenaReset(arena);
+  printf("Total: %lld\n", total_sum);
   printf("Elapsed time: %fms\n", elapsed_time);
+  if (mem_report) {
+    MemprofPhaseReport(stdout);
+    AllocStatsPrint(stdout);
+  }
   return 0;
 }
@@ -1,29 +1,40 @@
 
 /* Program to display address information about the process */
 /* Adapted from Gray, J., program 1.4 */
+/* With --pid: memory of a running process from /proc/<pid>/smaps */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "memprof.h"
+
 /* Below is a macro definition */
-#define SHW_ADR(ID, I) (printf("ID %s \t is at virtual address: %8X\n", ID, &I))
+#define SHW_ADR(ID, I) (printf("ID %s \t is at virtual address: %p\n", ID, (void *)&I))
 
 extern int etext, edata, end; /* Global variables for process
                                  memory */
 
 char *cptr = "This message is output by the function showit()\n"; /* Static */
 char buffer1[25];
-int showit(); /* Function prototype */
+int showit(char *p); /* Function prototype */
+int main(int argc, char **argv);
 
-main() {
+static int AddressDemo(void) {
   int i = 0; /* Automatic variable */
 
   /* Printing addressing information */
-  printf("\nAddress etext: %8X \n", &etext);
-  printf("Address edata: %8X \n", &edata);
-  printf("Address end  : %8X \n", &end);
+  printf("\nAddress etext: %p \n", (void *)&etext);
+  printf("Address edata: %p \n", (void *)&edata);
+  printf("Address end  : %p \n", (void *)&end);
 
   SHW_ADR("main", main);
   SHW_ADR("showit", showit);
@@ -32,17 +43,15 @@ main() {
   SHW_ADR("i", i);
   strcpy(buffer1, "A demonstration\n");   /* Library function */
   write(1, buffer1, strlen(buffer1) + 1); /* System call */
-  showit(cptr);
-
-} /* end of main function */
+  return showit(cptr);
+}
 
 /* A function follows */
-int showit(p) char *p;
-{
+int showit(char *p) {
   char *buffer2;
   SHW_ADR("buffer2", buffer2);
   if ((buffer2 = (char *)malloc((unsigned)(strlen(p) + 1))) != NULL) {
-    printf("Alocated memory at %X\n", buffer2);
+    printf("Alocated memory at %p\n", (void *)buffer2);
     strcpy(buffer2, p);    /* copy the string */
     printf("%s", buffer2); /* Didplay the string */
     free(buffer2);         /* Release location */
@@ -50,4 +59,266 @@ int showit(p) char *p;
     printf("Allocation error\n");
     exit(1);
   }
+  return 0;
+}
+
+/* Режим профилировщика */
+
+enum SortKey { SORT_RSS, SORT_PSS, SORT_ANON, SORT_SWAP };
+static const char *sort_names[] = {"rss", "pss", "anon", "swap"};
+
+struct Regions {
+  struct MemRegion *items;
+  size_t count;
+  size_t cap;
+};
+
+static void AddRegion(const struct MemRegion *region, void *arg) {
+  struct Regions *regions = arg;
+  if (regions->count == regions->cap) {
+    size_t cap = regions->cap ? regions->cap * 2 : 256;
+    struct MemRegion *items = realloc(regions->items, cap * sizeof(*items));
+    if (items == NULL) return;
+    regions->items = items;
+    regions->cap = cap;
+  }
+  regions->items[regions->count++] = *region;
+}
+
+static bool ReadRegions(pid_t pid, struct Regions *regions) {
+  regions->count = 0;
+  if (MemprofReadRegions(pid, AddRegion, regions) == -1) {
+    perror("smaps");
+    return false;
+  }
+  return true;
+}
+
+static enum SortKey sort_key;
+
+static uint64_t SortValue(const struct MemRegion *region) {
+  switch (sort_key) {
+    case SORT_PSS: return region->usage.pss_kb;
+    case SORT_ANON: return region->usage.anon_kb;
+    case SORT_SWAP: return region->usage.swap_kb;
+    default: return region->usage.rss_kb;
+  }
+}
+
+static int CompareBySortKey(const void *a, const void *b) {
+  uint64_t va = SortValue(a), vb = SortValue(b);
+  return va < vb ? 1 : va > vb ? -1 : 0;
+}
+
+static int CompareByStart(const void *a, const void *b) {
+  const struct MemRegion *ra = a, *rb = b;
+  return ra->start < rb->start ? -1 : ra->start > rb->start ? 1 : 0;
+}
+
+static const char *RegionName(const struct MemRegion *region) {
+  return region->path[0] != '\0' ? region->path : "[anon]";
+}
+
+static void PrintUsage(const char *title, const struct MemUsage *u) {
+  printf("%s: rss %" PRIu64 " KB, pss %" PRIu64 " KB, anon %" PRIu64 " KB, file %" PRIu64
+         " KB, huge %" PRIu64 " KB, swap %" PRIu64 " KB\n",
+         title, u->rss_kb, u->pss_kb, u->anon_kb, u->file_kb, u->huge_kb, u->swap_kb);
+}
+
+static void PrintRegions(struct Regions *regions, int top) {
+  qsort(regions->items, regions->count, sizeof(struct MemRegion), CompareBySortKey);
+  printf("%-33s %-4s %10s %10s %10s %10s %10s %10s  %s\n", "address", "perm", "rss_kb",
+         "pss_kb", "anon_kb", "file_kb", "huge_kb", "swap_kb", "mapping");
+  for (size_t i = 0; i < regions->count && (top == 0 || i < (size_t)top); i++) {
+    const struct MemRegion *r = &regions->items[i];
+    if (SortValue(r) == 0) break;
+    printf("%016" PRIx64 "-%016" PRIx64 " %-4s %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+           " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "  %s\n",
+           r->start, r->end, r->perms, r->usage.rss_kb, r->usage.pss_kb, r->usage.anon_kb,
+           r->usage.file_kb, r->usage.huge_kb, r->usage.swap_kb, RegionName(r));
+  }
+}
+
+struct Growth {
+  const struct MemRegion *region;
+  uint64_t was_kb;
+  uint64_t growth_kb;
+};
+
+static int CompareByGrowth(const void *a, const void *b) {
+  const struct Growth *ga = a, *gb = b;
+  return ga->growth_kb < gb->growth_kb ? 1 : ga->growth_kb > gb->growth_kb ? -1 : 0;
+}
+
+// Области, чей RSS вырос больше всего с первого замера. Область
+// узнается по начальному адресу: куча и стек растут, не сдвигая его
+static void PrintGrowth(struct Regions *first, const struct Regions *last, int top) {
+  struct Growth *growth = calloc(last->count + 1, sizeof(*growth));
+  if (growth == NULL) return;
+  qsort(first->items, first->count, sizeof(struct MemRegion), CompareByStart);
+  for (size_t i = 0; i < last->count; i++) {
+    const struct MemRegion *r = &last->items[i];
+    const struct MemRegion *old =
+        bsearch(r, first->items, first->count, sizeof(struct MemRegion), CompareByStart);
+    growth[i].region = r;
+    growth[i].was_kb = old != NULL ? old->usage.rss_kb : 0;
+    uint64_t was = growth[i].was_kb;
+    growth[i].growth_kb = r->usage.rss_kb > was ? r->usage.rss_kb - was : 0;
+  }
+  qsort(growth, last->count, sizeof(*growth), CompareByGrowth);
+
+  printf("%-33s %10s %10s %10s  %s\n", "grown since first sample", "was_kb", "now_kb",
+         "growth_kb", "mapping");
+  for (size_t i = 0; i < last->count && (top == 0 || i < (size_t)top); i++) {
+    const struct MemRegion *r = growth[i].region;
+    if (growth[i].growth_kb == 0) break;
+    printf("%016" PRIx64 "-%016" PRIx64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "  %s\n",
+           r->start, r->end, growth[i].was_kb, r->usage.rss_kb, growth[i].growth_kb,
+           RegionName(r));
+  }
+  free(growth);
+}
+
+static volatile sig_atomic_t stop_sampling = 0;
+
+static void StopHandler(int sig) {
+  (void)sig;
+  stop_sampling = 1;
+}
+
+static double NowSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Замер раз в interval_ms: итог smaps_rollup и прирост RSS; с --regions в
+// конце - области, которые выросли больше всего
+static int Sample(pid_t pid, int interval_ms, int count, bool regions, int top) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = StopHandler;
+  sigaction(SIGINT, &sa, NULL);
+
+  struct Regions first = {NULL, 0, 0}, last = {NULL, 0, 0};
+  if (regions && !ReadRegions(pid, &first)) return 1;
+
+  printf("%8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "time_s", "rss_kb", "pss_kb",
+         "anon_kb", "file_kb", "huge_kb", "swap_kb", "d_rss_kb", "kb_per_s");
+  double start = NowSeconds(), prev_time = start;
+  uint64_t prev_rss = 0;
+  for (int i = 0; (count == 0 || i < count) && !stop_sampling; i++) {
+    if (i > 0) {
+      struct timespec delay = {interval_ms / 1000, (interval_ms % 1000) * 1000000L};
+      nanosleep(&delay, NULL);
+      if (stop_sampling) break;
+    }
+    struct MemUsage u;
+    if (MemprofReadRollup(pid, &u) == -1) {
+      perror("smaps_rollup");
+      break;
+    }
+    double now = NowSeconds();
+    int64_t delta = i > 0 ? (int64_t)u.rss_kb - (int64_t)prev_rss : 0;
+    double rate = i > 0 && now > prev_time ? delta / (now - prev_time) : 0.0;
+    printf("%8.2f %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+           " %10" PRIu64 " %+10" PRId64 " %+10.0f\n",
+           now - start, u.rss_kb, u.pss_kb, u.anon_kb, u.file_kb, u.huge_kb, u.swap_kb, delta,
+           rate);
+    fflush(stdout);
+    prev_rss = u.rss_kb;
+    prev_time = now;
+  }
+
+  if (regions && ReadRegions(pid, &last)) PrintGrowth(&first, &last, top);
+  free(first.items);
+  free(last.items);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  pid_t pid = -1;
+  bool regions = false;
+  int top = 20;
+  int sample_ms = 0;
+  int count = 0;
+
+  bool ok = true;
+  while (ok) {
+    static struct option options[] = {{"pid", required_argument, 0, 0},
+                                      {"regions", no_argument, 0, 0},
+                                      {"top", required_argument, 0, 0},
+                                      {"sort", required_argument, 0, 0},
+                                      {"sample_ms", required_argument, 0, 0},
+                                      {"count", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            pid = strcmp(optarg, "self") == 0 ? 0 : atoi(optarg);
+            ok = pid >= 0;
+            break;
+          case 1:
+            regions = true;
+            break;
+          case 2:
+            top = atoi(optarg);
+            ok = top >= 0;
+            break;
+          case 3:
+            ok = false;
+            for (int i = 0; i < 4; i++) {
+              if (strcmp(optarg, sort_names[i]) == 0) {
+                sort_key = (enum SortKey)i;
+                ok = true;
+              }
+            }
+            break;
+          case 4:
+            sample_ms = atoi(optarg);
+            ok = sample_ms > 0;
+            break;
+          case 5:
+            count = atoi(optarg);
+            ok = count >= 0;
+            break;
+        }
+        break;
+      default:
+        ok = false;
+    }
+  }
+
+  if (!ok || optind < argc) {
+    printf("Usage: %s [--pid \"num\"|self [--regions] [--top 20] [--sort rss|pss|anon|swap] "
+           "[--sample_ms \"num\" [--count \"num\"]]]\n",
+           argv[0]);
+    return 1;
+  }
+
+  // Без --pid - прежняя демонстрация адресов
+  if (pid == -1) return AddressDemo();
+
+  if (sample_ms > 0) return Sample(pid, sample_ms, count, regions, top);
+
+  struct MemUsage usage;
+  if (MemprofReadRollup(pid, &usage) == -1) {
+    perror("smaps_rollup");
+    return 1;
+  }
+  PrintUsage(pid == 0 ? "self" : "total", &usage);
+  if (regions) {
+    struct Regions list = {NULL, 0, 0};
+    if (!ReadRegions(pid, &list)) return 1;
+    PrintRegions(&list, top);
+    free(list.items);
+  }
+  return 0;
 }
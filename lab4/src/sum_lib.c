@@ -1,9 +0,0 @@
-#include "sum_lib.h"
-
-long long Sum(const struct SumArgs *args) {
-  int sum = 0;
-  for (int i = args->begin; i < args->end; i++) {
-    sum += args->array[i];
-  }
-  return sum;
-}
@@ -1,18 +1,23 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <time.h>
 
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: %s <number_of_zombies>\n", argv[0]);
-        return 1;
-    }
+#include "hist.h"
+#include "supervisor.h"
 
-    int num_zombies = atoi(argv[1]);
-    
+// Исходный режим: дети становятся зомби и собираются только по Enter
+static int ZombieDemo(int num_zombies) {
     printf("Parent PID: %d\n", getpid());
     printf("Creating %d zombie processes...\n", num_zombies);
     printf("Run 'ps aux | grep defunct' in another terminal to see zombies\n");
@@ -21,7 +26,7 @@ int main(int argc, char *argv[]) {
     // Создаем зомби-процессы
     for (int i = 0; i < num_zombies; i++) {
         pid_t pid = fork();
-        
+
         if (pid == 0) {
             // Дочерний процесс
             printf("Child %d (PID: %d) created and exiting immediately\n", i, getpid());
@@ -48,7 +53,204 @@ int main(int argc, char *argv[]) {
     while (wait(NULL) > 0) {
         // Ждем завершения всех дочерних процессов
     }
-    
+
     printf("All zombies cleaned up!\n");
     return 0;
 }
+
+/*
+ * Режимы замера: num детей запускаются, ждут, пока родитель не запустит
+ * всех, и завершаются через случайное время до lifetime_ms. Перед выходом
+ * ребенок пишет время в общую память, родитель при сборе считает
+ * задержку сбора. --supervise собирает через supervisor.h, --wait_all -
+ * блокирующим wait(), который в ядре перебирает всех живых детей.
+ */
+struct ReapStats {
+    uint64_t *exit_ns;    // время выхода, по номеру ребенка
+    int *index_of;        // номер ребенка по pid
+    struct Hist latency;
+    double user_ms;
+    double sys_ms;
+    long max_rss_kb;
+    long voluntary_switches;
+    long involuntary_switches;
+    int reaped;
+};
+
+static void RecordReap(struct ReapStats *stats, pid_t pid) {
+    uint64_t now = MonotonicNs();
+    uint64_t exited = stats->exit_ns[stats->index_of[pid]];
+    HistRecord(&stats->latency, now > exited ? now - exited : 0);
+    stats->reaped++;
+}
+
+static void OnChildExit(const struct ChildExit *info, void *arg) {
+    struct ReapStats *stats = arg;
+    RecordReap(stats, info->pid);
+    stats->user_ms += info->user_ms;
+    stats->sys_ms += info->sys_ms;
+    if (info->max_rss_kb > stats->max_rss_kb) stats->max_rss_kb = info->max_rss_kb;
+    stats->voluntary_switches += info->voluntary_switches;
+    stats->involuntary_switches += info->involuntary_switches;
+}
+
+static int PidMax(void) {
+    int pid_max = 4194304;
+    FILE *f = fopen("/proc/sys/kernel/pid_max", "r");
+    if (f != NULL) {
+        if (fscanf(f, "%d", &pid_max) != 1) pid_max = 4194304;
+        fclose(f);
+    }
+    return pid_max;
+}
+
+static double CpuMs(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec * 1000.0 + ru.ru_utime.tv_usec / 1000.0 +
+           ru.ru_stime.tv_sec * 1000.0 + ru.ru_stime.tv_usec / 1000.0;
+}
+
+static int ReapBenchmark(int num, int lifetime_ms, bool supervise) {
+    struct ReapStats stats;
+    memset(&stats, 0, sizeof(stats));
+    HistInit(&stats.latency);
+    stats.exit_ns = mmap(NULL, sizeof(uint64_t) * num, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    stats.index_of = calloc(PidMax() + 1, sizeof(int));
+    if (stats.exit_ns == MAP_FAILED || stats.index_of == NULL) {
+        perror("alloc");
+        return 1;
+    }
+
+    struct Supervisor *supervisor = NULL;
+    if (supervise) {
+        supervisor = SupervisorCreate(OnChildExit, &stats);
+        if (supervisor == NULL) {
+            perror("supervisor");
+            return 1;
+        }
+    }
+
+    // Дети стоят на чтении из канала, пока родитель не закроет его
+    int start[2];
+    if (pipe(start) == -1) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t *pids = malloc(sizeof(pid_t) * num);
+    for (int i = 0; i < num; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(start[1]);
+            char c;
+            while (read(start[0], &c, 1) == -1 && errno == EINTR) {
+            }
+            srand(getpid());
+            if (lifetime_ms > 0) {
+                long ns = (long)(rand() % (lifetime_ms * 1000)) * 1000;
+                struct timespec delay = {ns / 1000000000L, ns % 1000000000L};
+                nanosleep(&delay, NULL);
+            }
+            stats.exit_ns[i] = MonotonicNs();
+            _exit(0);
+        } else if (pid < 0) {
+            perror("fork failed");
+            return 1;
+        }
+        pids[i] = pid;
+        stats.index_of[pid] = i;
+    }
+    // pidfd заводятся после fork всех детей: иначе каждый fork копировал бы
+    // таблицу из уже открытых pidfd
+    for (int i = 0; supervise && i < num; i++) {
+        if (SupervisorAdd(supervisor, pids[i], NULL) == -1) {
+            perror("pidfd");
+            return 1;
+        }
+    }
+    printf("%d children started, %s\n", num, supervise ? "reaping via pidfd + epoll" :
+                                                         "reaping via wait()");
+
+    double cpu_start = CpuMs();
+    uint64_t start_ns = MonotonicNs();
+    close(start[0]);
+    close(start[1]);
+
+    if (supervise) {
+        while (SupervisorLive(supervisor) > 0)
+            if (SupervisorWait(supervisor, -1) == -1 && errno != EINTR) {
+                perror("epoll_wait");
+                return 1;
+            }
+    } else {
+        pid_t pid;
+        while ((pid = wait(NULL)) > 0 || (pid == -1 && errno == EINTR))
+            if (pid > 0) RecordReap(&stats, pid);
+    }
+    double elapsed_ms = (MonotonicNs() - start_ns) / 1e6;
+    double cpu_ms = CpuMs() - cpu_start;
+
+    printf("reaped %d in %.1f ms, reaper cpu %.1f ms (%.2f us per child)\n", stats.reaped,
+           elapsed_ms, cpu_ms, stats.reaped > 0 ? cpu_ms * 1000.0 / stats.reaped : 0.0);
+    HistPrint(stdout, "reap latency", &stats.latency, 1000.0, "us");
+    if (supervise) {
+        printf("children total: user %.1f ms, sys %.1f ms, max rss %ld KB, csw %ld/%ld\n",
+               stats.user_ms, stats.sys_ms, stats.max_rss_kb, stats.voluntary_switches,
+               stats.involuntary_switches);
+        SupervisorDestroy(supervisor);
+    }
+    free(pids);
+    free(stats.index_of);
+    munmap(stats.exit_ns, sizeof(uint64_t) * num);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    bool supervise = false;
+    bool wait_all = false;
+    int lifetime_ms = 1000;
+
+    bool ok = true;
+    while (ok) {
+        static struct option options[] = {
+            {"supervise", no_argument, 0, 0},
+            {"wait_all", no_argument, 0, 0},
+            {"lifetime_ms", required_argument, 0, 0},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "", options, &option_index);
+
+        if (c == -1) break;
+
+        switch (c) {
+            case 0:
+                switch (option_index) {
+                    case 0:
+                        supervise = true;
+                        break;
+                    case 1:
+                        wait_all = true;
+                        break;
+                    case 2:
+                        lifetime_ms = atoi(optarg);
+                        break;
+                }
+                break;
+            default:
+                ok = false;
+        }
+    }
+
+    if (!ok || optind != argc - 1 || (supervise && wait_all) || lifetime_ms < 0) {
+        printf("Usage: %s [--supervise | --wait_all] [--lifetime_ms 1000] <number_of_zombies>\n",
+               argv[0]);
+        return 1;
+    }
+
+    int num = atoi(argv[optind]);
+    if (supervise || wait_all) return ReapBenchmark(num, lifetime_ms, supervise);
+    return ZombieDemo(num);
+}
@@ -0,0 +1,355 @@
+/*
+ * contention.c
+ *
+ * Развитие mutex.c: N потоков увеличивают общий счетчик, а критическая
+ * секция, как и там, - чтение, холостой цикл и запись обратно. Один и тот
+ * же сценарий прогоняется с разными примитивами синхронизации, для
+ * каждого выводятся операции в секунду и хвосты задержки одной операции
+ * (захват + критическая секция + освобождение).
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hist.h"
+
+#define CACHE_LINE 64
+// После стольких холостых итераций спинлок уступает процессор: иначе при
+// потоках больше, чем ядер, ожидающие крутятся весь квант вытесненного
+// владельца
+#define SPINS_BEFORE_YIELD 1024
+
+enum Primitive {
+  PRIM_MUTEX,
+  PRIM_ADAPTIVE,
+  PRIM_TICKET,
+  PRIM_MCS,
+  PRIM_ATOMIC,
+  PRIM_SHARDED,
+  PRIM_COUNT
+};
+
+static const char *prim_names[PRIM_COUNT] = {"mutex", "adaptive", "ticket",
+                                             "mcs",   "atomic",   "sharded"};
+
+struct Config {
+  int threads;
+  long ops;
+  long cs_len;
+  long outside_len;
+  bool enabled[PRIM_COUNT];
+};
+
+// Билетный спинлок: потоки проходят строго в порядке взятия билетов
+struct TicketLock {
+  unsigned next __attribute__((aligned(CACHE_LINE)));
+  unsigned serving __attribute__((aligned(CACHE_LINE)));
+};
+
+// MCS: каждый поток крутится на собственном узле, а не на общей линии
+struct McsNode {
+  struct McsNode *next;
+  int locked;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct McsLock {
+  struct McsNode *tail;
+};
+
+struct Shard {
+  uint64_t value;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct Bench {
+  const struct Config *config;
+  enum Primitive prim;
+  pthread_barrier_t start;
+  pthread_mutex_t mutex;
+  struct TicketLock ticket;
+  struct McsLock mcs;
+  uint64_t common __attribute__((aligned(CACHE_LINE)));
+  struct Shard *shards;
+};
+
+struct Worker {
+  struct Bench *bench;
+  int id;
+  struct Hist hist;
+  uint64_t start_ns;
+  uint64_t end_ns;
+};
+
+static inline void CpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ volatile("yield" ::: "memory");
+#endif
+}
+
+static inline void SpinWait(int *spins) {
+  if (++*spins < SPINS_BEFORE_YIELD) {
+    CpuRelax();
+  } else {
+    *spins = 0;
+    sched_yield();
+  }
+}
+
+static inline void Spin(long iterations) {
+  for (long k = 0; k < iterations; k++)
+    __asm__ volatile("" ::: "memory"); /* long cycle */
+}
+
+static void TicketLock(struct TicketLock *lock) {
+  int spins = 0;
+  unsigned ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+  while (__atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE) != ticket)
+    SpinWait(&spins);
+}
+
+static void TicketUnlock(struct TicketLock *lock) {
+  __atomic_store_n(&lock->serving, lock->serving + 1, __ATOMIC_RELEASE);
+}
+
+static void McsLock(struct McsLock *lock, struct McsNode *node) {
+  node->next = NULL;
+  node->locked = 1;
+  struct McsNode *prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+  if (prev == NULL)
+    return;
+  __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+  int spins = 0;
+  while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+    SpinWait(&spins);
+}
+
+static void McsUnlock(struct McsLock *lock, struct McsNode *node) {
+  struct McsNode *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+  if (next == NULL) {
+    struct McsNode *expected = node;
+    if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      return;
+    // Преемник уже встал в очередь, но еще не прописал себя
+    int spins = 0;
+    while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL)
+      SpinWait(&spins);
+  }
+  __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+// Критическая секция из mutex.c: чтение, долгий цикл, запись
+static inline void CriticalSection(uint64_t *counter, long cs_len) {
+  uint64_t work = *counter;
+  work++; /* increment, but not write */
+  Spin(cs_len);
+  *counter = work; /* write back */
+}
+
+static void *WorkerMain(void *arg) {
+  struct Worker *w = arg;
+  struct Bench *b = w->bench;
+  const struct Config *c = b->config;
+  struct McsNode node;
+
+  pthread_barrier_wait(&b->start);
+  w->start_ns = MonotonicNs();
+
+  for (long i = 0; i < c->ops; i++) {
+    Spin(c->outside_len);
+    uint64_t begin = MonotonicNs();
+    switch (b->prim) {
+      case PRIM_MUTEX:
+      case PRIM_ADAPTIVE:
+        pthread_mutex_lock(&b->mutex);
+        CriticalSection(&b->common, c->cs_len);
+        pthread_mutex_unlock(&b->mutex);
+        break;
+      case PRIM_TICKET:
+        TicketLock(&b->ticket);
+        CriticalSection(&b->common, c->cs_len);
+        TicketUnlock(&b->ticket);
+        break;
+      case PRIM_MCS:
+        McsLock(&b->mcs, &node);
+        CriticalSection(&b->common, c->cs_len);
+        McsUnlock(&b->mcs, &node);
+        break;
+      case PRIM_ATOMIC:
+        // Работа секции не требует исключения - остается только инкремент
+        Spin(c->cs_len);
+        __atomic_fetch_add(&b->common, 1, __ATOMIC_RELAXED);
+        break;
+      case PRIM_SHARDED:
+        Spin(c->cs_len);
+        b->shards[w->id].value++;
+        break;
+      default:
+        break;
+    }
+    HistRecord(&w->hist, MonotonicNs() - begin);
+  }
+
+  w->end_ns = MonotonicNs();
+  return NULL;
+}
+
+static int RunPrimitive(const struct Config *c, enum Primitive prim) {
+  struct Bench bench;
+  memset(&bench, 0, sizeof(bench));
+  bench.config = c;
+  bench.prim = prim;
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  if (prim == PRIM_ADAPTIVE)
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+  pthread_mutex_init(&bench.mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+  pthread_barrier_init(&bench.start, NULL, c->threads);
+
+  struct Worker *workers = calloc(c->threads, sizeof(struct Worker));
+  pthread_t *threads = calloc(c->threads, sizeof(pthread_t));
+  if (posix_memalign((void **)&bench.shards, CACHE_LINE,
+                     c->threads * sizeof(struct Shard)) != 0 ||
+      workers == NULL || threads == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  memset(bench.shards, 0, c->threads * sizeof(struct Shard));
+
+  for (int i = 0; i < c->threads; i++) {
+    workers[i].bench = &bench;
+    workers[i].id = i;
+    HistInit(&workers[i].hist);
+    if (pthread_create(&threads[i], NULL, WorkerMain, &workers[i]) != 0) {
+      perror("pthread_create");
+      exit(1);
+    }
+  }
+
+  struct Hist total;
+  HistInit(&total);
+  uint64_t start_ns = UINT64_MAX, end_ns = 0;
+  for (int i = 0; i < c->threads; i++) {
+    if (pthread_join(threads[i], NULL) != 0) {
+      perror("pthread_join");
+      exit(1);
+    }
+    HistMerge(&total, &workers[i].hist);
+    if (workers[i].start_ns < start_ns) start_ns = workers[i].start_ns;
+    if (workers[i].end_ns > end_ns) end_ns = workers[i].end_ns;
+  }
+
+  // Шарды складываются один раз, после завершения всех потоков
+  uint64_t counter = bench.common;
+  if (prim == PRIM_SHARDED) {
+    for (int i = 0; i < c->threads; i++)
+      counter += bench.shards[i].value;
+  }
+  uint64_t expected = (uint64_t)c->threads * (uint64_t)c->ops;
+  double seconds = (end_ns - start_ns) / 1e9;
+
+  printf("%-9s %14.0f %9.0f %9.0f %9.0f %9.0f %11.0f  %s\n", prim_names[prim],
+         expected / seconds, HistMean(&total), (double)HistPercentile(&total, 50),
+         (double)HistPercentile(&total, 99), (double)HistPercentile(&total, 99.9),
+         (double)total.max, counter == expected ? "ok" : "LOST UPDATES");
+
+  free(bench.shards);
+  free(workers);
+  free(threads);
+  pthread_barrier_destroy(&bench.start);
+  pthread_mutex_destroy(&bench.mutex);
+  return counter == expected ? 0 : 2;
+}
+
+// Список примитивов через запятую
+static bool ParsePrimitives(char *list, bool *enabled) {
+  memset(enabled, 0, sizeof(bool) * PRIM_COUNT);
+  for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+    int p;
+    for (p = 0; p < PRIM_COUNT; p++) {
+      if (strcmp(name, prim_names[p]) == 0) break;
+    }
+    if (p == PRIM_COUNT) {
+      fprintf(stderr, "Unknown primitive %s\n", name);
+      return false;
+    }
+    enabled[p] = true;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  struct Config config = {.threads = 4, .ops = 100000, .cs_len = 100, .outside_len = 0};
+  for (int p = 0; p < PRIM_COUNT; p++) config.enabled[p] = true;
+
+  while (true) {
+    static struct option options[] = {{"threads", required_argument, 0, 0},
+                                      {"ops", required_argument, 0, 0},
+                                      {"cs", required_argument, 0, 0},
+                                      {"outside", required_argument, 0, 0},
+                                      {"prims", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            config.threads = atoi(optarg);
+            break;
+          case 1:
+            config.ops = atol(optarg);
+            break;
+          case 2:
+            config.cs_len = atol(optarg);
+            break;
+          case 3:
+            config.outside_len = atol(optarg);
+            break;
+          case 4:
+            if (!ParsePrimitives(optarg, config.enabled)) return 1;
+            break;
+          default:
+            printf("Index %d is out of options\n", option_index);
+        }
+        break;
+      default:
+        fprintf(stderr, "getopt returned character code 0%o?\n", c);
+    }
+  }
+
+  if (config.threads <= 0 || config.ops <= 0 || config.cs_len < 0 ||
+      config.outside_len < 0) {
+    fprintf(stderr,
+            "Using: %s --threads 4 --ops 100000 --cs 100 [--outside 0] "
+            "[--prims mutex,adaptive,ticket,mcs,atomic,sharded]\n",
+            argv[0]);
+    return 1;
+  }
+
+  printf("Threads: %d, ops per thread: %ld, critical section: %ld, outside: %ld\n",
+         config.threads, config.ops, config.cs_len, config.outside_len);
+  printf("%-9s %14s %9s %9s %9s %9s %11s  %s\n", "primitive", "ops/s", "mean ns",
+         "p50 ns", "p99 ns", "p99.9 ns", "max ns", "counter");
+
+  int status = 0;
+  for (int p = 0; p < PRIM_COUNT; p++) {
+    if (config.enabled[p] && RunPrimitive(&config, (enum Primitive)p) != 0)
+      status = 2;
+  }
+  return status;
+}
@@ -2,10 +2,14 @@
 #include <pthread.h>
 #include <unistd.h>
 
+#include "lockdep.h"
+#include "lockprof.h"
+
 pthread_mutex_t mutex1 = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mutex2 = PTHREAD_MUTEX_INITIALIZER;
 
 void* thread1_function(void* arg) {
+    (void)arg;
     printf("Thread 1: Trying to lock mutex1...\n");
     pthread_mutex_lock(&mutex1);
     printf("Thread 1: Locked mutex1\n");
@@ -29,6 +33,7 @@ void* thread1_function(void* arg) {
 }
 
 void* thread2_function(void* arg) {
+    (void)arg;
     printf("Thread 2: Trying to lock mutex2...\n");
     pthread_mutex_lock(&mutex2);
     printf("Thread 2: Locked mutex2\n");
@@ -1,28 +1,100 @@
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <pthread.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <semaphore.h>
 
+#include "arena.h"
+#include "compute/compute.h"
+#include "lockdep.h"
+#include "lockprof.h"
+
+#define CACHE_LINE 64
+#define TRACE_SIZE 192
+
+// Как объединяются частичные произведения потоков
+typedef enum {
+    COMBINE_SEM,   // общий result под бинарным семафором (исходный вариант)
+    COMBINE_TREE,  // свои слоты + турнирное дерево по мере завершения потоков
+    COMBINE_CAS    // общий result, обновляемый compare-and-swap
+} combine_t;
+
+// Куда пишется трассировка потоков
+typedef enum {
+    TRACE_OFF,
+    TRACE_BUFFERED,  // в буфер своего слота, печать после join
+    TRACE_STDIO      // сразу printf из потока (исходный вариант)
+} trace_t;
+
 // Глобальные переменные
-int k = 0;
+uint64_t k = 0;
 int pnum = 1;
-int mod = 1;
-unsigned long long result = 1;
+uint64_t mod = 1;
+uint64_t result = 1;
+int bad_args = 0;
+combine_t combine = COMBINE_TREE;
+trace_t trace = TRACE_OFF;
+FILE *trace_out = NULL;
+int bench = 0;
 
 // Семафоры
 sem_t semaphore;
 
+// Слот потока занимает целую кэш-линию, чтобы соседи не делили ее
+typedef struct {
+    uint64_t value;
+    int trace_len;
+    char trace[TRACE_SIZE];
+} __attribute__((aligned(CACHE_LINE))) slot_t;
+
+slot_t *slots = NULL;
+
+// Счетчики прибытия в узлы дерева: узел уровня level с левым листом left
+int *arrivals = NULL;
+
+static const char *combine_names[] = {"sem", "tree", "cas"};
+
+// Разбор беззнакового 64-битного числа целиком, без молчаливого
+// усечения и без отрицательных значений
+static int parse_u64(const char *str, uint64_t *value) {
+    char *end;
+    while (*str == ' ') str++;
+    if (*str < '0' || *str > '9') return 0;
+    errno = 0;
+    unsigned long long parsed = strtoull(str, &end, 10);
+    if (errno != 0 || *end != '\0') return 0;
+    *value = parsed;
+    return 1;
+}
+
 // Функция для обработки аргументов командной строки
 void parse_args(int argc, char *argv[]) {
+    uint64_t value;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
-            k = atoi(argv[++i]);
+            if (!parse_u64(argv[++i], &k)) bad_args = 1;
         } else if (strncmp(argv[i], "--pnum=", 7) == 0) {
-            pnum = atoi(argv[i] + 7);
+            if (!parse_u64(argv[i] + 7, &value) || value > 65536) bad_args = 1;
+            else pnum = (int)value;
         } else if (strncmp(argv[i], "--mod=", 6) == 0) {
-            mod = atoi(argv[i] + 6);
+            if (!parse_u64(argv[i] + 6, &mod)) bad_args = 1;
+        } else if (strncmp(argv[i], "--combine=", 10) == 0) {
+            const char *name = argv[i] + 10;
+            combine = (combine_t)-1;
+            for (int c = COMBINE_SEM; c <= COMBINE_CAS; c++) {
+                if (strcmp(name, combine_names[c]) == 0) combine = (combine_t)c;
+            }
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            trace = TRACE_BUFFERED;
+        } else if (strcmp(argv[i], "--trace=stdio") == 0) {
+            trace = TRACE_STDIO;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = 1;
         }
     }
 }
@@ -30,82 +102,131 @@ void parse_args(int argc, char *argv[]) {
 // Структура для передачи данных в поток
 typedef struct {
     int thread_id;
-    int start;
-    int end;
+    uint64_t start;
+    uint64_t end;
 } thread_data_t;
 
+// Трассировка потока: либо в собственный буфер без блокировок,
+// либо напрямую в stdio (все потоки встают в очередь на его блокировку)
+static void trace_thread(slot_t *slot, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    if (trace == TRACE_STDIO) {
+        vfprintf(trace_out, fmt, args);
+    } else if (trace == TRACE_BUFFERED && slot->trace_len < TRACE_SIZE) {
+        int n = vsnprintf(slot->trace + slot->trace_len,
+                          TRACE_SIZE - slot->trace_len, fmt, args);
+        if (n > 0) slot->trace_len += n;
+        if (slot->trace_len > TRACE_SIZE - 1) slot->trace_len = TRACE_SIZE - 1;
+    }
+    va_end(args);
+}
+
+// Подъем по турнирному дереву: в каждом узле первый прибывший поток
+// просто выходит, второй перемножает оба подпроизведения и идет выше.
+// Ожидания нет, и к моменту join в slots[0] уже лежит весь результат
+static void tree_combine(int id) {
+    for (int level = 0; (1 << level) < pnum; level++) {
+        int left = id & ~((2 << level) - 1);
+        int right = left + (1 << level);
+        if (right < pnum) {
+            int *counter = &arrivals[level * pnum + left];
+            if (__atomic_fetch_add(counter, 1, __ATOMIC_ACQ_REL) == 0)
+                return;
+            slots[left].value = MultModulo(slots[left].value, slots[right].value, mod);
+        }
+        id = left;
+    }
+}
+
+static void cas_combine(uint64_t partial) {
+    uint64_t old = __atomic_load_n(&result, __ATOMIC_RELAXED);
+    uint64_t desired;
+    do {
+        desired = MultModulo(old, partial, mod);
+    } while (!__atomic_compare_exchange_n(&result, &old, desired, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
 // Функция, выполняемая в каждом потоке
 void* calculate_partial_factorial(void* arg) {
     thread_data_t* data = (thread_data_t*)arg;
-    unsigned long long partial_result = 1;
-    
-    printf("Thread %d: calculating from %d to %d\n", 
-           data->thread_id, data->start, data->end);
-    
+    slot_t *slot = &slots[data->thread_id];
+    trace_thread(slot, "Thread %d: calculating from %" PRIu64 " to %" PRIu64 "\n",
+                 data->thread_id, data->start, data->end);
+
     // Вычисление частичного факториала
-    for (int i = data->start; i <= data->end; i++) {
-        partial_result = (partial_result * i) % mod;
+    uint64_t partial_result = ProductModulo(data->start, data->end, mod);
+
+    trace_thread(slot, "Thread %d: partial result = %" PRIu64 "\n",
+                 data->thread_id, partial_result);
+
+    switch (combine) {
+        case COMBINE_SEM:
+            // Захватываем семафор для обновления общего результата
+            sem_wait(&semaphore);
+            result = MultModulo(result, partial_result, mod);
+            sem_post(&semaphore);
+            break;
+        case COMBINE_CAS:
+            cas_combine(partial_result);
+            break;
+        case COMBINE_TREE:
+            slot->value = partial_result;
+            tree_combine(data->thread_id);
+            break;
     }
-    
-    printf("Thread %d: partial result = %llu\n", 
-           data->thread_id, partial_result);
-    
-    // Захватываем семафор для обновления общего результата
-    sem_wait(&semaphore);
-    result = (result * partial_result) % mod;
-    sem_post(&semaphore);
-    
+
     return NULL;
 }
 
-int main(int argc, char *argv[]) {
-    // Парсинг аргументов командной строки
-    parse_args(argc, argv);
-    
-    // Проверка корректности входных данных
-    if (k <= 0 || pnum <= 0 || mod <= 1) {
-        printf("Usage: %s -k <number> --pnum=<threads> --mod=<modulus>\n", argv[0]);
-        printf("k must be > 0, pnum must be > 0, mod must be > 1\n");
-        return 1;
-    }
-    
-    printf("Calculating %d! mod %d using %d threads\n", k, mod, pnum);
-    
-    // Инициализация семафора (1 - бинарный семафор)
-    if (sem_init(&semaphore, 0, 1) != 0) {
-        perror("sem_init");
-        return 1;
-    }
-    
-    // Создание потоков
+// Один полный расчет k! mod mod на pnum потоках
+static int run_factorial(void) {
     pthread_t threads[pnum];
     thread_data_t thread_data[pnum];
-    
+    int levels = 0;
+    while ((1 << levels) < pnum) levels++;
+
+    // Слоты и счетчики живут до конца расчета в арене потока: повторные
+    // расчеты --bench берут ту же память без malloc
+    struct Arena *arena = ArenaThread();
+    struct ArenaMark mark = ArenaSave(arena);
+    size_t arrivals_size = sizeof(int) * (levels > 0 ? levels * pnum : 1);
+    arrivals = ArenaAlloc(arena, arrivals_size, 0);
+    slots = ArenaAlloc(arena, sizeof(slot_t) * pnum, CACHE_LINE);
+    if (slots == NULL || arrivals == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    memset(arrivals, 0, arrivals_size);
+    memset(slots, 0, sizeof(slot_t) * pnum);
+    result = 1 % mod;
+
     // Распределение работы между потоками
-    int numbers_per_thread = k / pnum;
-    int remainder = k % pnum;
-    int current_start = 1;
-    
+    uint64_t numbers_per_thread = k / pnum;
+    uint64_t remainder = k % pnum;
+    uint64_t current_start = 1;
+
     for (int i = 0; i < pnum; i++) {
         thread_data[i].thread_id = i;
         thread_data[i].start = current_start;
-        
+
         // Распределяем остаток по первым потокам
-        int numbers_for_this_thread = numbers_per_thread;
-        if (i < remainder) {
+        uint64_t numbers_for_this_thread = numbers_per_thread;
+        if ((uint64_t)i < remainder) {
             numbers_for_this_thread++;
         }
-        
+
         thread_data[i].end = current_start + numbers_for_this_thread - 1;
         current_start = thread_data[i].end + 1;
-        
+
         // Создаем поток
         if (pthread_create(&threads[i], NULL, calculate_partial_factorial, &thread_data[i]) != 0) {
             perror("pthread_create");
             return 1;
         }
     }
-    
+
     // Ожидание завершения всех потоков
     for (int i = 0; i < pnum; i++) {
         if (pthread_join(threads[i], NULL) != 0) {
@@ -113,12 +234,125 @@ int main(int argc, char *argv[]) {
             return 1;
         }
     }
-    
+
+    if (combine == COMBINE_TREE) result = slots[0].value;
+
+    // Буферизованная трассировка печатается одним проходом, по порядку потоков
+    if (trace == TRACE_BUFFERED) {
+        for (int i = 0; i < pnum; i++) {
+            fwrite(slots[i].trace, 1, slots[i].trace_len, trace_out);
+        }
+    }
+
+    ArenaRewind(arena, mark);
+    return 0;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Сравнение способов объединения при pnum = 1, 2, 4, ... до заданного.
+// Трассировка уходит в /dev/null: блокировку stdio это не отменяет
+static int run_bench(void) {
+    struct {
+        const char *name;
+        combine_t combine;
+        trace_t trace;
+    } variants[] = {
+        {"sem+stdio", COMBINE_SEM, TRACE_STDIO},
+        {"sem", COMBINE_SEM, TRACE_OFF},
+        {"cas", COMBINE_CAS, TRACE_OFF},
+        {"tree", COMBINE_TREE, TRACE_OFF},
+        {"tree+trace", COMBINE_TREE, TRACE_BUFFERED},
+    };
+    const int nvariants = sizeof(variants) / sizeof(variants[0]);
+    const int repeats = 5;
+    int max_pnum = pnum;
+
+    trace_out = fopen("/dev/null", "w");
+    if (trace_out == NULL) {
+        perror("fopen");
+        return 1;
+    }
+
+    printf("Best of %d runs, microseconds (k = %" PRIu64 ", mod = %" PRIu64 ")\n",
+           repeats, k, mod);
+    printf("%6s", "pnum");
+    for (int v = 0; v < nvariants; v++) printf(" %12s", variants[v].name);
+    printf("\n");
+
+    for (pnum = 1;; pnum = pnum * 2 < max_pnum ? pnum * 2 : max_pnum) {
+        uint64_t expected = 0;
+        printf("%6d", pnum);
+        for (int v = 0; v < nvariants; v++) {
+            double best = 0;
+            combine = variants[v].combine;
+            trace = variants[v].trace;
+            for (int r = 0; r < repeats; r++) {
+                double start = now_sec();
+                if (run_factorial() != 0) return 1;
+                double elapsed = now_sec() - start;
+                if (r == 0 || elapsed < best) best = elapsed;
+                if (v == 0 && r == 0) expected = result;
+                if (result != expected) {
+                    fprintf(stderr, "%s: result %" PRIu64 " differs from %" PRIu64 "\n",
+                            variants[v].name, result, expected);
+                    return 1;
+                }
+            }
+            printf(" %12.1f", best * 1e6);
+        }
+        printf("\n");
+        if (pnum == max_pnum) break;
+    }
+
+    fclose(trace_out);
+    AllocStatsPrint(stdout);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Парсинг аргументов командной строки
+    parse_args(argc, argv);
+
+    // Проверка корректности входных данных
+    if (bad_args || k == 0 || pnum <= 0 || mod <= 1 || (int)combine < 0) {
+        printf("Usage: %s -k <number> --pnum=<threads> --mod=<modulus> "
+               "[--combine=sem|tree|cas] [--trace[=stdio]] [--bench]\n", argv[0]);
+        printf("k must be > 0, pnum must be in 1..65536, "
+               "mod must be in 2..18446744073709551615\n");
+        return 1;
+    }
+
+    // Инициализация семафора (1 - бинарный семафор)
+    if (sem_init(&semaphore, 0, 1) != 0) {
+        perror("sem_init");
+        return 1;
+    }
+
+    if (bench) {
+        int status = run_bench();
+        sem_destroy(&semaphore);
+        return status;
+    }
+
+    printf("Calculating %" PRIu64 "! mod %" PRIu64 " using %d threads (%s)\n", k, mod, pnum,
+           combine_names[combine]);
+    fflush(stdout);
+    trace_out = stdout;
+
+    if (run_factorial() != 0) {
+        return 1;
+    }
+
     // Вывод результата
-    printf("\nFinal result: %d! mod %d = %llu\n", k, mod, result);
-    
+    printf("\nFinal result: %" PRIu64 "! mod %" PRIu64 " = %" PRIu64 "\n", k, mod, result);
+
     // Уничтожение семафора
     sem_destroy(&semaphore);
-    
+
     return 0;
 }
@@ -15,6 +15,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "lockdep.h"
+#include "lockprof.h"
+
 void do_one_thing(int *);
 void do_another_thing(int *);
 void do_wrap_up(int);
@@ -53,7 +56,7 @@ int main() {
 }
 
 void do_one_thing(int *pnum_times) {
-  int i, j, x;
+  int i;
   unsigned long k;
   int work;
   for (i = 0; i < 50; i++) {
@@ -70,7 +73,7 @@ void do_one_thing(int *pnum_times) {
 }
 
 void do_another_thing(int *pnum_times) {
-  int i, j, x;
+  int i;
   unsigned long k;
   int work;
   for (i = 0; i < 50; i++) {
@@ -87,6 +90,5 @@ void do_another_thing(int *pnum_times) {
 }
 
 void do_wrap_up(int counter) {
-  int total;
   printf("All done, counter = %d\n", counter);
 }
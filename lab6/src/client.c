@@ -15,6 +15,8 @@
 #include <arpa/inet.h>
 
 #include "common.h"  // Добавляем заголовок библиотеки
+#include "netaddr.h"
+#include "protocol.h"
 
 struct Server {
   char ip[255];
@@ -27,78 +29,88 @@ struct ThreadData {
   uint64_t end;
   uint64_t mod;
   uint64_t result;
+  uint64_t req_id;
+  bool legacy;
 };
 
+// Legacy-обмен: 24 байта запроса и 8 байт ответа в порядке байт хоста
+static bool ExchangeLegacy(int sck, struct ThreadData* data) {
+  char task[PROTO_LEGACY_REQUEST_SIZE];
+  memcpy(task, &data->begin, sizeof(uint64_t));
+  memcpy(task + sizeof(uint64_t), &data->end, sizeof(uint64_t));
+  memcpy(task + 2 * sizeof(uint64_t), &data->mod, sizeof(uint64_t));
+
+  if (!SendAll(sck, task, sizeof(task))) {
+    fprintf(stderr, "Send failed to %s:%d\n", data->server.ip, data->server.port);
+    return false;
+  }
+
+  uint64_t answer = 0;
+  if (!RecvAll(sck, &answer, sizeof(answer))) {
+    fprintf(stderr, "Receive failed from %s:%d\n", data->server.ip, data->server.port);
+    return false;
+  }
+  data->result = answer;
+  return true;
+}
+
+// Версия 1: приветствие с согласованием версии, затем один кадр-запрос
+static bool ExchangeFramed(int sck, struct ThreadData* data) {
+  uint8_t buf[PROTO_MAX_FRAME];
+  size_t len = EncodeHello(buf, PROTO_VERSION);
+  len += EncodeRequest(buf + len, data->req_id, data->begin, data->end, data->mod);
+  if (!SendAll(sck, buf, len)) {
+    fprintf(stderr, "Send failed to %s:%d\n", data->server.ip, data->server.port);
+    return false;
+  }
+
+  uint8_t hello[PROTO_HELLO_SIZE];
+  uint8_t version = 0;
+  if (!RecvAll(sck, hello, sizeof(hello)) ||
+      DecodeHello(hello, sizeof(hello), &version) != PROTO_HELLO_SIZE) {
+    fprintf(stderr, "Server %s:%d does not speak protocol version %d (try --legacy)\n",
+            data->server.ip, data->server.port, PROTO_VERSION);
+    return false;
+  }
+
+  struct Frame frame;
+  if (!RecvFrame(sck, &frame) || frame.type != FRAME_RESPONSE ||
+      frame.req_id != data->req_id) {
+    fprintf(stderr, "Receive failed from %s:%d\n", data->server.ip, data->server.port);
+    return false;
+  }
+  if (frame.flags & FRAME_FLAG_ERROR) {
+    fprintf(stderr, "Server %s:%d rejected request: error %lu\n",
+            data->server.ip, data->server.port, frame.result);
+    return false;
+  }
+  data->result = frame.result;
+  return true;
+}
+
 
 // В функции ServerThread:
 void* ServerThread(void* arg) {
   struct ThreadData* data = (struct ThreadData*)arg;
   
-  struct addrinfo hints, *res;
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET6;      // ТОЛЬКО IPv6
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_flags = AI_V4MAPPED;    // Автоматически преобразует IPv4 в IPv4-mapped
-  
   char port_str[10];
   snprintf(port_str, sizeof(port_str), "%d", data->server.port);
-  
-  int status = getaddrinfo(data->server.ip, port_str, &hints, &res);
-  if (status != 0) {
-    fprintf(stderr, "getaddrinfo failed for %s:%d: %s\n", 
-            data->server.ip, data->server.port, gai_strerror(status));
-    data->result = 0;
-    return NULL;
-  }
-  
-  // Используем первый найденный адрес
-  struct sockaddr_in6 server_addr;
-  memcpy(&server_addr, res->ai_addr, sizeof(server_addr));
-  
-  int sck = socket(AF_INET6, SOCK_STREAM, 0);
+
+  // Адреса обоих семейств: IPv4 из servers.txt подключается как IPv4,
+  // а не через IPv4-mapped адрес (его не примет сервер с IPV6_V6ONLY)
+  int sck = NetConnect(data->server.ip, port_str, SOCK_STREAM, NET_ANY);
   if (sck < 0) {
-    fprintf(stderr, "Socket creation failed!\n");
-    freeaddrinfo(res);
-    data->result = 0;
-    return NULL;
-  }
-  
-  if (connect(sck, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-    fprintf(stderr, "Connection to %s:%d failed: %s\n", 
+    fprintf(stderr, "Connection to %s:%d failed: %s\n",
             data->server.ip, data->server.port, strerror(errno));
-    close(sck);
-    freeaddrinfo(res);
-    data->result = 0;
-    return NULL;
-  }
-  
-  freeaddrinfo(res);
-  
-  // Остальной код без изменений...
-  char task[sizeof(uint64_t) * 3];
-  memcpy(task, &data->begin, sizeof(uint64_t));
-  memcpy(task + sizeof(uint64_t), &data->end, sizeof(uint64_t));
-  memcpy(task + 2 * sizeof(uint64_t), &data->mod, sizeof(uint64_t));
-  
-  if (send(sck, task, sizeof(task), 0) < 0) {
-    fprintf(stderr, "Send failed to %s:%d\n", data->server.ip, data->server.port);
-    close(sck);
     data->result = 0;
     return NULL;
   }
-  
-  char response[sizeof(uint64_t)];
-  if (recv(sck, response, sizeof(response), 0) < 0) {
-    fprintf(stderr, "Receive failed from %s:%d\n", data->server.ip, data->server.port);
-    close(sck);
+  NetTune(sck, NET_NODELAY, 0);
+
+  bool ok = data->legacy ? ExchangeLegacy(sck, data) : ExchangeFramed(sck, data);
+  if (!ok)
     data->result = 0;
-    return NULL;
-  }
-  
-  uint64_t answer = 0;
-  memcpy(&answer, response, sizeof(uint64_t));
-  data->result = answer;
-  
+
   close(sck);
   return NULL;
 }
@@ -151,11 +163,13 @@ int main(int argc, char **argv) {
   uint64_t mod = 0;
   char servers_file[255] = {'\0'};
   int servers_file_empty = 1;
+  bool legacy = false;
 
   while (true) {
     static struct option options[] = {{"k", required_argument, 0, 0},
                                       {"mod", required_argument, 0, 0},
                                       {"servers", required_argument, 0, 0},
+                                      {"legacy", no_argument, 0, 0},
                                       {0, 0, 0, 0}};
 
     int option_index = 0;
@@ -183,6 +197,9 @@ int main(int argc, char **argv) {
         strncpy(servers_file, optarg, sizeof(servers_file) - 1);
         servers_file_empty = 0;
         break;
+      case 3:
+        legacy = true;
+        break;
       default:
         printf("Index %d is out of options\n", option_index);
       }
@@ -197,7 +214,7 @@ int main(int argc, char **argv) {
   }
 
   if (k == 0 || mod == 0 || servers_file_empty) {
-    fprintf(stderr, "Using: %s --k 1000 --mod 5 --servers /path/to/file\n",
+    fprintf(stderr, "Using: %s --k 1000 --mod 5 --servers /path/to/file [--legacy]\n",
             argv[0]);
     return 1;
   }
@@ -243,6 +260,8 @@ int main(int argc, char **argv) {
     thread_data[i].end = current + numbers_per_server - 1 + extra;
     thread_data[i].mod = mod;
     thread_data[i].result = 0;
+    thread_data[i].req_id = (uint64_t)i;
+    thread_data[i].legacy = legacy;
 
     current = thread_data[i].end + 1;
 
@@ -0,0 +1,477 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "common.h"
+#include "hist.h"
+#include "netaddr.h"
+#include "protocol.h"
+
+// Сколько запросов может быть "в полете" на одном соединении в open-loop
+#define INFLIGHT_QUEUE_SIZE 65536
+
+struct LoadgenConfig {
+  char host[255];
+  char port[16];
+  int conns;
+  double duration;
+  bool open_loop;
+  double rate;
+  uint64_t range;
+  uint64_t mod;
+  bool legacy;
+  int batch;
+  int family;
+  int busy_poll_us;
+};
+
+// Буфер приема: ответы читаются крупными recv и разбираются на месте
+struct ResponseReader {
+  uint8_t buf[4096];
+  size_t len;
+  size_t offset;
+};
+
+// Очередь запланированных моментов отправки: пишет отправитель, читает
+// получатель. Задержка считается от запланированного, а не фактического
+// момента отправки, поэтому коррекция coordinated omission выполняется сама.
+struct InflightQueue {
+  uint64_t slots[INFLIGHT_QUEUE_SIZE];
+  uint64_t head;
+  uint64_t tail;
+};
+
+struct ConnState {
+  const struct LoadgenConfig *config;
+  int fd;
+  uint64_t deadline_ns;
+  uint64_t interval_ns;
+  uint64_t start_ns;
+  uint64_t sent;
+  uint64_t received;
+  uint64_t errors;
+  // Обрывы соединения и неудачные приветствия - отдельно от запросов
+  uint64_t conn_errors;
+  bool sender_done;
+  bool receiver_done;
+  bool receiver_started;
+  pthread_t receiver;
+  struct InflightQueue *queue;
+  struct Hist *hist;
+  struct ResponseReader reader;
+  uint8_t *requests;
+  size_t requests_len;
+};
+
+static int ConnectToServer(const struct LoadgenConfig *config) {
+  int fd = NetConnect(config->host, config->port, SOCK_STREAM, config->family);
+  if (fd < 0) {
+    fprintf(stderr, "Connection to %s:%s failed: %s\n", config->host,
+            config->port, strerror(errno));
+    return -1;
+  }
+
+  // Запросы маленькие - Nagle только добавил бы задержку
+  int flags = NET_NODELAY | NET_QUICKACK;
+  if (config->busy_poll_us > 0)
+    flags |= NET_BUSY_POLL;
+  if (NetTune(fd, flags, config->busy_poll_us) < 0 && config->busy_poll_us > 0)
+    perror("setsockopt SO_BUSY_POLL");
+
+  // Сервер, который обслуживает клиентов по одному, не должен вешать замер
+  struct timeval tv = {.tv_sec = 5, .tv_usec = 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  return fd;
+}
+
+// Пачка из batch одинаковых запросов, уходящая одним send
+static void BuildRequests(struct ConnState *conn) {
+  const struct LoadgenConfig *config = conn->config;
+  uint64_t begin = 1;
+  uint64_t end = config->range;
+  conn->requests = malloc((size_t)config->batch * PROTO_MAX_FRAME);
+  conn->requests_len = 0;
+
+  for (int i = 0; i < config->batch; i++) {
+    uint8_t *task = conn->requests + conn->requests_len;
+    if (config->legacy) {
+      memcpy(task, &begin, sizeof(uint64_t));
+      memcpy(task + sizeof(uint64_t), &end, sizeof(uint64_t));
+      memcpy(task + 2 * sizeof(uint64_t), &config->mod, sizeof(uint64_t));
+      conn->requests_len += PROTO_LEGACY_REQUEST_SIZE;
+    } else {
+      conn->requests_len += EncodeRequest(task, (uint64_t)i, begin, end,
+                                          config->mod);
+    }
+  }
+}
+
+// Очередной ответ из потока: 8 байт для legacy или кадр версии 1
+static bool ReadResponse(struct ConnState *conn) {
+  struct ResponseReader *reader = &conn->reader;
+  while (true) {
+    size_t avail = reader->len - reader->offset;
+    const uint8_t *p = reader->buf + reader->offset;
+    if (conn->config->legacy) {
+      if (avail >= PROTO_LEGACY_RESPONSE_SIZE) {
+        reader->offset += PROTO_LEGACY_RESPONSE_SIZE;
+        return true;
+      }
+    } else {
+      struct Frame frame;
+      int n = DecodeFrame(p, avail, &frame);
+      if (n < 0 || (n > 0 && (frame.flags & FRAME_FLAG_ERROR)))
+        return false;
+      if (n > 0) {
+        reader->offset += (size_t)n;
+        return true;
+      }
+    }
+
+    memmove(reader->buf, p, avail);
+    reader->len = avail;
+    reader->offset = 0;
+    ssize_t n = recv(conn->fd, reader->buf + reader->len,
+                     sizeof(reader->buf) - reader->len, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    reader->len += (size_t)n;
+  }
+}
+
+// Приветствие версии 1, для legacy-сервера не нужно
+static bool Handshake(struct ConnState *conn) {
+  if (conn->config->legacy)
+    return true;
+  uint8_t hello[PROTO_HELLO_SIZE];
+  uint8_t version = 0;
+  EncodeHello(hello, PROTO_VERSION);
+  if (!SendAll(conn->fd, hello, sizeof(hello)) ||
+      !RecvAll(conn->fd, hello, sizeof(hello)) ||
+      DecodeHello(hello, sizeof(hello), &version) != PROTO_HELLO_SIZE) {
+    fprintf(stderr, "Protocol handshake failed (try --proto legacy)\n");
+    return false;
+  }
+  return true;
+}
+
+static void SleepUntil(uint64_t when_ns) {
+  struct timespec ts;
+  ts.tv_sec = (time_t)(when_ns / 1000000000ull);
+  ts.tv_nsec = (long)(when_ns % 1000000000ull);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+}
+
+// Closed-loop: следующая пачка уходит только после ответа на предыдущую
+static void *ClosedLoopThread(void *arg) {
+  struct ConnState *conn = (struct ConnState *)arg;
+  int batch = conn->config->batch;
+
+  if (!Handshake(conn)) {
+    conn->conn_errors++;
+    return NULL;
+  }
+  while (MonotonicNs() < conn->deadline_ns) {
+    uint64_t t0 = MonotonicNs();
+    if (!SendAll(conn->fd, conn->requests, conn->requests_len)) {
+      conn->errors += batch;
+      conn->conn_errors++;
+      break;
+    }
+    conn->sent += batch;
+    for (int i = 0; i < batch; i++) {
+      if (!ReadResponse(conn)) {
+        conn->errors += batch - i;
+        conn->conn_errors++;
+        return NULL;
+      }
+      HistRecord(conn->hist, MonotonicNs() - t0);
+      conn->received++;
+    }
+  }
+  return NULL;
+}
+
+static void *OpenLoopReceiver(void *arg) {
+  struct ConnState *conn = (struct ConnState *)arg;
+  struct InflightQueue *queue = conn->queue;
+
+  while (ReadResponse(conn)) {
+    uint64_t scheduled = queue->slots[queue->head % INFLIGHT_QUEUE_SIZE];
+    __atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+    HistRecord(conn->hist, MonotonicNs() - scheduled);
+    conn->received++;
+  }
+
+  // Соединение оборвалось раньше времени - останавливаем отправителя
+  if (!__atomic_load_n(&conn->sender_done, __ATOMIC_ACQUIRE)) {
+    conn->conn_errors++;
+    shutdown(conn->fd, SHUT_RDWR);
+  }
+  __atomic_store_n(&conn->receiver_done, true, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Open-loop: запросы уходят по расписанию независимо от ответов
+static void *OpenLoopSender(void *arg) {
+  struct ConnState *conn = (struct ConnState *)arg;
+  struct InflightQueue *queue = conn->queue;
+  int batch = conn->config->batch;
+
+  // Получатель стартует после приветствия, чтобы не прочитать его ответ
+  if (!Handshake(conn)) {
+    conn->conn_errors++;
+    return NULL;
+  }
+  if (pthread_create(&conn->receiver, NULL, OpenLoopReceiver, conn) != 0) {
+    fprintf(stderr, "Error creating receiver thread\n");
+    conn->conn_errors++;
+    return NULL;
+  }
+  conn->receiver_started = true;
+
+  uint64_t next = conn->start_ns;
+  while (next < conn->deadline_ns) {
+    SleepUntil(next);
+    // Очередь полна - сервер безнадежно отстал, ждем ответов
+    while (queue->tail + batch - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) >
+               INFLIGHT_QUEUE_SIZE &&
+           !__atomic_load_n(&conn->receiver_done, __ATOMIC_ACQUIRE))
+      sched_yield();
+    if (__atomic_load_n(&conn->receiver_done, __ATOMIC_ACQUIRE))
+      break;
+
+    for (int i = 0; i < batch; i++)
+      queue->slots[(queue->tail + i) % INFLIGHT_QUEUE_SIZE] = next;
+    __atomic_store_n(&queue->tail, queue->tail + batch, __ATOMIC_RELEASE);
+    // Неотправленная пачка остается в очереди и попадет в ошибки в main
+    if (!SendAll(conn->fd, conn->requests, conn->requests_len))
+      break;
+    conn->sent += batch;
+    next += conn->interval_ns;
+  }
+  __atomic_store_n(&conn->sender_done, true, __ATOMIC_RELEASE);
+  // Сервер ответит на все отправленное и закроет соединение, после чего
+  // получатель увидит EOF и завершится без таймаута
+  shutdown(conn->fd, SHUT_WR);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  struct LoadgenConfig config;
+  memset(&config, 0, sizeof(config));
+  strcpy(config.host, "::1");
+  strcpy(config.port, "20001");
+  config.conns = 1;
+  config.duration = 5.0;
+  config.range = 100;
+  config.mod = 1000000007;
+  config.batch = 1;
+
+  while (true) {
+    static struct option options[] = {{"host", required_argument, 0, 0},
+                                      {"port", required_argument, 0, 0},
+                                      {"conns", required_argument, 0, 0},
+                                      {"duration", required_argument, 0, 0},
+                                      {"mode", required_argument, 0, 0},
+                                      {"rate", required_argument, 0, 0},
+                                      {"range", required_argument, 0, 0},
+                                      {"mod", required_argument, 0, 0},
+                                      {"proto", required_argument, 0, 0},
+                                      {"batch", required_argument, 0, 0},
+                                      {"family", required_argument, 0, 0},
+                                      {"busy-poll", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1)
+      break;
+
+    switch (c) {
+    case 0: {
+      switch (option_index) {
+      case 0:
+        strncpy(config.host, optarg, sizeof(config.host) - 1);
+        break;
+      case 1:
+        strncpy(config.port, optarg, sizeof(config.port) - 1);
+        break;
+      case 2:
+        config.conns = atoi(optarg);
+        break;
+      case 3:
+        config.duration = atof(optarg);
+        break;
+      case 4:
+        if (strcmp(optarg, "open") == 0) {
+          config.open_loop = true;
+        } else if (strcmp(optarg, "closed") == 0) {
+          config.open_loop = false;
+        } else {
+          fprintf(stderr, "Unknown mode %s (expected open or closed)\n",
+                  optarg);
+          return 1;
+        }
+        break;
+      case 5:
+        config.rate = atof(optarg);
+        break;
+      case 6:
+        if (!ConvertStringToUI64(optarg, &config.range)) {
+          fprintf(stderr, "Invalid range value\n");
+          return 1;
+        }
+        break;
+      case 7:
+        if (!ConvertStringToUI64(optarg, &config.mod)) {
+          fprintf(stderr, "Invalid mod value\n");
+          return 1;
+        }
+        break;
+      case 8:
+        if (strcmp(optarg, "legacy") == 0) {
+          config.legacy = true;
+        } else if (strcmp(optarg, "v1") == 0) {
+          config.legacy = false;
+        } else {
+          fprintf(stderr, "Unknown protocol %s (expected legacy or v1)\n",
+                  optarg);
+          return 1;
+        }
+        break;
+      case 9:
+        config.batch = atoi(optarg);
+        break;
+      case 10:
+        config.family = NetParseFamily(optarg);
+        if (config.family < 0) {
+          fprintf(stderr, "Unknown family %s (expected any, ipv4 or ipv6)\n",
+                  optarg);
+          return 1;
+        }
+        break;
+      case 11:
+        config.busy_poll_us = atoi(optarg);
+        break;
+      default:
+        printf("Index %d is out of options\n", option_index);
+      }
+    } break;
+
+    case '?':
+      printf("Arguments error\n");
+      break;
+    default:
+      fprintf(stderr, "getopt returned character code 0%o?\n", c);
+    }
+  }
+
+  if (config.conns <= 0 || config.duration <= 0 || config.range == 0 ||
+      config.mod == 0 || config.batch <= 0 ||
+      config.batch > INFLIGHT_QUEUE_SIZE ||
+      (config.open_loop && config.rate <= 0)) {
+    fprintf(stderr,
+            "Using: %s --host ::1 --port 20001 --conns 4 --duration 10 "
+            "--mode closed|open [--rate 10000] --range 100 --mod 1000000007 "
+            "[--proto legacy|v1] [--batch 1] [--family any|ipv4|ipv6] "
+            "[--busy-poll usec]\n",
+            argv[0]);
+    return 1;
+  }
+
+  int conns = config.conns;
+  pthread_t senders[conns];
+  struct ConnState *states = calloc((size_t)conns, sizeof(struct ConnState));
+
+  for (int i = 0; i < conns; i++) {
+    states[i].config = &config;
+    states[i].fd = ConnectToServer(&config);
+    states[i].hist = malloc(sizeof(struct Hist));
+    HistInit(states[i].hist);
+    BuildRequests(&states[i]);
+    if (config.open_loop)
+      states[i].queue = calloc(1, sizeof(struct InflightQueue));
+    if (states[i].fd < 0)
+      return 1;
+  }
+
+  printf("Mode: %s-loop, connections: %d, duration: %.2f s, range: %llu, "
+         "mod: %llu\n",
+         config.open_loop ? "open" : "closed", conns, config.duration,
+         (unsigned long long)config.range, (unsigned long long)config.mod);
+  printf("Protocol: %s, batch: %d, request size: %zu bytes\n",
+         config.legacy ? "legacy" : "v1", config.batch,
+         states[0].requests_len / (size_t)config.batch);
+  if (config.open_loop)
+    printf("Target rate: %.0f req/s\n", config.rate);
+
+  uint64_t start = MonotonicNs();
+  uint64_t deadline = start + (uint64_t)(config.duration * 1e9);
+  for (int i = 0; i < conns; i++) {
+    states[i].start_ns = start;
+    states[i].deadline_ns = deadline;
+    if (config.open_loop) {
+      states[i].interval_ns =
+          (uint64_t)(1e9 * conns * config.batch / config.rate);
+      if (states[i].interval_ns == 0)
+        states[i].interval_ns = 1;
+      // Разносим соединения по фазе, чтобы не отправлять пачкой
+      states[i].start_ns = start + states[i].interval_ns * i / conns;
+      pthread_create(&senders[i], NULL, OpenLoopSender, &states[i]);
+    } else {
+      pthread_create(&senders[i], NULL, ClosedLoopThread, &states[i]);
+    }
+  }
+
+  struct Hist *total = malloc(sizeof(struct Hist));
+  HistInit(total);
+  uint64_t sent = 0, received = 0, errors = 0, conn_errors = 0;
+  for (int i = 0; i < conns; i++) {
+    pthread_join(senders[i], NULL);
+    if (states[i].receiver_started)
+      pthread_join(states[i].receiver, NULL);
+    // Все неотвеченные запросы считаем потерянными
+    if (config.open_loop)
+      states[i].errors += states[i].queue->tail - states[i].queue->head;
+    HistMerge(total, states[i].hist);
+    sent += states[i].sent;
+    received += states[i].received;
+    errors += states[i].errors;
+    conn_errors += states[i].conn_errors;
+    close(states[i].fd);
+    free(states[i].hist);
+    free(states[i].queue);
+    free(states[i].requests);
+  }
+  double elapsed = (MonotonicNs() - start) / 1e9;
+
+  printf("Requests: sent %llu, completed %llu, errors %llu\n",
+         (unsigned long long)sent, (unsigned long long)received,
+         (unsigned long long)errors);
+  printf("Connections: %d, failed %llu\n", conns, (unsigned long long)conn_errors);
+  printf("Elapsed: %.3f s\n", elapsed);
+  printf("Throughput: %.1f req/s\n", received / elapsed);
+  HistPrint(stdout, "Latency", total, 1000.0, "us");
+
+  free(total);
+  free(states);
+  return errors == 0 && conn_errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,114 @@
+#include "logger.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lockdep.h"
+#include "lockprof.h"
+
+#define LOG_BUFFER_SIZE (256 * 1024)
+#define LOG_LINE_MAX 512
+#define LOG_FLUSH_INTERVAL_MS 100
+
+int g_log_level = LOG_OFF;
+
+// Двойная буферизация: пока один буфер пишется в stdout, второй заполняется
+static char buffers[2][LOG_BUFFER_SIZE];
+static size_t fill_len = 0;
+static int fill_index = 0;
+static unsigned long dropped = 0;
+static bool running = false;
+
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t flusher;
+
+static void *FlusherThread(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&log_mutex);
+  while (true) {
+    if (running && fill_len < LOG_BUFFER_SIZE / 2) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&log_cond, &log_mutex, &deadline);
+    }
+
+    char *data = buffers[fill_index];
+    size_t len = fill_len;
+    unsigned long lost = dropped;
+    fill_index ^= 1;
+    fill_len = 0;
+    dropped = 0;
+    bool stop = !running;
+
+    // Запись в stdout идет без блокировки - пишущие потоки не ждут
+    pthread_mutex_unlock(&log_mutex);
+    if (len > 0)
+      fwrite(data, 1, len, stdout);
+    if (lost > 0)
+      fprintf(stdout, "[log] %lu messages dropped\n", lost);
+    if (len > 0 || lost > 0)
+      fflush(stdout);
+    pthread_mutex_lock(&log_mutex);
+
+    if (stop && fill_len == 0)
+      break;
+  }
+  pthread_mutex_unlock(&log_mutex);
+  return NULL;
+}
+
+void LogStart(int level) {
+  g_log_level = level;
+  if (level <= LOG_OFF)
+    return;
+  running = true;
+  if (pthread_create(&flusher, NULL, FlusherThread, NULL) != 0) {
+    fprintf(stderr, "Can not start logger thread, logging disabled\n");
+    running = false;
+    g_log_level = LOG_OFF;
+  }
+}
+
+void LogStop(void) {
+  if (!running)
+    return;
+  pthread_mutex_lock(&log_mutex);
+  running = false;
+  pthread_cond_signal(&log_cond);
+  pthread_mutex_unlock(&log_mutex);
+  pthread_join(flusher, NULL);
+  g_log_level = LOG_OFF;
+}
+
+void LogWrite(const char *fmt, ...) {
+  char line[LOG_LINE_MAX];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (n < 0)
+    return;
+  size_t len = (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1;
+
+  pthread_mutex_lock(&log_mutex);
+  // Поток записи не успевает - теряем сообщение, но не блокируем сервер
+  if (fill_len + len > LOG_BUFFER_SIZE) {
+    dropped++;
+  } else {
+    memcpy(buffers[fill_index] + fill_len, line, len);
+    fill_len += len;
+    if (fill_len >= LOG_BUFFER_SIZE / 2)
+      pthread_cond_signal(&log_cond);
+  }
+  pthread_mutex_unlock(&log_mutex);
+}
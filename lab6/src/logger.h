@@ -0,0 +1,30 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+/*
+ * Асинхронный буферизованный лог. Потоки только форматируют строку и
+ * копируют ее в общий буфер, в stdout пишет отдельный поток крупными
+ * блоками. При уровне LOG_OFF (по умолчанию) макрос LOG стоит одно
+ * сравнение, аргументы даже не вычисляются.
+ */
+
+enum LogLevel {
+  LOG_OFF = 0,
+  LOG_ERROR = 1,
+  LOG_INFO = 2,
+  LOG_DEBUG = 3,
+};
+
+extern int g_log_level;
+
+void LogStart(int level);
+void LogStop(void);
+void LogWrite(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#define LOG(level, ...)                                                        \
+  do {                                                                         \
+    if ((level) <= g_log_level)                                                \
+      LogWrite(__VA_ARGS__);                                                   \
+  } while (0)
+
+#endif
@@ -0,0 +1,178 @@
+#include "protocol.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+static const uint8_t kHelloMagic[3] = {'F', 'C', 'T'};
+
+size_t PutVarint(uint8_t *buf, uint64_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    buf[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buf[n++] = (uint8_t)value;
+  return n;
+}
+
+int GetVarint(const uint8_t *buf, size_t len, uint64_t *value) {
+  uint64_t result = 0;
+  for (size_t i = 0; i < len && i < PROTO_MAX_VARINT; i++) {
+    uint64_t byte = buf[i];
+    // Десятый байт может нести только старший бит значения
+    if (i == PROTO_MAX_VARINT - 1 && byte > 1)
+      return -1;
+    result |= (byte & 0x7f) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return (int)i + 1;
+    }
+  }
+  return len >= PROTO_MAX_VARINT ? -1 : 0;
+}
+
+size_t EncodeHello(uint8_t *buf, uint8_t version) {
+  memcpy(buf, kHelloMagic, sizeof(kHelloMagic));
+  buf[3] = version;
+  return PROTO_HELLO_SIZE;
+}
+
+int DecodeHello(const uint8_t *buf, size_t len, uint8_t *version) {
+  size_t n = len < sizeof(kHelloMagic) ? len : sizeof(kHelloMagic);
+  if (memcmp(buf, kHelloMagic, n) != 0)
+    return -1;
+  if (len < PROTO_HELLO_SIZE)
+    return 0;
+  if (buf[3] == 0)
+    return -1;
+  *version = buf[3];
+  return PROTO_HELLO_SIZE;
+}
+
+// Тело кадра собирается после запаса под длину, затем сдвигается к ней
+static size_t FinishFrame(uint8_t *buf, uint8_t *body, size_t body_len) {
+  size_t prefix = PutVarint(buf, body_len);
+  memmove(buf + prefix, body, body_len);
+  return prefix + body_len;
+}
+
+size_t EncodeRequest(uint8_t *buf, uint64_t req_id, uint64_t begin,
+                     uint64_t end, uint64_t mod) {
+  uint8_t body[PROTO_MAX_FRAME];
+  size_t n = 0;
+  body[n++] = FRAME_REQUEST;
+  body[n++] = 0;
+  n += PutVarint(body + n, req_id);
+  n += PutVarint(body + n, begin);
+  n += PutVarint(body + n, end);
+  n += PutVarint(body + n, mod);
+  return FinishFrame(buf, body, n);
+}
+
+size_t EncodeResponse(uint8_t *buf, uint64_t req_id, uint8_t flags,
+                      uint64_t result) {
+  uint8_t body[PROTO_MAX_FRAME];
+  size_t n = 0;
+  body[n++] = FRAME_RESPONSE;
+  body[n++] = flags;
+  n += PutVarint(body + n, req_id);
+  n += PutVarint(body + n, result);
+  return FinishFrame(buf, body, n);
+}
+
+int DecodeFrame(const uint8_t *buf, size_t len, struct Frame *frame) {
+  uint64_t body_len = 0;
+  int prefix = GetVarint(buf, len, &body_len);
+  if (prefix <= 0)
+    return prefix;
+  if (body_len < 3 || body_len > PROTO_MAX_FRAME)
+    return -1;
+  if (len < (size_t)prefix + body_len)
+    return 0;
+
+  const uint8_t *p = buf + prefix;
+  const uint8_t *body_end = p + body_len;
+  memset(frame, 0, sizeof(*frame));
+  frame->type = *p++;
+  frame->flags = *p++;
+
+  uint64_t *fields[4] = {&frame->req_id, NULL, NULL, NULL};
+  int nfields = 0;
+  switch (frame->type) {
+  case FRAME_REQUEST:
+    fields[1] = &frame->begin;
+    fields[2] = &frame->end;
+    fields[3] = &frame->mod;
+    nfields = 4;
+    break;
+  case FRAME_RESPONSE:
+    fields[1] = &frame->result;
+    nfields = 2;
+    break;
+  default:
+    // Неизвестный тип пропускаем целиком, пусть решает вызывающий
+    GetVarint(p, (size_t)(body_end - p), &frame->req_id);
+    return prefix + (int)body_len;
+  }
+
+  for (int i = 0; i < nfields; i++) {
+    int n = GetVarint(p, (size_t)(body_end - p), fields[i]);
+    if (n <= 0)
+      return -1;
+    p += n;
+  }
+  // Хвост тела оставлен для будущих полей - старые версии его пропускают
+  return prefix + (int)body_len;
+}
+
+bool SendAll(int fd, const void *buf, size_t len) {
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool RecvAll(int fd, void *buf, size_t len) {
+  char *p = buf;
+  while (len > 0) {
+    ssize_t n = recv(fd, p, len, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool RecvFrame(int fd, struct Frame *frame) {
+  uint8_t buf[PROTO_MAX_FRAME + PROTO_MAX_VARINT];
+  size_t len = 0;
+  uint64_t body_len = 0;
+
+  // Длину читаем по байту, тело - одним куском
+  while (true) {
+    if (len == PROTO_MAX_VARINT || !RecvAll(fd, buf + len, 1))
+      return false;
+    len++;
+    int n = GetVarint(buf, len, &body_len);
+    if (n < 0)
+      return false;
+    if (n > 0)
+      break;
+  }
+  if (body_len > PROTO_MAX_FRAME || !RecvAll(fd, buf + len, body_len))
+    return false;
+  return DecodeFrame(buf, len + body_len, frame) > 0;
+}
@@ -0,0 +1,83 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Протокол обмена клиента и сервера.
+ *
+ * Legacy (версия 0): клиент шлет 24 байта - begin, end, mod как uint64_t в
+ * порядке байт хоста, сервер отвечает 8 байтами результата.
+ *
+ * Версия 1: соединение начинается с приветствия из 4 байт "FCT" + версия.
+ * Клиент шлет максимальную поддерживаемую версию, сервер отвечает выбранной.
+ * Дальше идут кадры:
+ *
+ *   varint body_len | u8 type | u8 flags | varint req_id | payload
+ *
+ * Все целые кодируются varint (LEB128), поэтому формат не зависит от
+ * порядка байт, а типичный запрос занимает 8-12 байт вместо 24. Ответы
+ * несут тот же req_id, так что клиент может слать запросы пачкой.
+ *
+ * Сервер отличает legacy-клиента по первым 4 байтам: у legacy это младшие
+ * байты begin, и совпасть с "FCT"+версия (версия 0 не принимается) они
+ * могут только при begin mod 2^32 = 0x00544346 + v * 2^24, v = 1..255:
+ * впервые при 0x01544346 (около 22.3 млн), дальше через каждые 2^24 -
+ * такие клиенты должны перейти на версию 1.
+ */
+
+#define PROTO_VERSION 1
+#define PROTO_HELLO_SIZE 4
+#define PROTO_LEGACY_REQUEST_SIZE (sizeof(uint64_t) * 3)
+#define PROTO_LEGACY_RESPONSE_SIZE sizeof(uint64_t)
+#define PROTO_MAX_VARINT 10
+#define PROTO_MAX_FRAME (PROTO_MAX_VARINT * 5 + 2)
+#define PROTO_MIN_FRAME 4 /* длина, тип, флаги, однобайтовый req_id */
+#define PROTO_MAX_RESPONSE (1 + 2 + 2 * PROTO_MAX_VARINT)
+
+enum FrameType {
+  FRAME_REQUEST = 1,
+  FRAME_RESPONSE = 2,
+};
+
+enum FrameFlags {
+  FRAME_FLAG_ERROR = 1 << 0, /* в ответе вместо результата код ошибки */
+};
+
+enum ProtoError {
+  PROTO_ERR_BAD_RANGE = 1,
+  PROTO_ERR_BAD_MOD = 2,
+  PROTO_ERR_BAD_TYPE = 3,
+};
+
+struct Frame {
+  uint8_t type;
+  uint8_t flags;
+  uint64_t req_id;
+  uint64_t begin; /* FRAME_REQUEST */
+  uint64_t end;
+  uint64_t mod;
+  uint64_t result; /* FRAME_RESPONSE: результат или код ошибки */
+};
+
+/* Возвращают число записанных байт. */
+size_t PutVarint(uint8_t *buf, uint64_t value);
+size_t EncodeHello(uint8_t *buf, uint8_t version);
+size_t EncodeRequest(uint8_t *buf, uint64_t req_id, uint64_t begin,
+                     uint64_t end, uint64_t mod);
+size_t EncodeResponse(uint8_t *buf, uint64_t req_id, uint8_t flags,
+                      uint64_t result);
+
+/* > 0 - прочитано байт, 0 - данных пока не хватает, -1 - ошибка формата. */
+int GetVarint(const uint8_t *buf, size_t len, uint64_t *value);
+int DecodeHello(const uint8_t *buf, size_t len, uint8_t *version);
+int DecodeFrame(const uint8_t *buf, size_t len, struct Frame *frame);
+
+/* Блокирующие помощники для клиентов. */
+bool SendAll(int fd, const void *buf, size_t len);
+bool RecvAll(int fd, void *buf, size_t len);
+bool RecvFrame(int fd, struct Frame *frame);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/*
+ * Кольцевой буфер байт. Емкость - степень двойки, head и tail растут
+ * монотонно и сворачиваются маской. Свободное место и данные отдаются
+ * как пара iovec, поэтому один readv/writev покрывает весь буфер даже
+ * при переходе через конец.
+ */
+struct RingBuf {
+  uint8_t *data;
+  size_t cap;
+  size_t head; /* отсюда читаем */
+  size_t tail; /* сюда пишем */
+};
+
+static inline size_t RingUsed(const struct RingBuf *r) {
+  return r->tail - r->head;
+}
+
+static inline size_t RingFree(const struct RingBuf *r) {
+  return r->cap - RingUsed(r);
+}
+
+/* Непрерывный кусок данных, начиная с head. */
+static inline size_t RingContig(const struct RingBuf *r, const uint8_t **p) {
+  size_t offset = r->head & (r->cap - 1);
+  size_t used = RingUsed(r);
+  *p = r->data + offset;
+  return used < r->cap - offset ? used : r->cap - offset;
+}
+
+static inline int RingIov(const struct RingBuf *r, size_t from, size_t len,
+                          struct iovec iov[2]) {
+  if (len == 0)
+    return 0;
+  size_t offset = from & (r->cap - 1);
+  size_t first = len < r->cap - offset ? len : r->cap - offset;
+  iov[0].iov_base = r->data + offset;
+  iov[0].iov_len = first;
+  if (first == len)
+    return 1;
+  iov[1].iov_base = r->data;
+  iov[1].iov_len = len - first;
+  return 2;
+}
+
+static inline int RingDataIov(const struct RingBuf *r, struct iovec iov[2]) {
+  return RingIov(r, r->head, RingUsed(r), iov);
+}
+
+static inline int RingFreeIov(const struct RingBuf *r, struct iovec iov[2]) {
+  return RingIov(r, r->tail, RingFree(r), iov);
+}
+
+static inline void RingProduce(struct RingBuf *r, size_t n) { r->tail += n; }
+
+static inline void RingConsume(struct RingBuf *r, size_t n) {
+  r->head += n;
+  // Пустой буфер выравниваем к началу, чтобы кадры реже переходили конец
+  if (r->head == r->tail)
+    r->head = r->tail = 0;
+}
+
+/* Копирует до n байт от head без потребления. */
+static inline size_t RingPeek(const struct RingBuf *r, void *dst, size_t n) {
+  struct iovec iov[2];
+  size_t len = n < RingUsed(r) ? n : RingUsed(r);
+  int cnt = RingIov(r, r->head, len, iov);
+  size_t copied = 0;
+  for (int i = 0; i < cnt; i++) {
+    memcpy((uint8_t *)dst + copied, iov[i].iov_base, iov[i].iov_len);
+    copied += iov[i].iov_len;
+  }
+  return copied;
+}
+
+static inline bool RingWrite(struct RingBuf *r, const void *src, size_t n) {
+  if (n > RingFree(r))
+    return false;
+  struct iovec iov[2];
+  int cnt = RingIov(r, r->tail, n, iov);
+  size_t copied = 0;
+  for (int i = 0; i < cnt; i++) {
+    memcpy(iov[i].iov_base, (const uint8_t *)src + copied, iov[i].iov_len);
+    copied += iov[i].iov_len;
+  }
+  r->tail += n;
+  return true;
+}
+
+#endif
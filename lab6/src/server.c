@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -6,43 +8,237 @@
 #include <unistd.h>
 #include <errno.h>
 
+#include <fcntl.h>
 #include <getopt.h>
+#include <signal.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
 
-#include "pthread.h"
-#include "common.h"
+#include "logger.h"
+#include "netaddr.h"
+#include "pgo.h"
+#include "protocol.h"
+#include "server_core.h"
+#include "uring_engine.h"
+
+// Сколько событий забирает один epoll_wait
+#define EPOLL_BATCH 256
+
+// Блокирующий цикл: клиенты обслуживаются строго по одному
+static void RunBlockingEngine(int server_fd, int tnum) {
+  while (true) {
+    LOG(LOG_INFO, "Waiting for connections...\n");
 
-struct FactorialArgs {
-  uint64_t begin;
-  uint64_t end;
-  uint64_t mod;
-};
+    // 8. ПРИНЯТИЕ НОВОГО СОЕДИНЕНИЯ
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+      LOG(LOG_ERROR, "Could not accept new connection: %s\n", strerror(errno));
+      continue;
+    }
 
-uint64_t Factorial(const struct FactorialArgs *args) {
-  uint64_t ans = 1;
-  for (uint64_t i = args->begin; i <= args->end; i++) {
-    ans = MultModulo(ans, i, args->mod);
+    struct Conn *conn = ConnCreate(client_fd);
+    if (conn == NULL) {
+      LOG(LOG_ERROR, "Out of memory for connection\n");
+      close(client_fd);
+      continue;
+    }
+    ConnSetup(conn);
+
+    // 10. ОБРАБОТКА КЛИЕНТА: один readv забирает все пришедшие запросы,
+    // ответы на них уходят одним writev
+    while (true) {
+      ssize_t read_bytes = ConnFill(conn);
+      if (read_bytes == 0) {
+        LOG(LOG_INFO, "Client %s disconnected\n", conn->peer);
+        break;
+      }
+      if (read_bytes < 0) {
+        if (errno == EINTR)
+          continue;
+        LOG(LOG_ERROR, "Client read failed: %s\n", strerror(errno));
+        break;
+      }
+
+      bool ok = true;
+      do {
+        ok = ConnProcess(conn, tnum);
+        while (RingUsed(&conn->out) > 0 && ok) {
+          if (ConnFlush(conn) < 0 && errno != EINTR) {
+            LOG(LOG_ERROR, "Can't send data to client: %s\n", strerror(errno));
+            ok = false;
+          }
+        }
+      } while (ok && conn->stalled);
+      if (!ok)
+        break;
+    }
+
+    // 16. ЗАКРЫТИЕ СОКЕТА КЛИЕНТА
+    close(client_fd);
+    ConnDestroy(conn);
+    LOG(LOG_INFO, "Client socket closed\n");
   }
-  return ans;
 }
 
-void *ThreadFactorial(void *args) {
-  struct FactorialArgs *fargs = (struct FactorialArgs *)args;
-  uint64_t *result = malloc(sizeof(uint64_t));
-  *result = Factorial(fargs);
-  return (void *)result;
+static void CloseConn(int epoll_fd, struct Conn *conn) {
+  LOG(LOG_INFO, "Client %s disconnected\n", conn->peer);
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+  close(conn->fd);
+  ConnDestroy(conn);
+}
+
+// Подписка зависит от состояния: не читаем, пока некуда класть ответы,
+// и ждем EPOLLOUT, только пока есть неотправленные данные
+static void UpdateInterest(int epoll_fd, struct Conn *conn) {
+  uint32_t events = 0;
+  if (!conn->stalled && !conn->eof && RingFree(&conn->in) > 0)
+    events |= EPOLLIN;
+  if (RingUsed(&conn->out) > 0)
+    events |= EPOLLOUT;
+  if (events == conn->events)
+    return;
+  struct epoll_event ev = {.events = events, .data.ptr = conn};
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+  conn->events = events;
+}
+
+static void AcceptClients(int epoll_fd, int server_fd) {
+  while (true) {
+    int client_fd = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK);
+    if (client_fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        LOG(LOG_ERROR, "Could not accept new connection: %s\n", strerror(errno));
+      return;
+    }
+
+    struct Conn *conn = ConnCreate(client_fd);
+    if (conn == NULL) {
+      LOG(LOG_ERROR, "Out of memory for connection\n");
+      close(client_fd);
+      continue;
+    }
+    ConnSetup(conn);
+
+    conn->events = EPOLLIN;
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = conn};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+      LOG(LOG_ERROR, "epoll_ctl failed: %s\n", strerror(errno));
+      close(client_fd);
+      ConnDestroy(conn);
+    }
+  }
+}
+
+// Обработка готового соединения: читаем до EAGAIN или заполнения кольца,
+// разбираем все кадры на месте и отвечаем одним writev
+static bool HandleConn(struct Conn *conn, uint32_t events, int tnum) {
+  if (events & (EPOLLERR | EPOLLHUP) && !(events & EPOLLIN))
+    return false;
+
+  if (events & EPOLLIN) {
+    while (!conn->eof && RingFree(&conn->in) > 0) {
+      size_t space = RingFree(&conn->in);
+      ssize_t n = ConnFill(conn);
+      if (n == 0) {
+        // Клиент закончил слать запросы, но ответы на них еще должен получить
+        conn->eof = true;
+        break;
+      }
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        LOG(LOG_ERROR, "Client read failed: %s\n", strerror(errno));
+        return false;
+      }
+      // Короткое чтение - сокет пуст; epoll level-triggered и сообщит о
+      // новых данных сам, лишний readv ради EAGAIN не нужен
+      if ((size_t)n < space)
+        break;
+    }
+  }
+
+  // Разбор и отправка чередуются, пока клиент успевает забирать ответы
+  while (true) {
+    if (!ConnProcess(conn, tnum))
+      return false;
+    if (RingUsed(&conn->out) == 0)
+      return !conn->eof || conn->stalled;
+    ssize_t n = ConnFlush(conn);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      if (errno == EINTR)
+        continue;
+      LOG(LOG_ERROR, "Can't send data to client: %s\n", strerror(errno));
+      return false;
+    }
+    if (!conn->stalled && RingUsed(&conn->out) == 0)
+      return !conn->eof;
+  }
+}
+
+// Событийный цикл: все клиенты обслуживаются одним потоком на epoll
+static int RunEpollEngine(int server_fd, int tnum) {
+  int epoll_fd = epoll_create1(0);
+  if (epoll_fd < 0) {
+    fprintf(stderr, "epoll_create1 failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int flags = fcntl(server_fd, F_GETFL, 0);
+  fcntl(server_fd, F_SETFL, flags | O_NONBLOCK);
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) < 0) {
+    fprintf(stderr, "epoll_ctl failed: %s\n", strerror(errno));
+    close(epoll_fd);
+    return 1;
+  }
+
+  struct epoll_event events[EPOLL_BATCH];
+  while (true) {
+    int ready = epoll_wait(epoll_fd, events, EPOLL_BATCH, -1);
+    if (ready < 0) {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "epoll_wait failed: %s\n", strerror(errno));
+      close(epoll_fd);
+      return 1;
+    }
+
+    for (int i = 0; i < ready; i++) {
+      struct Conn *conn = events[i].data.ptr;
+      if (conn == NULL) {
+        AcceptClients(epoll_fd, server_fd);
+        continue;
+      }
+      if (!HandleConn(conn, events[i].events, tnum))
+        CloseConn(epoll_fd, conn);
+      else
+        UpdateInterest(epoll_fd, conn);
+    }
+  }
 }
 
 int main(int argc, char **argv) {
   int tnum = -1;
   int port = -1;
+  int log_level = LOG_OFF;
+  const char *engine = "epoll";
+  int family = NET_IPV6;
 
   while (true) {
     static struct option options[] = {{"port", required_argument, 0, 0},
                                       {"tnum", required_argument, 0, 0},
+                                      {"engine", required_argument, 0, 0},
+                                      {"log_level", required_argument, 0, 0},
+                                      {"family", required_argument, 0, 0},
+                                      {"busy-poll", required_argument, 0, 0},
                                       {0, 0, 0, 0}};
     int option_index = 0;
     int c = getopt_long(argc, argv, "", options, &option_index);
@@ -58,6 +254,28 @@ int main(int argc, char **argv) {
           case 1: 
             tnum = atoi(optarg); 
             break;
+          case 2:
+            if (strcmp(optarg, "blocking") != 0 && strcmp(optarg, "epoll") != 0 &&
+                strcmp(optarg, "uring") != 0) {
+              fprintf(stderr, "Unknown engine %s (expected blocking, epoll or uring)\n",
+                      optarg);
+              return 1;
+            }
+            engine = optarg;
+            break;
+          case 3:
+            log_level = atoi(optarg);
+            break;
+          case 4:
+            family = NetParseFamily(optarg);
+            if (family < 0) {
+              fprintf(stderr, "Unknown family %s (expected any, ipv4 or ipv6)\n", optarg);
+              return 1;
+            }
+            break;
+          case 5:
+            g_busy_poll_us = atoi(optarg);
+            break;
           default: 
             printf("Index %d is out of options\n", option_index);
         }
@@ -67,176 +285,62 @@ int main(int argc, char **argv) {
     }
   }
 
-  if (port == -1 || tnum == -1) {
-    fprintf(stderr, "Using: %s --port 20001 --tnum 4\n", argv[0]);
+  if (port == -1 || tnum <= 0) {
+    fprintf(stderr,
+            "Using: %s --port 20001 --tnum 4 [--engine blocking|epoll|uring] "
+            "[--log_level 0-3] [--family any|ipv4|ipv6] [--busy-poll usec]\n",
+            argv[0]);
     return 1;
   }
 
-  // 1. СОЗДАНИЕ IPv6 СЕРВЕРНОГО СОКЕТА
-  int server_fd = socket(AF_INET6, SOCK_STREAM, 0);
-  if (server_fd < 0) {
-    fprintf(stderr, "Can not create server socket: %s\n", strerror(errno));
-    return 1;
-  }
+  // Клиент может закрыть соединение до ответа - это не повод умирать
+  signal(SIGPIPE, SIG_IGN);
+  PgoDumpOnSignal();
 
-  // 2. ОПЦИЯ ДЛЯ БЫСТРОГО ПЕРЕЗАПУСКА СЕРВЕРА
-  int opt_val = 1;
-  if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val)) < 0) {
-    fprintf(stderr, "setsockopt SO_REUSEADDR failed: %s\n", strerror(errno));
-    close(server_fd);
-    return 1;
-  }
-
-  // 3. ОБЯЗАТЕЛЬНО: ТОЛЬКО IPv6, БЕЗ DUAL-STACK
-  int v6only = 1;
-  if (setsockopt(server_fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) < 0) {
-    fprintf(stderr, "setsockopt IPV6_V6ONLY failed: %s\n", strerror(errno));
-    close(server_fd);
-    return 1;
-  }
-
-  // 4. НАСТРОЙКА IPv6 АДРЕСА СЕРВЕРА
-  struct sockaddr_in6 server;
-  memset(&server, 0, sizeof(server));
-  server.sin6_family = AF_INET6;
-  server.sin6_port = htons((uint16_t)port);
-  server.sin6_addr = in6addr_any;  // Слушаем на всех IPv6 интерфейсах (::)
-
-  // 5. ПРИВЯЗКА СОКЕТА К АДРЕСУ
-  if (bind(server_fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
-    fprintf(stderr, "Can not bind to socket: %s\n", strerror(errno));
-    close(server_fd);
-    return 1;
-  }
-
-  // 6. ПЕРЕВОД В РЕЖИМ ПРОСЛУШИВАНИЯ
-  if (listen(server_fd, 128) < 0) {
-    fprintf(stderr, "Could not listen on socket: %s\n", strerror(errno));
-    close(server_fd);
-    return 1;
-  }
+  // 1-6. СЛУШАЮЩИЙ СОКЕТ: по заданию только IPv6 (IPV6_V6ONLY = 1);
+  // --family any дает двухстековый сокет, ipv4 - обычный IPv4
+  char port_str[16];
+  snprintf(port_str, sizeof(port_str), "%d", port);
+  int server_fd = NetListen(NULL, port_str, SOCK_STREAM, family, 128, NET_REUSEADDR);
+  if (server_fd < 0) return 1;
 
   // Выводим информацию о том, на каких адресах слушаем
-  char server_ip[INET6_ADDRSTRLEN];
-  inet_ntop(AF_INET6, &server.sin6_addr, server_ip, sizeof(server_ip));
-  printf("Server listening on [%s]:%d (IPv6 only)\n", server_ip, port);
+  struct sockaddr_storage server;
+  socklen_t server_len = sizeof(server);
+  char server_addr[NET_ADDRSTRLEN];
+  getsockname(server_fd, (struct sockaddr *)&server, &server_len);
+  printf("Server listening on %s (%s)\n",
+         NetFormat((struct sockaddr *)&server, server_addr, sizeof(server_addr)),
+         family == NET_IPV6 ? "IPv6 only" : family == NET_IPV4 ? "IPv4 only" : "dual-stack");
   printf("Threads per request: %d\n", tnum);
+  fflush(stdout);
 
   // 7. ОСНОВНОЙ ЦИКЛ ПРИНЯТИЯ СОЕДИНЕНИЙ
-  while (true) {
-    struct sockaddr_in6 client;
-    socklen_t client_len = sizeof(client);
-    
-    printf("\nWaiting for connections...\n");
-    
-    // 8. ПРИНЯТИЕ НОВОГО СОЕДИНЕНИЯ
-    int client_fd = accept(server_fd, (struct sockaddr *)&client, &client_len);
-    if (client_fd < 0) {
-      fprintf(stderr, "Could not accept new connection: %s\n", strerror(errno));
-      continue;
+  LogStart(log_level);
+  int status = -1;
+  if (strcmp(engine, "uring") == 0) {
+    printf("Engine: uring, log level: %d\n", log_level);
+    fflush(stdout);
+    status = RunUringEngine(server_fd, tnum);
+    // Старое ядро или запрет io_uring - работаем через epoll
+    if (status < 0) {
+      fprintf(stderr, "Falling back to epoll engine\n");
+      engine = "epoll";
     }
-
-    // 9. ОПРЕДЕЛЕНИЕ АДРЕСА КЛИЕНТА
-    char client_ip[INET6_ADDRSTRLEN];
-    inet_ntop(AF_INET6, &client.sin6_addr, client_ip, sizeof(client_ip));
-    printf("New client connected from [%s]:%d\n", 
-           client_ip, ntohs(client.sin6_port));
-
-    // 10. ОБРАБОТКА КЛИЕНТА
-    while (true) {
-      unsigned int buffer_size = sizeof(uint64_t) * 3;
-      char from_client[buffer_size];
-      
-      // 11. ПОЛУЧЕНИЕ ДАННЫХ ОТ КЛИЕНТА
-      int read_bytes = recv(client_fd, from_client, buffer_size, 0);
-
-      if (read_bytes == 0) {
-        printf("Client [%s]:%d disconnected\n", client_ip, ntohs(client.sin6_port));
-        break;
-      }
-      
-      if (read_bytes < 0) {
-        fprintf(stderr, "Client read failed: %s\n", strerror(errno));
-        break;
-      }
-      
-      if ((unsigned int)read_bytes < buffer_size) {
-        fprintf(stderr, "Client sent wrong data format\n");
-        break;
-      }
-
-      // 12. ПАРСИНГ ПАРАМЕТРОВ
-      uint64_t begin = 0, end = 0, mod = 0;
-      memcpy(&begin, from_client, sizeof(uint64_t));
-      memcpy(&end, from_client + sizeof(uint64_t), sizeof(uint64_t));
-      memcpy(&mod, from_client + 2 * sizeof(uint64_t), sizeof(uint64_t));
-
-      printf("Received request from [%s]:%d\n", client_ip, ntohs(client.sin6_port));
-      printf("  Range: %lu to %lu\n", begin, end);
-      printf("  Mod: %lu\n", mod);
-      printf("  Threads to use: %d\n", tnum);
-
-      // 13. РАСПРЕДЕЛЕНИЕ РАБОТЫ ПО ПОТОКАМ
-      pthread_t threads[tnum];
-      struct FactorialArgs args[tnum];
-      
-      uint64_t range = end - begin + 1;
-      uint64_t step = range / tnum;
-      uint64_t remainder = range % tnum;
-      uint64_t current = begin;
-
-      printf("  Dividing work:\n");
-      
-      for (int i = 0; i < tnum; i++) {
-        args[i].begin = current;
-        args[i].end = current + step - 1 + (i < (int)remainder ? 1 : 0);
-        args[i].mod = mod;
-        
-        printf("    Thread %d: %lu - %lu\n", i, args[i].begin, args[i].end);
-        
-        current = args[i].end + 1;
-
-        if (pthread_create(&threads[i], NULL, ThreadFactorial, (void *)&args[i])) {
-          fprintf(stderr, "Error: pthread_create failed!\n");
-          return 1;
-        }
-      }
-
-      // 14. СБОР РЕЗУЛЬТАТОВ ОТ ПОТОКОВ
-      uint64_t total = 1;
-      for (int i = 0; i < tnum; i++) {
-        uint64_t *result = NULL;
-        pthread_join(threads[i], (void **)&result);
-        if (result != NULL) {
-          total = MultModulo(total, *result, mod);
-          free(result);
-        }
-      }
-
-      printf("  Result: %lu\n", total);
-
-      // 15. ОТПРАВКА РЕЗУЛЬТАТА КЛИЕНТУ
-      char buffer[sizeof(total)];
-      memcpy(buffer, &total, sizeof(total));
-      
-      if (send(client_fd, buffer, sizeof(total), 0) < 0) {
-        fprintf(stderr, "Can't send data to client: %s\n", strerror(errno));
-        break;
-      }
-      
-      printf("  Result sent to client\n");
-    }
-
-    // 16. ЗАКРЫТИЕ СОКЕТА КЛИЕНТА
-    if (shutdown(client_fd, SHUT_RDWR) < 0) {
-      fprintf(stderr, "shutdown failed: %s\n", strerror(errno));
-    }
-    
-    close(client_fd);
-    printf("Client socket closed\n");
   }
+  if (strcmp(engine, "blocking") == 0) {
+    printf("Engine: blocking, log level: %d\n", log_level);
+    fflush(stdout);
+    RunBlockingEngine(server_fd, tnum);
+    status = 0;
+  } else if (strcmp(engine, "epoll") == 0) {
+    printf("Engine: epoll, log level: %d\n", log_level);
+    fflush(stdout);
+    status = RunEpollEngine(server_fd, tnum);
+  }
+  LogStop();
 
-  // 17. ЗАКРЫТИЕ СЕРВЕРНОГО СОКЕТА (никогда не выполнится в данном цикле)
+  // 17. ЗАКРЫТИЕ СЕРВЕРНОГО СОКЕТА (циклы выше завершаются только с ошибкой)
   close(server_fd);
-  return 0;
+  return status;
 }
@@ -0,0 +1,234 @@
+#include "server_core.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "common.h"
+#include "logger.h"
+#include "netaddr.h"
+#include "protocol.h"
+
+// Считает begin * ... * end по модулю mod, деля диапазон между tnum потоками
+uint64_t ComputeRange(uint64_t begin, uint64_t end, uint64_t mod, int tnum) {
+  LOG(LOG_DEBUG, "  Range: %lu to %lu, mod %lu\n", begin, end, mod);
+
+  uint64_t range = end - begin + 1;
+  if (range < INLINE_RANGE) {
+    uint64_t total = ProductModulo(begin, end, mod);
+    LOG(LOG_DEBUG, "  Result: %lu (inline)\n", total);
+    return total;
+  }
+
+  // Задания и частичные произведения libcompute держит в арене этого
+  // потока: после первого запроса в malloc здесь больше не ходим
+  uint64_t total = ParallelProductModulo(begin, end, mod, tnum);
+  LOG(LOG_DEBUG, "  Result: %lu\n", total);
+  return total;
+}
+
+// Проверка запроса: 0 - корректен, иначе код ProtoError
+int ValidateRequest(uint64_t begin, uint64_t end, uint64_t mod) {
+  if (mod == 0)
+    return PROTO_ERR_BAD_MOD;
+  if (begin > end)
+    return PROTO_ERR_BAD_RANGE;
+  return 0;
+}
+
+// Соединение и оба его буфера - один объект пула. Соединения создает и
+// закрывает только поток цикла событий, поэтому пул без блокировки
+#define CONN_HEADER ((sizeof(struct Conn) + 63) & ~(size_t)63)
+#define CONNS_PER_SLAB 16
+
+static struct Pool conn_pool;
+static bool conn_pool_ready = false;
+
+struct Conn *ConnCreate(int fd) {
+  if (!conn_pool_ready) {
+    PoolInit(&conn_pool, CONN_HEADER + CONN_IN_SIZE + CONN_OUT_SIZE, CONNS_PER_SLAB);
+    conn_pool_ready = true;
+  }
+  uint8_t *memory = PoolAlloc(&conn_pool);
+  if (memory == NULL)
+    return NULL;
+  struct Conn *conn = (struct Conn *)memory;
+  memset(conn, 0, sizeof(struct Conn));
+  conn->fd = fd;
+  conn->state = CONN_HELLO;
+  conn->in.cap = CONN_IN_SIZE;
+  conn->out.cap = CONN_OUT_SIZE;
+  conn->in.data = memory + CONN_HEADER;
+  conn->out.data = memory + CONN_HEADER + CONN_IN_SIZE;
+  return conn;
+}
+
+int g_busy_poll_us = 0;
+
+void ConnSetup(struct Conn *conn) {
+  // Адрес клиента нужен только для лога - без лога не тратим на него вызов
+  if (g_log_level >= LOG_ERROR) {
+    struct sockaddr_storage client;
+    socklen_t client_len = sizeof(client);
+    memset(&client, 0, sizeof(client));
+    getpeername(conn->fd, (struct sockaddr *)&client, &client_len);
+    NetFormat((struct sockaddr *)&client, conn->peer, sizeof(conn->peer));
+    LOG(LOG_INFO, "New client connected from %s\n", conn->peer);
+  }
+
+  // Ответы короткие - без TCP_NODELAY Nagle задерживает их до ACK;
+  // QUICKACK не дает клиенту ждать отложенного подтверждения первого запроса
+  int flags = NET_NODELAY | NET_QUICKACK;
+  if (g_busy_poll_us > 0) flags |= NET_BUSY_POLL;
+  NetTune(conn->fd, flags, g_busy_poll_us);
+}
+
+void ConnDestroy(struct Conn *conn) {
+  PoolFree(&conn_pool, conn);
+}
+
+// Первые 4 байта решают, какой протокол использует клиент
+static void ProcessHello(struct Conn *conn) {
+  uint8_t hello[PROTO_HELLO_SIZE];
+  uint8_t version = 0;
+  RingPeek(&conn->in, hello, sizeof(hello));
+
+  if (DecodeHello(hello, sizeof(hello), &version) != PROTO_HELLO_SIZE) {
+    // Эти байты - начало первого legacy-запроса, оставляем их в буфере
+    LOG(LOG_INFO, "Client %s: legacy protocol\n", conn->peer);
+    conn->state = CONN_LEGACY;
+    return;
+  }
+
+  if (version > PROTO_VERSION)
+    version = PROTO_VERSION;
+  RingConsume(&conn->in, sizeof(hello));
+  EncodeHello(hello, version);
+  RingWrite(&conn->out, hello, sizeof(hello));
+  LOG(LOG_INFO, "Client %s: protocol version %d\n", conn->peer, version);
+  conn->state = CONN_FRAMED;
+}
+
+// Legacy: 24 байта запроса, 8 байт ответа в порядке байт хоста.
+// В legacy-формате нет кода ошибки - на некорректный запрос отвечаем 0.
+static bool ProcessLegacy(struct Conn *conn, int tnum) {
+  uint8_t scratch[PROTO_LEGACY_REQUEST_SIZE];
+  const uint8_t *p;
+  if (RingUsed(&conn->in) < PROTO_LEGACY_REQUEST_SIZE)
+    return false;
+  if (RingContig(&conn->in, &p) < PROTO_LEGACY_REQUEST_SIZE) {
+    RingPeek(&conn->in, scratch, sizeof(scratch));
+    p = scratch;
+  }
+
+  uint64_t begin = 0, end = 0, mod = 0;
+  memcpy(&begin, p, sizeof(uint64_t));
+  memcpy(&end, p + sizeof(uint64_t), sizeof(uint64_t));
+  memcpy(&mod, p + 2 * sizeof(uint64_t), sizeof(uint64_t));
+  RingConsume(&conn->in, PROTO_LEGACY_REQUEST_SIZE);
+
+  LOG(LOG_DEBUG, "Received legacy request from %s\n", conn->peer);
+  uint64_t total = 0;
+  if (ValidateRequest(begin, end, mod) == 0)
+    total = ComputeRange(begin, end, mod, tnum);
+  RingWrite(&conn->out, &total, sizeof(total));
+  return true;
+}
+
+// Версия 1: кадр разбирается прямо в кольце, и только если он лежит на
+// стыке конца и начала буфера - через короткую копию.
+// Возвращает 1 - кадр обработан, 0 - кадр еще не пришел, -1 - ошибка.
+static int ProcessFrame(struct Conn *conn, int tnum) {
+  uint8_t scratch[PROTO_MAX_FRAME + PROTO_MAX_VARINT];
+  const uint8_t *p;
+  size_t contig = RingContig(&conn->in, &p);
+
+  struct Frame frame;
+  int n = DecodeFrame(p, contig, &frame);
+  if (n == 0 && contig < RingUsed(&conn->in)) {
+    size_t len = RingPeek(&conn->in, scratch, sizeof(scratch));
+    n = DecodeFrame(scratch, len, &frame);
+  }
+  if (n <= 0) {
+    if (n < 0)
+      LOG(LOG_ERROR, "Client %s sent malformed frame\n", conn->peer);
+    return n;
+  }
+  RingConsume(&conn->in, (size_t)n);
+
+  LOG(LOG_DEBUG, "Received request %lu from %s\n", frame.req_id, conn->peer);
+  uint8_t flags = 0;
+  uint64_t value = 0;
+  int error = frame.type == FRAME_REQUEST
+                  ? ValidateRequest(frame.begin, frame.end, frame.mod)
+                  : PROTO_ERR_BAD_TYPE;
+  if (error != 0) {
+    flags = FRAME_FLAG_ERROR;
+    value = (uint64_t)error;
+  } else {
+    value = ComputeRange(frame.begin, frame.end, frame.mod, tnum);
+  }
+
+  uint8_t response[PROTO_MAX_RESPONSE];
+  size_t len = EncodeResponse(response, frame.req_id, flags, value);
+  RingWrite(&conn->out, response, len);
+  return 1;
+}
+
+bool ConnProcess(struct Conn *conn, int tnum) {
+  conn->stalled = false;
+  while (RingUsed(&conn->in) > 0) {
+    if (conn->state == CONN_HELLO) {
+      if (RingUsed(&conn->in) < PROTO_HELLO_SIZE)
+        return true;
+      ProcessHello(conn);
+      continue;
+    }
+
+    // Клиент не забирает ответы - перестаем читать его запросы
+    if (RingFree(&conn->out) < PROTO_MAX_RESPONSE) {
+      conn->stalled = true;
+      return true;
+    }
+
+    if (conn->state == CONN_LEGACY) {
+      if (!ProcessLegacy(conn, tnum))
+        return true;
+    } else {
+      int status = ProcessFrame(conn, tnum);
+      if (status <= 0)
+        return status == 0;
+    }
+  }
+  return true;
+}
+
+ssize_t ConnFill(struct Conn *conn) {
+  struct iovec iov[2];
+  int cnt = RingFreeIov(&conn->in, iov);
+  if (cnt == 0)
+    return 0;
+  ssize_t n = readv(conn->fd, iov, cnt);
+  if (n > 0)
+    RingProduce(&conn->in, (size_t)n);
+  return n;
+}
+
+ssize_t ConnFlush(struct Conn *conn) {
+  struct iovec iov[2];
+  int cnt = RingDataIov(&conn->out, iov);
+  if (cnt == 0)
+    return 0;
+  ssize_t n = writev(conn->fd, iov, cnt);
+  if (n > 0)
+    RingConsume(&conn->out, (size_t)n);
+  return n;
+}
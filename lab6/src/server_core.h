@@ -0,0 +1,58 @@
+#ifndef SERVER_CORE_H
+#define SERVER_CORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "ring.h"
+
+// Размеры буферов соединения (степени двойки)
+#define CONN_IN_SIZE (8 * 1024)
+#define CONN_OUT_SIZE (16 * 1024)
+
+// Диапазоны короче этого считаются в вызывающем потоке: создание потоков
+// стоит дороже самих умножений
+#define INLINE_RANGE 16384
+
+enum ConnState {
+  CONN_HELLO,  /* ждем первые 4 байта, чтобы узнать протокол */
+  CONN_LEGACY, /* 24-байтовые запросы */
+  CONN_FRAMED, /* кадры версии 1 */
+};
+
+struct Conn {
+  int fd;
+  enum ConnState state;
+  bool stalled;    /* разбор остановлен: нет места под ответы */
+  bool eof;        /* клиент закрыл свою сторону соединения */
+  uint32_t events; /* текущая подписка в epoll */
+  struct RingBuf in;
+  struct RingBuf out;
+  char peer[64];
+};
+
+uint64_t ComputeRange(uint64_t begin, uint64_t end, uint64_t mod, int tnum);
+int ValidateRequest(uint64_t begin, uint64_t end, uint64_t mod);
+
+// SO_BUSY_POLL для принятых сокетов, микросекунды; 0 - выключен
+extern int g_busy_poll_us;
+
+struct Conn *ConnCreate(int fd);
+void ConnDestroy(struct Conn *conn);
+
+/* Настройка только что принятого сокета: TCP_NODELAY, TCP_QUICKACK,
+ * SO_BUSY_POLL, адрес для лога. */
+void ConnSetup(struct Conn *conn);
+
+/* Разбирает все целые запросы из conn->in и пишет ответы в conn->out.
+ * false - клиент нарушил протокол, соединение надо закрыть. */
+bool ConnProcess(struct Conn *conn, int tnum);
+
+/* Один readv в свободное место входного кольца (оно не должно быть
+ * заполнено) / один writev всех накопленных ответов. Возвращают результат
+ * системного вызова. */
+ssize_t ConnFill(struct Conn *conn);
+ssize_t ConnFlush(struct Conn *conn);
+
+#endif
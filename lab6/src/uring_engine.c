@@ -0,0 +1,619 @@
+#include "uring_engine.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "server_core.h"
+
+#define URING_ENTRIES 1024
+#define BUF_GROUP 1
+#define BUF_COUNT 512 /* степень двойки */
+#define BUF_SIZE 4096
+#define NO_BUF 0xffff
+// Пауза перед новым accept, когда дескрипторы кончились и запасного нет
+#define ACCEPT_BACKOFF_NS 100000000
+
+// user_data = fd << 8 | тип операции
+enum UringOp {
+  OP_ACCEPT = 1,
+  OP_RECV = 2,
+  OP_SEND = 3,
+  OP_ACCEPT_BACKOFF = 4,
+};
+
+struct Uring {
+  int fd;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned sq_local_tail;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ptr;
+  size_t sq_size;
+  void *cq_ptr;
+  size_t cq_size;
+  size_t sqes_size;
+};
+
+// Кольцо предоставленных буферов: ядро само выбирает буфер под каждый recv
+struct BufRing {
+  struct io_uring_buf_ring *ring;
+  size_t ring_size;
+  uint8_t *data;
+  uint16_t tail;
+  // Буферы, принятые но еще не разобранные, - очередь на соединение
+  uint16_t next[BUF_COUNT];
+  uint16_t len[BUF_COUNT];
+  uint16_t offset[BUF_COUNT];
+};
+
+struct UringConn {
+  struct Conn *conn;
+  bool recv_armed;
+  bool closing;
+  bool needs_rearm;
+  bool starved; /* прием встал на ENOBUFS, ждет возврата буфера */
+  int sends_inflight;
+  uint16_t held_head;
+  uint16_t held_tail;
+};
+
+struct UringServer {
+  struct Uring ring;
+  struct BufRing bufs;
+  int server_fd;
+  int tnum;
+  bool served_any;
+  struct UringConn *conns; /* индекс - дескриптор клиента */
+  int conns_cap;
+  // Соединения без приема из-за ENOBUFS и хвост кольца буферов на момент
+  // последнего ENOBUFS: пока он не сдвинулся, буферов нет и будить рано
+  int starved_count;
+  uint16_t starved_tail;
+  // Запасной дескриптор: когда лимит исчерпан, он освобождается, чтобы
+  // принять и сразу закрыть соединение, иначе accept падает снова и снова
+  int spare_fd;
+  bool accept_paused;
+  struct __kernel_timespec backoff;
+};
+
+static int SysSetup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int SysEnter(int fd, unsigned to_submit, unsigned min_complete,
+                    unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                      NULL, 0);
+}
+
+static int SysRegister(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int UringInit(struct Uring *u) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  // Без лишних IPI: ядро доделывает работу при следующем входе
+  p.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+  u->fd = SysSetup(URING_ENTRIES, &p);
+  if (u->fd < 0 && errno == EINVAL) {
+    memset(&p, 0, sizeof(p));
+    u->fd = SysSetup(URING_ENTRIES, &p);
+  }
+  if (u->fd < 0)
+    return -1;
+  if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+    close(u->fd);
+    errno = ENOSYS;
+    return -1;
+  }
+
+  u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (u->cq_size > u->sq_size)
+    u->sq_size = u->cq_size;
+  u->cq_size = u->sq_size;
+  u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if (u->sq_ptr == MAP_FAILED) {
+    close(u->fd);
+    return -1;
+  }
+  u->cq_ptr = u->sq_ptr;
+
+  u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+  if (u->sqes == MAP_FAILED) {
+    munmap(u->sq_ptr, u->sq_size);
+    close(u->fd);
+    return -1;
+  }
+
+  uint8_t *sq = u->sq_ptr;
+  u->sq_head = (unsigned *)(sq + p.sq_off.head);
+  u->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+  u->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+  u->sq_entries = *(unsigned *)(sq + p.sq_off.ring_entries);
+  u->sq_array = (unsigned *)(sq + p.sq_off.array);
+  u->sq_local_tail = *u->sq_tail;
+
+  uint8_t *cq = u->cq_ptr;
+  u->cq_head = (unsigned *)(cq + p.cq_off.head);
+  u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+  u->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+  return 0;
+}
+
+static void UringFree(struct Uring *u) {
+  munmap(u->sqes, u->sqes_size);
+  munmap(u->sq_ptr, u->sq_size);
+  close(u->fd);
+}
+
+static unsigned UringPending(struct Uring *u) {
+  return u->sq_local_tail - *u->sq_tail;
+}
+
+// Публикует подготовленные SQE и, если нужно, ждет завершений
+static int UringSubmit(struct Uring *u, unsigned wait) {
+  unsigned pending = UringPending(u);
+  __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+  if (pending == 0 && wait == 0)
+    return 0;
+  int ret;
+  do {
+    ret = SysEnter(u->fd, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+  } while (ret < 0 && errno == EINTR);
+  return ret;
+}
+
+static struct io_uring_sqe *UringGetSqe(struct Uring *u) {
+  unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+  if (u->sq_local_tail - head >= u->sq_entries) {
+    // Очередь заполнена - отдаем ядру то, что есть
+    UringSubmit(u, 0);
+    head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    if (u->sq_local_tail - head >= u->sq_entries)
+      return NULL;
+  }
+  unsigned index = u->sq_local_tail & u->sq_mask;
+  struct io_uring_sqe *sqe = &u->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  u->sq_array[index] = index;
+  u->sq_local_tail++;
+  return sqe;
+}
+
+static void BufRecycle(struct BufRing *b, uint16_t bid) {
+  struct io_uring_buf *buf = &b->ring->bufs[b->tail & (BUF_COUNT - 1)];
+  buf->addr = (uint64_t)(uintptr_t)(b->data + (size_t)bid * BUF_SIZE);
+  buf->len = BUF_SIZE;
+  buf->bid = bid;
+  b->tail++;
+  __atomic_store_n(&b->ring->tail, b->tail, __ATOMIC_RELEASE);
+}
+
+static int BufRingInit(struct BufRing *b, int ring_fd) {
+  memset(b, 0, sizeof(*b));
+  b->ring_size = BUF_COUNT * sizeof(struct io_uring_buf);
+  b->ring = mmap(NULL, b->ring_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (b->ring == MAP_FAILED)
+    return -1;
+  b->data = malloc((size_t)BUF_COUNT * BUF_SIZE);
+  if (b->data == NULL) {
+    munmap(b->ring, b->ring_size);
+    return -1;
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)b->ring;
+  reg.ring_entries = BUF_COUNT;
+  reg.bgid = BUF_GROUP;
+  if (SysRegister(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    munmap(b->ring, b->ring_size);
+    free(b->data);
+    return -1;
+  }
+
+  for (uint16_t bid = 0; bid < BUF_COUNT; bid++)
+    BufRecycle(b, bid);
+  return 0;
+}
+
+static void BufRingFree(struct BufRing *b) {
+  munmap(b->ring, b->ring_size);
+  free(b->data);
+}
+
+static uint64_t UserData(int fd, enum UringOp op) {
+  return ((uint64_t)(unsigned)fd << 8) | (uint64_t)op;
+}
+
+static bool ArmAccept(struct UringServer *srv) {
+  struct io_uring_sqe *sqe = UringGetSqe(&srv->ring);
+  if (sqe == NULL)
+    return false;
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = srv->server_fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->user_data = UserData(srv->server_fd, OP_ACCEPT);
+  return true;
+}
+
+// Таймер, по которому EventLoop снова запустит accept
+static bool ArmAcceptBackoff(struct UringServer *srv) {
+  struct io_uring_sqe *sqe = UringGetSqe(&srv->ring);
+  if (sqe == NULL)
+    return false;
+  srv->backoff.tv_sec = 0;
+  srv->backoff.tv_nsec = ACCEPT_BACKOFF_NS;
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = (uint64_t)(uintptr_t)&srv->backoff;
+  sqe->len = 1;
+  sqe->user_data = UserData(srv->server_fd, OP_ACCEPT_BACKOFF);
+  return true;
+}
+
+static bool ArmRecv(struct UringServer *srv, int fd) {
+  struct io_uring_sqe *sqe = UringGetSqe(&srv->ring);
+  if (sqe == NULL)
+    return false;
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUF_GROUP;
+  sqe->user_data = UserData(fd, OP_RECV);
+  srv->conns[fd].recv_armed = true;
+  srv->conns[fd].needs_rearm = false;
+  return true;
+}
+
+// Все накопленные ответы уходят цепочкой send'ов: если данные в кольце
+// переходят через конец, второй send связан с первым и выполнится строго
+// после него
+static void SubmitSends(struct UringServer *srv, struct UringConn *uc) {
+  struct Conn *conn = uc->conn;
+  if (uc->sends_inflight > 0 || uc->closing)
+    return;
+  struct iovec iov[2];
+  int cnt = RingDataIov(&conn->out, iov);
+  for (int i = 0; i < cnt; i++) {
+    struct io_uring_sqe *sqe = UringGetSqe(&srv->ring);
+    if (sqe == NULL)
+      break;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov[i].iov_base;
+    sqe->len = (uint32_t)iov[i].iov_len;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    if (i + 1 < cnt)
+      sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = UserData(conn->fd, OP_SEND);
+    uc->sends_inflight++;
+  }
+}
+
+static void ReleaseHeld(struct UringServer *srv, struct UringConn *uc) {
+  while (uc->held_head != NO_BUF) {
+    uint16_t bid = uc->held_head;
+    uc->held_head = srv->bufs.next[bid];
+    BufRecycle(&srv->bufs, bid);
+  }
+  uc->held_tail = NO_BUF;
+}
+
+// Соединение освобождается, только когда по нему не осталось операций.
+// Повторный вызов (StartClose изнутри обработчика CQE) ничего не делает
+static void MaybeFinishClose(struct UringServer *srv, struct UringConn *uc) {
+  if (uc->conn == NULL || !uc->closing || uc->recv_armed ||
+      uc->sends_inflight > 0)
+    return;
+  struct Conn *conn = uc->conn;
+  LOG(LOG_INFO, "Client %s disconnected\n", conn->peer);
+  if (uc->starved) {
+    uc->starved = false;
+    srv->starved_count--;
+  }
+  ReleaseHeld(srv, uc);
+  close(conn->fd);
+  ConnDestroy(conn);
+  uc->conn = NULL;
+}
+
+static void StartClose(struct UringServer *srv, struct UringConn *uc) {
+  if (uc->closing)
+    return;
+  uc->closing = true;
+  // shutdown завершит висящий multishot recv, дальше закрытие - по CQE
+  shutdown(uc->conn->fd, SHUT_RDWR);
+  MaybeFinishClose(srv, uc);
+}
+
+// Переносит принятые буферы во входное кольцо соединения и разбирает
+// запросы; буфер возвращается ядру, как только из него все скопировано
+static void DrainHeld(struct UringServer *srv, struct UringConn *uc) {
+  struct Conn *conn = uc->conn;
+  struct BufRing *b = &srv->bufs;
+
+  while (!uc->closing) {
+    if (!ConnProcess(conn, srv->tnum)) {
+      StartClose(srv, uc);
+      return;
+    }
+    if (uc->held_head == NO_BUF || conn->stalled)
+      break;
+
+    uint16_t bid = uc->held_head;
+    size_t left = b->len[bid] - b->offset[bid];
+    size_t n = left < RingFree(&conn->in) ? left : RingFree(&conn->in);
+    if (n == 0)
+      break;
+    RingWrite(&conn->in, b->data + (size_t)bid * BUF_SIZE + b->offset[bid], n);
+    b->offset[bid] += (uint16_t)n;
+    if (b->offset[bid] == b->len[bid]) {
+      uc->held_head = b->next[bid];
+      if (uc->held_head == NO_BUF)
+        uc->held_tail = NO_BUF;
+      BufRecycle(b, bid);
+    }
+  }
+
+  SubmitSends(srv, uc);
+  if (uc->needs_rearm && uc->held_head == NO_BUF && !uc->closing &&
+      !conn->eof)
+    ArmRecv(srv, conn->fd);
+  if (conn->eof && uc->held_head == NO_BUF && RingUsed(&conn->out) == 0)
+    StartClose(srv, uc);
+}
+
+static bool GrowConns(struct UringServer *srv, int fd) {
+  if (fd < srv->conns_cap)
+    return true;
+  int cap = srv->conns_cap ? srv->conns_cap : 1024;
+  while (cap <= fd)
+    cap *= 2;
+  struct UringConn *conns =
+      realloc(srv->conns, (size_t)cap * sizeof(struct UringConn));
+  if (conns == NULL)
+    return false;
+  srv->conns = conns;
+  memset(srv->conns + srv->conns_cap, 0,
+         (size_t)(cap - srv->conns_cap) * sizeof(struct UringConn));
+  srv->conns_cap = cap;
+  return true;
+}
+
+static int HandleAccept(struct UringServer *srv, struct io_uring_cqe *cqe) {
+  bool more = cqe->flags & IORING_CQE_F_MORE;
+  if (cqe->res < 0) {
+    // Ядро без multishot accept: пока никого не обслужили, можно отступить
+    if (cqe->res == -EINVAL && !srv->served_any)
+      return -1;
+    if (cqe->res == -EMFILE || cqe->res == -ENFILE) {
+      // accept в io_uring падает на лимите, даже когда очередь пуста;
+      // ожидающего клиента принимаем на запасной дескриптор и закрываем
+      bool dropped = false;
+      if (srv->spare_fd >= 0) {
+        close(srv->spare_fd);
+        struct pollfd pfd = {.fd = srv->server_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 0) > 0) {
+          close(accept(srv->server_fd, NULL, NULL));
+          dropped = true;
+        }
+        srv->spare_fd = open("/dev/null", O_RDONLY);
+      }
+      if (dropped) {
+        LOG(LOG_ERROR, "Out of descriptors, dropping a client\n");
+      } else {
+        // Сразу перезапущенный accept упадет так же - ждем, пока
+        // соединения закроются
+        if (!srv->accept_paused)
+          LOG(LOG_ERROR, "Out of descriptors, pausing accept\n");
+        srv->accept_paused = true;
+        if (!more)
+          ArmAcceptBackoff(srv);
+        return 0;
+      }
+    } else {
+      LOG(LOG_ERROR, "Could not accept new connection: %s\n",
+          strerror(-cqe->res));
+    }
+    if (!more)
+      ArmAccept(srv);
+    return 0;
+  }
+  if (!more)
+    ArmAccept(srv);
+  srv->accept_paused = false;
+
+  int fd = cqe->res;
+  struct Conn *conn = GrowConns(srv, fd) ? ConnCreate(fd) : NULL;
+  if (conn == NULL) {
+    LOG(LOG_ERROR, "Out of memory for connection\n");
+    close(fd);
+    return 0;
+  }
+  srv->served_any = true;
+  ConnSetup(conn);
+  struct UringConn *uc = &srv->conns[fd];
+  memset(uc, 0, sizeof(*uc));
+  uc->conn = conn;
+  uc->held_head = uc->held_tail = NO_BUF;
+  ArmRecv(srv, fd);
+  return 0;
+}
+
+static void HandleRecv(struct UringServer *srv, struct UringConn *uc,
+                       struct io_uring_cqe *cqe) {
+  bool more = cqe->flags & IORING_CQE_F_MORE;
+  if (!more)
+    uc->recv_armed = false;
+
+  if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    struct BufRing *b = &srv->bufs;
+    if (uc->closing) {
+      BufRecycle(b, bid);
+    } else {
+      b->len[bid] = (uint16_t)cqe->res;
+      b->offset[bid] = 0;
+      b->next[bid] = NO_BUF;
+      if (uc->held_tail == NO_BUF)
+        uc->held_head = bid;
+      else
+        b->next[uc->held_tail] = bid;
+      uc->held_tail = bid;
+    }
+    // Multishot recv кончился сам (например, при переполнении CQ)
+    if (!more)
+      uc->needs_rearm = true;
+  } else if (cqe->res == -ENOBUFS) {
+    // Все буферы заняты: сразу перезапущенный прием упадет снова, поэтому
+    // соединение ждет, пока какой-нибудь буфер вернется в кольцо
+    if (!uc->starved) {
+      uc->starved = true;
+      srv->starved_count++;
+    }
+    srv->starved_tail = srv->bufs.tail;
+  } else if (cqe->res == 0) {
+    uc->conn->eof = true;
+  } else if (!uc->closing) {
+    LOG(LOG_ERROR, "Client read failed: %s\n", strerror(-cqe->res));
+    StartClose(srv, uc);
+  }
+
+  if (uc->closing)
+    MaybeFinishClose(srv, uc);
+  else
+    DrainHeld(srv, uc);
+}
+
+static void HandleSend(struct UringServer *srv, struct UringConn *uc,
+                       struct io_uring_cqe *cqe) {
+  uc->sends_inflight--;
+  if (cqe->res > 0) {
+    RingConsume(&uc->conn->out, (size_t)cqe->res);
+  } else if (cqe->res < 0 && cqe->res != -ECANCELED && !uc->closing) {
+    LOG(LOG_ERROR, "Can't send data to client: %s\n", strerror(-cqe->res));
+    StartClose(srv, uc);
+  }
+
+  if (uc->closing) {
+    MaybeFinishClose(srv, uc);
+    return;
+  }
+  // Цепочка завершилась: досылаем остаток и разбираем то, что ждало места
+  if (uc->sends_inflight == 0)
+    DrainHeld(srv, uc);
+}
+
+// В кольцо вернулись буферы - перезапускаем прием у ждавших их соединений
+static void WakeStarved(struct UringServer *srv) {
+  for (int fd = 0; fd < srv->conns_cap && srv->starved_count > 0; fd++) {
+    struct UringConn *uc = &srv->conns[fd];
+    if (!uc->starved)
+      continue;
+    uc->starved = false;
+    srv->starved_count--;
+    if (uc->closing || uc->conn->eof || uc->recv_armed)
+      continue;
+    uc->needs_rearm = true;
+    if (uc->held_head == NO_BUF)
+      ArmRecv(srv, fd);
+  }
+}
+
+static int EventLoop(struct UringServer *srv) {
+  struct Uring *u = &srv->ring;
+  while (true) {
+    if (UringSubmit(u, 1) < 0) {
+      fprintf(stderr, "io_uring_enter failed: %s\n", strerror(errno));
+      return 1;
+    }
+
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+      int fd = (int)(cqe->user_data >> 8);
+      enum UringOp op = (enum UringOp)(cqe->user_data & 0xff);
+
+      if (op == OP_ACCEPT) {
+        if (HandleAccept(srv, cqe) < 0)
+          return -1;
+        continue;
+      }
+      if (op == OP_ACCEPT_BACKOFF) {
+        ArmAccept(srv);
+        continue;
+      }
+      if (fd >= srv->conns_cap || srv->conns[fd].conn == NULL)
+        continue;
+      if (op == OP_RECV)
+        HandleRecv(srv, &srv->conns[fd], cqe);
+      else if (op == OP_SEND)
+        HandleSend(srv, &srv->conns[fd], cqe);
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    if (srv->starved_count > 0 && srv->bufs.tail != srv->starved_tail)
+      WakeStarved(srv);
+  }
+}
+
+int RunUringEngine(int server_fd, int tnum) {
+  struct UringServer *srv = calloc(1, sizeof(struct UringServer));
+  if (srv == NULL)
+    return -1;
+  srv->server_fd = server_fd;
+  srv->tnum = tnum;
+
+  if (UringInit(&srv->ring) < 0) {
+    fprintf(stderr, "io_uring is unavailable: %s\n", strerror(errno));
+    free(srv);
+    return -1;
+  }
+  if (BufRingInit(&srv->bufs, srv->ring.fd) < 0) {
+    fprintf(stderr, "io_uring provided buffer rings are unavailable: %s\n",
+            strerror(errno));
+    UringFree(&srv->ring);
+    free(srv);
+    return -1;
+  }
+
+  srv->spare_fd = open("/dev/null", O_RDONLY);
+  ArmAccept(srv);
+  int status = EventLoop(srv);
+
+  // Сюда попадаем только при ошибке: соединения закрываются вместе с процессом
+  BufRingFree(&srv->bufs);
+  UringFree(&srv->ring);
+  free(srv->conns);
+  if (srv->spare_fd >= 0)
+    close(srv->spare_fd);
+  free(srv);
+  return status;
+}
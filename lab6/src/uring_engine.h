@@ -0,0 +1,17 @@
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+/*
+ * Сетевой цикл сервера на io_uring: multishot accept, multishot recv из
+ * кольца предоставленных буферов и связанные (IOSQE_IO_LINK) send'ы
+ * ответов. В установившемся режиме один io_uring_enter обслуживает
+ * сразу все соединения.
+ *
+ * Возвращает -1, если io_uring в этой системе недоступен (ядро старше
+ * 6.0, запрет seccomp и т.п.) и ни одно соединение еще не принято -
+ * тогда вызывающий переходит на другой движок. Иначе работает до ошибки
+ * и возвращает код завершения.
+ */
+int RunUringEngine(int server_fd, int tnum);
+
+#endif
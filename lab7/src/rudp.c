@@ -0,0 +1,627 @@
+#define _GNU_SOURCE
+
+#include "rudp.h"
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RUDP_DATA 1
+#define RUDP_FIN 2
+#define RUDP_ACK 3
+// Запрос подтверждения, когда окно получателя закрыто
+#define RUDP_PROBE 4
+
+#define SACK_WORDS (RUDP_WINDOW / 64)
+// Столько подтвержденных пакетов поверх дыры - и она считается потерей
+#define DUPTHRESH 3
+#define MIN_RTO_NS 30000000ull
+#define MAX_RTO_NS 10000000000ull
+#define INITIAL_RTO_NS 1000000000ull
+// Сколько RTO подряд без ответа, прежде чем сдаться
+#define MAX_TIMEOUTS 12
+// Столько тишины получатель ждет после FIN, отвечая на его повторы
+#define LINGER_NS 500000000ull
+// Столько тишины от пира получатель терпит посреди потока: живой
+// отправитель за это время успел бы повторить пакет даже при MAX_RTO_NS
+#define IDLE_TIMEOUT_NS (3 * MAX_RTO_NS)
+
+struct DataHeader {
+  uint8_t type;
+  uint8_t pad[3];
+  uint32_t seq;
+};
+
+struct AckHeader {
+  uint8_t type;
+  uint8_t pad[3];
+  uint32_t ack;
+  uint32_t window;
+  uint32_t pad2;
+  uint64_t sack[SACK_WORDS];
+};
+
+struct SendSlot {
+  uint64_t sent_ns;
+  uint32_t len;
+  uint8_t fin;
+  uint8_t sacked;
+  uint8_t lost;
+  uint8_t retransmitted;
+  char data[RUDP_MSS];
+};
+
+struct RecvSlot {
+  uint32_t len;
+  uint8_t present;
+  uint8_t fin;
+  char data[RUDP_MSS];
+};
+
+// Пакет, задержанный имитатором сети; очередь - двоичная куча по due_ns
+struct Delayed {
+  uint64_t due_ns;
+  size_t len;
+  char data[sizeof(struct AckHeader) > sizeof(struct DataHeader) + RUDP_MSS
+                ? sizeof(struct AckHeader)
+                : sizeof(struct DataHeader) + RUDP_MSS];
+};
+
+struct RudpConn {
+  int fd;
+  bool have_peer;
+  struct NetAddr peer;
+  struct RudpShim shim;
+  uint64_t rng;
+  struct Delayed *delayed;
+  size_t delayed_count, delayed_cap;
+
+  // Отправка: [snd_una, snd_nxt) в полете, [snd_nxt, snd_tail) ждут окна
+  struct SendSlot *snd;
+  uint64_t snd_una, snd_nxt, snd_tail;
+  uint64_t sacked_count, lost_count, lost_hint;
+  uint64_t sacked_high, sacked_high_sent_ns;
+  uint64_t peer_window;
+  double cwnd, ssthresh;
+  uint64_t recovery_point;
+  bool in_recovery;
+  uint64_t srtt_ns, rttvar_ns, rto_ns;
+  uint64_t rto_deadline;
+  int timeouts_in_row;
+  bool fin_queued;
+
+  // Прием: [rcv_read, rcv_nxt) получены подряд, дальше - вразброс
+  struct RecvSlot *rcv;
+  uint64_t rcv_read, rcv_nxt;
+  uint32_t rcv_offset;
+  bool ack_pending;
+  int unacked_packets;
+  uint64_t advertised;
+  bool fin_received;
+  uint64_t last_packet_ns;
+
+  bool error;
+  struct RudpStats stats;
+};
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static double Random01(struct RudpConn *c) {
+  // xorshift64*: имитатору не нужна криптостойкость
+  c->rng ^= c->rng >> 12;
+  c->rng ^= c->rng << 25;
+  c->rng ^= c->rng >> 27;
+  return (double)((c->rng * 2685821657736338717ull) >> 11) / (double)(1ull << 53);
+}
+
+// Номер на проводе 32-битный; полный восстанавливается как ближайший к base
+static uint64_t Unwrap(uint64_t base, uint32_t wire) {
+  return base + (int64_t)(int32_t)(wire - (uint32_t)base);
+}
+
+static void RawSend(struct RudpConn *c, const void *buf, size_t len) {
+  if (sendto(c->fd, buf, len, 0, (struct sockaddr *)&c->peer.ss, c->peer.len) < 0 &&
+      errno != EAGAIN && errno != ECONNREFUSED && errno != ENOBUFS)
+    c->error = true;
+}
+
+static void DelayedPush(struct RudpConn *c, uint64_t due, const void *buf, size_t len) {
+  if (c->delayed_count == c->delayed_cap) {
+    size_t cap = c->delayed_cap ? c->delayed_cap * 2 : 256;
+    struct Delayed *grown = realloc(c->delayed, cap * sizeof(struct Delayed));
+    if (grown == NULL) return;  // пакет считаем потерянным сетью
+    c->delayed = grown;
+    c->delayed_cap = cap;
+  }
+  size_t i = c->delayed_count++;
+  while (i > 0 && c->delayed[(i - 1) / 2].due_ns > due) {
+    c->delayed[i] = c->delayed[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  c->delayed[i].due_ns = due;
+  c->delayed[i].len = len;
+  memcpy(c->delayed[i].data, buf, len);
+}
+
+static void DelayedFlush(struct RudpConn *c, uint64_t now) {
+  while (c->delayed_count > 0 && c->delayed[0].due_ns <= now) {
+    RawSend(c, c->delayed[0].data, c->delayed[0].len);
+    struct Delayed last = c->delayed[--c->delayed_count];
+    size_t i = 0;
+    while (1) {
+      size_t child = 2 * i + 1;
+      if (child >= c->delayed_count) break;
+      if (child + 1 < c->delayed_count &&
+          c->delayed[child + 1].due_ns < c->delayed[child].due_ns)
+        child++;
+      if (c->delayed[child].due_ns >= last.due_ns) break;
+      c->delayed[i] = c->delayed[child];
+      i = child;
+    }
+    if (c->delayed_count > 0) c->delayed[i] = last;
+  }
+}
+
+// Все исходящие пакеты проходят через имитатор, если он включен
+static void SendPacket(struct RudpConn *c, const void *buf, size_t len) {
+  if (c->shim.loss > 0 && Random01(c) < c->shim.loss) {
+    c->stats.shim_dropped++;
+    return;
+  }
+  if (c->shim.delay_ms > 0 || c->shim.jitter_ms > 0) {
+    uint64_t delay = (uint64_t)c->shim.delay_ms * 1000000ull +
+                     (uint64_t)(Random01(c) * c->shim.jitter_ms * 1000000.0);
+    DelayedPush(c, NowNs() + delay, buf, len);
+    return;
+  }
+  RawSend(c, buf, len);
+}
+
+static void SendAck(struct RudpConn *c) {
+  struct AckHeader ack;
+  memset(&ack, 0, sizeof(ack));
+  ack.type = RUDP_ACK;
+  ack.ack = htonl((uint32_t)c->rcv_nxt);
+  c->advertised = RUDP_WINDOW - (c->rcv_nxt - c->rcv_read);
+  ack.window = htonl((uint32_t)c->advertised);
+  // Бит i - получен пакет rcv_nxt + 1 + i
+  for (uint64_t seq = c->rcv_nxt + 1; seq < c->rcv_read + RUDP_WINDOW; seq++) {
+    if (c->rcv[seq % RUDP_WINDOW].present) {
+      uint64_t bit = seq - c->rcv_nxt - 1;
+      ack.sack[bit / 64] |= 1ull << (bit % 64);
+    }
+  }
+  for (int i = 0; i < SACK_WORDS; i++) ack.sack[i] = htobe64(ack.sack[i]);
+  SendPacket(c, &ack, sizeof(ack));
+  c->stats.acks_sent++;
+  c->ack_pending = false;
+  c->unacked_packets = 0;
+}
+
+static void TransmitSlot(struct RudpConn *c, uint64_t seq, uint64_t now) {
+  struct SendSlot *slot = &c->snd[seq % RUDP_WINDOW];
+  char packet[sizeof(struct DataHeader) + RUDP_MSS];
+  struct DataHeader header = {.type = slot->fin ? RUDP_FIN : RUDP_DATA,
+                              .seq = htonl((uint32_t)seq)};
+  memcpy(packet, &header, sizeof(header));
+  memcpy(packet + sizeof(header), slot->data, slot->len);
+  SendPacket(c, packet, sizeof(header) + slot->len);
+  slot->sent_ns = now;
+  c->stats.packets_sent++;
+  if (c->rto_deadline == 0) c->rto_deadline = now + c->rto_ns;
+}
+
+// Сначала повторы потерянных, затем новые пакеты - пока пакетов в сети
+// меньше окна перегрузки и новые помещаются в окно получателя
+static void TrySend(struct RudpConn *c) {
+  uint64_t now = NowNs();
+  while (1) {
+    uint64_t pipe = (c->snd_nxt - c->snd_una) - c->sacked_count - c->lost_count;
+    if ((double)pipe >= c->cwnd) break;
+
+    if (c->lost_count > 0) {
+      uint64_t seq = c->lost_hint > c->snd_una ? c->lost_hint : c->snd_una;
+      while (!c->snd[seq % RUDP_WINDOW].lost) seq++;
+      struct SendSlot *slot = &c->snd[seq % RUDP_WINDOW];
+      slot->lost = 0;
+      slot->retransmitted = 1;
+      c->lost_count--;
+      c->lost_hint = seq + 1;
+      c->stats.retransmits++;
+      TransmitSlot(c, seq, now);
+      continue;
+    }
+
+    if (c->snd_nxt == c->snd_tail) break;
+    if (c->snd_nxt - c->snd_una >= c->peer_window) break;
+    struct SendSlot *slot = &c->snd[c->snd_nxt % RUDP_WINDOW];
+    slot->sacked = slot->lost = slot->retransmitted = 0;
+    TransmitSlot(c, c->snd_nxt, now);
+    c->snd_nxt++;
+  }
+}
+
+static void MarkLost(struct RudpConn *c, uint64_t seq) {
+  struct SendSlot *slot = &c->snd[seq % RUDP_WINDOW];
+  if (slot->lost || slot->sacked) return;
+  slot->lost = 1;
+  c->lost_count++;
+  if (seq < c->lost_hint || c->lost_count == 1) c->lost_hint = seq;
+}
+
+static void EnterRecovery(struct RudpConn *c) {
+  if (c->in_recovery) return;
+  c->in_recovery = true;
+  c->recovery_point = c->snd_nxt;
+  c->ssthresh = c->cwnd / 2 > 2 ? c->cwnd / 2 : 2;
+  c->cwnd = c->ssthresh;
+}
+
+static void SampleRtt(struct RudpConn *c, uint64_t rtt) {
+  if (c->srtt_ns == 0) {
+    c->srtt_ns = rtt;
+    c->rttvar_ns = rtt / 2;
+  } else {
+    uint64_t delta = rtt > c->srtt_ns ? rtt - c->srtt_ns : c->srtt_ns - rtt;
+    c->rttvar_ns = (3 * c->rttvar_ns + delta) / 4;
+    c->srtt_ns = (7 * c->srtt_ns + rtt) / 8;
+  }
+  c->rto_ns = c->srtt_ns + 4 * c->rttvar_ns;
+  if (c->rto_ns < MIN_RTO_NS) c->rto_ns = MIN_RTO_NS;
+  if (c->rto_ns > MAX_RTO_NS) c->rto_ns = MAX_RTO_NS;
+}
+
+static void GrowWindow(struct RudpConn *c, uint64_t acked) {
+  if (c->in_recovery) return;
+  for (uint64_t i = 0; i < acked; i++)
+    c->cwnd += c->cwnd < c->ssthresh ? 1.0 : 1.0 / c->cwnd;
+  if (c->cwnd > RUDP_WINDOW) c->cwnd = RUDP_WINDOW;
+}
+
+static void HandleAck(struct RudpConn *c, const struct AckHeader *ack, uint64_t now) {
+  c->stats.acks_received++;
+  uint64_t cum = Unwrap(c->snd_una, ntohl(ack->ack));
+  if (cum < c->snd_una || cum > c->snd_nxt) return;  // устаревшее или чужое
+  c->peer_window = ntohl(ack->window);
+
+  uint64_t newly = 0;
+  uint64_t rtt_sample = 0;
+  while (c->snd_una < cum) {
+    struct SendSlot *slot = &c->snd[c->snd_una % RUDP_WINDOW];
+    if (slot->sacked) {
+      c->sacked_count--;
+    } else {
+      // Правило Карна: по повторно отправленным RTT не измеряем
+      if (!slot->retransmitted) rtt_sample = now - slot->sent_ns;
+      newly++;
+    }
+    if (slot->lost) c->lost_count--;
+    c->snd_una++;
+  }
+
+  if (c->sacked_high < c->snd_una) {
+    c->sacked_high = 0;
+    c->sacked_high_sent_ns = 0;
+  }
+  for (int w = 0; w < SACK_WORDS; w++) {
+    uint64_t bits = be64toh(ack->sack[w]);
+    while (bits != 0) {
+      int b = __builtin_ctzll(bits);
+      bits &= bits - 1;
+      uint64_t seq = cum + 1 + (uint64_t)w * 64 + b;
+      if (seq >= c->snd_nxt) break;
+      struct SendSlot *slot = &c->snd[seq % RUDP_WINDOW];
+      if (slot->sacked) continue;
+      slot->sacked = 1;
+      c->sacked_count++;
+      if (slot->lost) {
+        slot->lost = 0;
+        c->lost_count--;
+      }
+      if (!slot->retransmitted) rtt_sample = now - slot->sent_ns;
+      if (seq > c->sacked_high) c->sacked_high = seq;
+      if (slot->sent_ns > c->sacked_high_sent_ns) c->sacked_high_sent_ns = slot->sent_ns;
+      newly++;
+    }
+  }
+
+  if (rtt_sample > 0) SampleRtt(c, rtt_sample);
+  if (c->in_recovery && c->snd_una >= c->recovery_point) c->in_recovery = false;
+  GrowWindow(c, newly);
+
+  // Дыра, поверх которой подтверждено DUPTHRESH пакетов и хотя бы один
+  // отправлен позже нее, - потеря (так находится и потеря повтора)
+  if (c->sacked_high >= c->snd_una + DUPTHRESH) {
+    for (uint64_t seq = c->snd_una; seq + DUPTHRESH <= c->sacked_high; seq++) {
+      struct SendSlot *slot = &c->snd[seq % RUDP_WINDOW];
+      if (slot->sacked || slot->lost || slot->sent_ns >= c->sacked_high_sent_ns)
+        continue;
+      MarkLost(c, seq);
+      c->stats.fast_retransmits++;
+      EnterRecovery(c);
+    }
+  }
+
+  if (newly > 0) {
+    c->timeouts_in_row = 0;
+    c->rto_deadline = c->snd_una < c->snd_nxt ? now + c->rto_ns : 0;
+  }
+}
+
+static void HandleData(struct RudpConn *c, uint8_t type, uint32_t wire_seq,
+                       const char *payload, size_t len) {
+  uint64_t seq = Unwrap(c->rcv_nxt, wire_seq);
+  c->ack_pending = true;
+  if (len > RUDP_MSS) return;
+  if (seq < c->rcv_nxt || seq >= c->rcv_read + RUDP_WINDOW) {
+    c->stats.duplicates++;
+    return;
+  }
+  struct RecvSlot *slot = &c->rcv[seq % RUDP_WINDOW];
+  if (slot->present) {
+    c->stats.duplicates++;
+    return;
+  }
+  slot->present = 1;
+  slot->fin = type == RUDP_FIN;
+  slot->len = (uint32_t)len;
+  memcpy(slot->data, payload, len);
+  uint64_t was_nxt = c->rcv_nxt;
+  while (c->rcv_nxt < c->rcv_read + RUDP_WINDOW && c->rcv[c->rcv_nxt % RUDP_WINDOW].present)
+    c->rcv_nxt++;
+
+  // Как в TCP: подтверждение на каждый второй пакет и сразу - когда
+  // дыра появилась или закрылась и на FIN. Одно подтверждение на всю
+  // пачку при малом окне теряется целиком, и отправитель ждет RTO
+  if (++c->unacked_packets >= 2 || seq >= c->rcv_nxt || c->rcv_nxt > was_nxt + 1 ||
+      type == RUDP_FIN)
+    SendAck(c);
+}
+
+static void HandlePacket(struct RudpConn *c, const char *buf, size_t len, uint64_t now) {
+  if (len < sizeof(struct DataHeader)) return;
+  uint8_t type = (uint8_t)buf[0];
+  c->last_packet_ns = now;
+  if (type == RUDP_ACK) {
+    if (len < sizeof(struct AckHeader)) return;
+    struct AckHeader ack;
+    memcpy(&ack, buf, sizeof(ack));
+    HandleAck(c, &ack, now);
+  } else if (type == RUDP_DATA || type == RUDP_FIN) {
+    struct DataHeader header;
+    memcpy(&header, buf, sizeof(header));
+    HandleData(c, type, ntohl(header.seq), buf + sizeof(header), len - sizeof(header));
+  } else if (type == RUDP_PROBE) {
+    c->ack_pending = true;
+  }
+}
+
+// Таймаут: все неподтвержденные считаются потерянными, окно - в один
+// пакет и снова медленный старт, RTO удваивается
+static void OnTimeout(struct RudpConn *c, uint64_t now) {
+  c->stats.timeouts++;
+  c->timeouts_in_row++;
+  c->ssthresh = c->cwnd / 2 > 2 ? c->cwnd / 2 : 2;
+  c->cwnd = 1;
+  c->in_recovery = false;
+  for (uint64_t seq = c->snd_una; seq < c->snd_nxt; seq++) {
+    struct SendSlot *slot = &c->snd[seq % RUDP_WINDOW];
+    if (!slot->sacked && !slot->lost) MarkLost(c, seq);
+  }
+  c->rto_ns = c->rto_ns * 2 < MAX_RTO_NS ? c->rto_ns * 2 : MAX_RTO_NS;
+  c->rto_deadline = now + c->rto_ns;
+}
+
+// Один шаг цикла событий: ожидание не дольше timeout_ms (-1 - до
+// ближайшего таймера), прием всего, что пришло, таймеры, отправка
+static void Pump(struct RudpConn *c, int timeout_ms) {
+  uint64_t now = NowNs();
+  int64_t wait_ns = timeout_ms < 0 ? -1 : (int64_t)timeout_ms * 1000000;
+  uint64_t timers[2] = {c->rto_deadline, c->delayed_count > 0 ? c->delayed[0].due_ns : 0};
+  // Окно получателя закрыто, а в полете ничего: иначе об открытии не узнать
+  if (c->snd_nxt < c->snd_tail && c->snd_una == c->snd_nxt && c->peer_window == 0)
+    timers[0] = now + c->rto_ns;
+  for (int i = 0; i < 2; i++) {
+    if (timers[i] == 0) continue;
+    int64_t left = timers[i] > now ? (int64_t)(timers[i] - now) : 0;
+    if (wait_ns < 0 || left < wait_ns) wait_ns = left;
+  }
+  struct pollfd pfd = {.fd = c->fd, .events = POLLIN};
+  int wait_ms = wait_ns < 0 ? -1 : (int)((wait_ns + 999999) / 1000000);
+  if (poll(&pfd, 1, wait_ms) < 0 && errno != EINTR) {
+    c->error = true;
+    return;
+  }
+
+  char buf[sizeof(struct Delayed)];
+  now = NowNs();
+  while (1) {
+    struct sockaddr_storage from;
+    socklen_t fromlen = sizeof(from);
+    ssize_t n = recvfrom(c->fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromlen);
+    if (n < 0) {
+      if (errno == EINTR || errno == ECONNREFUSED) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) c->error = true;
+      break;
+    }
+    if (!c->have_peer) {
+      // Пир - отправитель первого пакета данных из начала потока (пакет 0
+      // мог потеряться); подтверждения и прочее до этого игнорируем
+      struct DataHeader header;
+      if ((size_t)n < sizeof(header)) continue;
+      memcpy(&header, buf, sizeof(header));
+      if ((header.type != RUDP_DATA && header.type != RUDP_FIN) ||
+          ntohl(header.seq) >= RUDP_WINDOW)
+        continue;
+      c->peer.ss = from;
+      c->peer.len = fromlen;
+      c->have_peer = true;
+    } else if (!NetSameAddr((struct sockaddr *)&from, (struct sockaddr *)&c->peer.ss)) {
+      continue;
+    }
+    HandlePacket(c, buf, n, now);
+  }
+  if (c->ack_pending) SendAck(c);
+
+  if (c->rto_deadline != 0 && now >= c->rto_deadline && c->snd_una < c->snd_nxt)
+    OnTimeout(c, now);
+  if (c->snd_nxt < c->snd_tail && c->snd_una == c->snd_nxt && c->peer_window == 0 &&
+      now - c->last_packet_ns >= c->rto_ns) {
+    struct DataHeader probe = {.type = RUDP_PROBE};
+    SendPacket(c, &probe, sizeof(probe));
+    c->last_packet_ns = now;
+  }
+  DelayedFlush(c, now);
+  TrySend(c);
+}
+
+struct RudpConn *RudpOpen(int fd, const struct NetAddr *peer,
+                          const struct RudpShim *shim) {
+  struct RudpConn *c = calloc(1, sizeof(struct RudpConn));
+  if (c == NULL) return NULL;
+  c->snd = malloc(RUDP_WINDOW * sizeof(struct SendSlot));
+  c->rcv = calloc(RUDP_WINDOW, sizeof(struct RecvSlot));
+  if (c->snd == NULL || c->rcv == NULL) {
+    RudpFree(c);
+    return NULL;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  c->fd = fd;
+  if (peer != NULL) {
+    c->peer = *peer;
+    c->have_peer = true;
+  }
+  if (shim != NULL) c->shim = *shim;
+  c->rng = NowNs() ^ ((uint64_t)getpid() << 32) ^ (uintptr_t)c;
+  if (c->rng == 0) c->rng = 1;
+  c->cwnd = 10;
+  c->ssthresh = RUDP_WINDOW;
+  c->peer_window = RUDP_WINDOW;
+  c->rto_ns = INITIAL_RTO_NS;
+  c->advertised = RUDP_WINDOW;
+  c->last_packet_ns = NowNs();
+  return c;
+}
+
+ssize_t RudpSend(struct RudpConn *c, const void *buf, size_t len) {
+  const char *p = buf;
+  size_t left = len;
+  while (left > 0) {
+    if (c->error || c->timeouts_in_row > MAX_TIMEOUTS) return -1;
+    // Дописываем в последний еще не отправленный пакет, если есть место
+    if (c->snd_tail > c->snd_nxt) {
+      struct SendSlot *last = &c->snd[(c->snd_tail - 1) % RUDP_WINDOW];
+      if (last->len < RUDP_MSS) {
+        size_t chunk = RUDP_MSS - last->len < left ? RUDP_MSS - last->len : left;
+        memcpy(last->data + last->len, p, chunk);
+        last->len += chunk;
+        p += chunk;
+        left -= chunk;
+        continue;
+      }
+    }
+    if (c->snd_tail - c->snd_una == RUDP_WINDOW) {
+      Pump(c, -1);
+      continue;
+    }
+    struct SendSlot *slot = &c->snd[c->snd_tail % RUDP_WINDOW];
+    slot->len = 0;
+    slot->fin = 0;
+    c->snd_tail++;
+  }
+  TrySend(c);
+  // Не даем входящим подтверждениям копиться, пока приложение пишет
+  Pump(c, 0);
+  return c->error ? -1 : (ssize_t)len;
+}
+
+ssize_t RudpRecv(struct RudpConn *c, void *buf, size_t len) {
+  while (c->rcv_read == c->rcv_nxt) {
+    if (c->error) return -1;
+    // До первого пакета ждем сколько угодно, потом - не дольше таймаута
+    if (!c->have_peer) {
+      Pump(c, -1);
+      continue;
+    }
+    if (NowNs() - c->last_packet_ns >= IDLE_TIMEOUT_NS) {
+      c->error = true;
+      return -1;
+    }
+    Pump(c, (int)(IDLE_TIMEOUT_NS / 1000000));
+  }
+  struct RecvSlot *slot = &c->rcv[c->rcv_read % RUDP_WINDOW];
+  if (slot->fin) {
+    c->fin_received = true;
+    return 0;
+  }
+  size_t n = slot->len - c->rcv_offset < len ? slot->len - c->rcv_offset : len;
+  memcpy(buf, slot->data + c->rcv_offset, n);
+  c->rcv_offset += n;
+  if (c->rcv_offset == slot->len) {
+    slot->present = 0;
+    c->rcv_offset = 0;
+    c->rcv_read++;
+    // Отправитель мог упереться в окно - сообщаем, что место появилось
+    if (c->advertised < RUDP_WINDOW / 4 &&
+        RUDP_WINDOW - (c->rcv_nxt - c->rcv_read) >= RUDP_WINDOW / 2)
+      SendAck(c);
+  }
+  return n;
+}
+
+int RudpClose(struct RudpConn *c) {
+  // FIN шлет отправляющая сторона, даже если данных не было: иначе пустая
+  // передача до получателя не дойдет. Получатель сам FIN уже принял
+  if (!c->fin_queued && !c->fin_received && !c->error) {
+    while (c->snd_tail - c->snd_una == RUDP_WINDOW) {
+      if (c->error || c->timeouts_in_row > MAX_TIMEOUTS) return -1;
+      Pump(c, -1);
+    }
+    struct SendSlot *slot = &c->snd[c->snd_tail % RUDP_WINDOW];
+    slot->len = 0;
+    slot->fin = 1;
+    c->snd_tail++;
+    c->fin_queued = true;
+    TrySend(c);
+  }
+  while (c->snd_una < c->snd_tail) {
+    if (c->error || c->timeouts_in_row > MAX_TIMEOUTS) return -1;
+    Pump(c, -1);
+  }
+  // Наше подтверждение FIN могло потеряться - отвечаем на повторы, пока
+  // пир не замолчит
+  if (c->fin_received) {
+    while (NowNs() - c->last_packet_ns < LINGER_NS && !c->error)
+      Pump(c, (int)(LINGER_NS / 1000000));
+  }
+  while (c->delayed_count > 0) Pump(c, -1);
+  return c->error ? -1 : 0;
+}
+
+void RudpGetStats(const struct RudpConn *c, struct RudpStats *stats) {
+  *stats = c->stats;
+  stats->srtt_ms = c->srtt_ns / 1e6;
+  stats->rto_ms = c->rto_ns / 1e6;
+  stats->cwnd = c->cwnd;
+}
+
+void RudpFree(struct RudpConn *c) {
+  if (c == NULL) return;
+  free(c->snd);
+  free(c->rcv);
+  free(c->delayed);
+  free(c);
+}
@@ -0,0 +1,65 @@
+#ifndef RUDP_H
+#define RUDP_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "netaddr.h"
+
+/*
+ * Надежная доставка поверх UDP. Поток байтов режется на пакеты до
+ * RUDP_MSS байт с номерами; получатель подтверждает накопительным
+ * номером и битовой картой выборочных подтверждений (SACK), поэтому одна
+ * потеря не останавливает остальной поток. Потери находятся по SACK
+ * (три подтвержденных пакета поверх дыры) и по таймеру RTO из оценки RTT
+ * (RFC 6298). Окно перегрузки растет как в TCP Reno и вдвое сжимается на
+ * потере; окно получателя (свободные ячейки буфера) ограничивает
+ * отправителя. Конец потока - пакет FIN, который тоже доставляется
+ * надежно.
+ *
+ * Соединение не требует рукопожатия: сторона с неизвестным адресом
+ * пира запоминает отправителя первого пакета данных из начала потока.
+ */
+#define RUDP_MSS 1400
+#define RUDP_WINDOW 1024
+
+// Имитация плохой сети для исходящих пакетов: доля потерь и задержка с
+// разбросом (разброс дает и переупорядочивание)
+struct RudpShim {
+  double loss;
+  int delay_ms;
+  int jitter_ms;
+};
+
+struct RudpStats {
+  unsigned long long packets_sent;
+  unsigned long long retransmits;
+  unsigned long long fast_retransmits;
+  unsigned long long timeouts;
+  unsigned long long acks_sent;
+  unsigned long long acks_received;
+  unsigned long long duplicates;
+  unsigned long long shim_dropped;
+  double srtt_ms;
+  double rto_ms;
+  double cwnd;
+};
+
+struct RudpConn;
+
+// fd - UDP-сокет, уже привязанный bind или с эфемерным портом; peer == NULL
+// - ждать первого пакета от любого адреса. shim может быть NULL
+struct RudpConn *RudpOpen(int fd, const struct NetAddr *peer,
+                          const struct RudpShim *shim);
+// Блокируются, пока данные не встанут в окно отправки / не придут;
+// RudpRecv возвращает 0 в конце потока, -1 при ошибке сокета или если
+// отправитель замолчал посреди потока дольше 30 с
+ssize_t RudpSend(struct RudpConn *conn, const void *buf, size_t len);
+ssize_t RudpRecv(struct RudpConn *conn, void *buf, size_t len);
+// Отправитель досылает все и ждет подтверждения FIN; получатель еще
+// немного отвечает на повторы FIN. -1 - пир перестал отвечать
+int RudpClose(struct RudpConn *conn);
+void RudpGetStats(const struct RudpConn *conn, struct RudpStats *stats);
+void RudpFree(struct RudpConn *conn);
+
+#endif
@@ -0,0 +1,135 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rudp.h"
+
+#define CHUNK (64 * 1024)
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  struct RudpShim shim = {0};
+  int family = NET_ANY;
+
+  while (1) {
+    static struct option options[] = {{"loss", required_argument, 0, 0},
+                                      {"delay", required_argument, 0, 0},
+                                      {"jitter", required_argument, 0, 0},
+                                      {"family", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            shim.loss = atof(optarg) / 100;
+            break;
+          case 1:
+            shim.delay_ms = atoi(optarg);
+            break;
+          case 2:
+            shim.jitter_ms = atoi(optarg);
+            break;
+          case 3:
+            family = NetParseFamily(optarg);
+            break;
+        }
+        break;
+      default:
+        exit(1);
+    }
+  }
+
+  if (argc - optind != 3 || shim.loss < 0 || shim.loss >= 1 || shim.delay_ms < 0 ||
+      shim.jitter_ms < 0 || family < 0) {
+    printf("Usage: %s <host> <port> <file>|- [--loss <percent>] [--delay <ms>] "
+           "[--jitter <ms>]\n"
+           "       [--family any|ipv4|ipv6]\n",
+           argv[0]);
+    exit(1);
+  }
+
+  struct NetAddr servaddr;
+  int status = NetResolve(argv[optind], argv[optind + 1], SOCK_DGRAM, family, &servaddr, 1);
+  if (status < 0) {
+    fprintf(stderr, "%s:%s: %s\n", argv[optind], argv[optind + 1], gai_strerror(status));
+    exit(1);
+  }
+
+  const char *path = argv[optind + 2];
+  int in = strcmp(path, "-") == 0 ? 0 : open(path, O_RDONLY);
+  if (in < 0) {
+    perror(path);
+    exit(1);
+  }
+
+  int sockfd = socket(servaddr.ss.ss_family, SOCK_DGRAM, 0);
+  if (sockfd < 0) {
+    perror("socket");
+    exit(1);
+  }
+
+  struct RudpConn *conn = RudpOpen(sockfd, &servaddr, &shim);
+  if (conn == NULL) {
+    perror("RudpOpen");
+    exit(1);
+  }
+
+  char *buf = malloc(CHUNK);
+  if (buf == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  long long total = 0;
+  ssize_t n;
+  double start = Now();
+  while ((n = read(in, buf, CHUNK)) > 0) {
+    if (RudpSend(conn, buf, n) < 0) {
+      fprintf(stderr, "Transfer failed after %lld bytes\n", total);
+      exit(1);
+    }
+    total += n;
+  }
+  if (n < 0) {
+    perror("read");
+    exit(1);
+  }
+  // Время считается до подтверждения FIN, то есть до доставки всего
+  if (RudpClose(conn) < 0) {
+    fprintf(stderr, "Server stopped answering\n");
+    exit(1);
+  }
+  double elapsed = Now() - start;
+
+  struct RudpStats st;
+  RudpGetStats(conn, &st);
+  printf("Sent %lld bytes in %.3f s: %.1f Mbit/s\n", total, elapsed,
+         elapsed > 0 ? total * 8 / elapsed / 1e6 : 0.0);
+  printf("packets %llu, retransmits %llu; losses found by SACK %llu, timeouts %llu; "
+         "dropped by shim %llu, srtt %.2f ms, rto %.0f ms, cwnd %.1f\n",
+         st.packets_sent, st.retransmits, st.fast_retransmits, st.timeouts,
+         st.shim_dropped, st.srtt_ms, st.rto_ms, st.cwnd);
+
+  RudpFree(conn);
+  free(buf);
+  close(sockfd);
+  if (in != 0) close(in);
+  return 0;
+}
@@ -0,0 +1,118 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "rudp.h"
+
+#define CHUNK (64 * 1024)
+
+int main(int argc, char *argv[]) {
+  struct RudpShim shim = {0};
+  int family = NET_ANY;
+
+  while (1) {
+    static struct option options[] = {{"loss", required_argument, 0, 0},
+                                      {"delay", required_argument, 0, 0},
+                                      {"jitter", required_argument, 0, 0},
+                                      {"family", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            shim.loss = atof(optarg) / 100;
+            break;
+          case 1:
+            shim.delay_ms = atoi(optarg);
+            break;
+          case 2:
+            shim.jitter_ms = atoi(optarg);
+            break;
+          case 3:
+            family = NetParseFamily(optarg);
+            break;
+        }
+        break;
+      default:
+        exit(1);
+    }
+  }
+
+  if (argc - optind != 2 || shim.loss < 0 || shim.loss >= 1 || shim.delay_ms < 0 ||
+      shim.jitter_ms < 0 || family < 0) {
+    printf("Usage: %s <port> <file>|- [--loss <percent>] [--delay <ms>] "
+           "[--jitter <ms>]\n"
+           "       [--family any|ipv4|ipv6]\n",
+           argv[0]);
+    exit(1);
+  }
+
+  int sockfd = NetListen(NULL, argv[optind], SOCK_DGRAM, family, 0, 0);
+  if (sockfd < 0) exit(1);
+
+  // Пакеты идут быстрее, чем процесс успевает их разбирать, - большой
+  // приемный буфер снижает потери в самом ядре
+  int rcvbuf = 8 << 20;
+  setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  char *buf = malloc(CHUNK);
+  if (buf == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  const char *path = argv[optind + 1];
+
+  // Передачи принимаются по одной, каждая - в файл заново
+  while (1) {
+    struct RudpConn *conn = RudpOpen(sockfd, NULL, &shim);
+    if (conn == NULL) {
+      perror("RudpOpen");
+      exit(1);
+    }
+
+    // Файл открывается по приходу данных, чтобы не затереть прошлую
+    // передачу раньше времени
+    long long total = 0;
+    ssize_t n = RudpRecv(conn, buf, CHUNK);
+    if (n < 0) {
+      // Передача так и не началась (например, пришел запоздалый повтор
+      // FIN прошлого отправителя) - прошлый файл не трогаем
+      fprintf(stderr, "Transfer aborted before any data\n");
+      RudpClose(conn);
+      RudpFree(conn);
+      continue;
+    }
+    int out = strcmp(path, "-") == 0 ? 1 : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+      perror(path);
+      exit(1);
+    }
+    for (; n > 0; n = RudpRecv(conn, buf, CHUNK)) {
+      if (write(out, buf, n) != n) {
+        perror("write");
+        exit(1);
+      }
+      total += n;
+    }
+    if (n < 0) fprintf(stderr, "Transfer broken after %lld bytes\n", total);
+    RudpClose(conn);
+    if (out != 1) close(out);
+
+    struct RudpStats st;
+    RudpGetStats(conn, &st);
+    fprintf(stderr, "Received %lld bytes: %llu acks, %llu duplicates, %llu dropped by shim\n",
+            total, st.acks_sent, st.duplicates, st.shim_dropped);
+    RudpFree(conn);
+  }
+}
@@ -1,57 +1,457 @@
-#include <arpa/inet.h>
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/errqueue.h>
+#include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "netaddr.h"
+
 #define SADDR struct sockaddr
 
-int main(int argc, char *argv[]) {
-  if (argc < 4) {
-    printf("Usage: %s <ip> <port> <buffer_size>\n", argv[0]);
-    exit(1);
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Файл целиком уходит в сокет внутри ядра, минуя буферы процесса
+static long long SendFile(int fd, int in, off_t size) {
+  off_t offset = 0;
+  while (offset < size) {
+    ssize_t n = sendfile(fd, in, &offset, size - offset);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("sendfile");
+      exit(1);
+    }
+    if (n == 0) break;
   }
+  return offset;
+}
 
-  char *ip = argv[1];
-  int port = atoi(argv[2]);
-  int bufsize = atoi(argv[3]);
-  
-  int fd;
-  int nread;
-  char buf[bufsize];
-  struct sockaddr_in servaddr;
-  
-  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-    perror("socket creating");
+// Канал (например, stdin из другой программы) перекладывается в сокет
+// через splice: страницы канала передаются сокету без копирования
+static long long SplicePipe(int fd, int in, int bufsize) {
+  long long total = 0;
+  while (1) {
+    ssize_t n = splice(in, NULL, fd, NULL, bufsize, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("splice");
+      exit(1);
+    }
+    if (n == 0) break;
+    total += n;
+  }
+  return total;
+}
+
+// Разбор уведомлений MSG_ZEROCOPY: ядро сообщает диапазоны номеров
+// завершенных send и то, пришлось ли все-таки копировать
+static int ReapZerocopy(int fd, unsigned *completed, bool *copied, bool wait) {
+  char control[128];
+  while (1) {
+    if (wait) {
+      struct pollfd pfd = {.fd = fd, .events = 0};
+      poll(&pfd, 1, 1000);
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EAGAIN || errno == EINTR) return 0;
+      perror("recvmsg MSG_ERRQUEUE");
+      return -1;
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      struct sock_extended_err *err = (struct sock_extended_err *)CMSG_DATA(cm);
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+      *completed += err->ee_data - err->ee_info + 1;
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) *copied = true;
+    }
+    wait = false;
+  }
+}
+
+// Файл отображается в память и отправляется send(MSG_ZEROCOPY): ядро
+// передает сетевой карте сами страницы. Отображение только читается,
+// поэтому его можно не трогать до прихода уведомлений
+static long long SendZerocopy(int fd, int in, off_t size, int bufsize) {
+  // Пустой файл не отобразить: mmap нулевой длины - EINVAL
+  if (size == 0) return 0;
+  int one = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+    perror("setsockopt SO_ZEROCOPY (falling back to sendfile)");
+    return SendFile(fd, in, size);
+  }
+  char *data = mmap(NULL, size, PROT_READ, MAP_SHARED, in, 0);
+  if (data == MAP_FAILED) {
+    perror("mmap");
     exit(1);
   }
 
-  memset(&servaddr, 0, sizeof(servaddr));
-  servaddr.sin_family = AF_INET;
+  unsigned issued = 0, completed = 0;
+  bool copied = false;
+  off_t offset = 0;
+  while (offset < size) {
+    size_t left = (size_t)(size - offset);
+    size_t chunk = left < (size_t)bufsize ? left : (size_t)bufsize;
+    ssize_t n = send(fd, data + offset, chunk, MSG_ZEROCOPY);
+    if (n < 0) {
+      // Закончилась память под закрепленные страницы - ждем завершений
+      if (errno == ENOBUFS || errno == EAGAIN) {
+        if (ReapZerocopy(fd, &completed, &copied, true) < 0) exit(1);
+        continue;
+      }
+      if (errno == EINTR) continue;
+      perror("send MSG_ZEROCOPY");
+      exit(1);
+    }
+    issued++;
+    offset += n;
+    if (ReapZerocopy(fd, &completed, &copied, false) < 0) exit(1);
+  }
+  while (completed < issued) {
+    if (ReapZerocopy(fd, &completed, &copied, true) < 0) break;
+  }
+  if (copied)
+    fprintf(stderr, "MSG_ZEROCOPY: kernel fell back to copying (e.g. loopback)\n");
+  munmap(data, size);
+  return offset;
+}
+
+// Одновременно незавершенных connect: больше - и очередь SYN сервера
+// переполняется, а клиенты уходят в секундные повторы
+#define MAX_PENDING_CONNECTS 512
+#define EPOLL_BATCH 512
+
+// Нагрузка на сервер: conns одновременных соединений, затем duration
+// секунд все они шлют данные блоками по bufsize. Печатает скорость
+// установки соединений и суммарную пропускную способность
+static int RunManyConnections(const struct NetAddr *addr, int conns,
+                              double duration, int bufsize) {
+  NetRaiseFileLimit();
+  int epfd = epoll_create1(0);
+  int *fds = malloc(conns * sizeof(int));
+  char *buf = malloc(bufsize);
+  if (epfd < 0 || fds == NULL || buf == NULL) {
+    perror("setup");
+    return 1;
+  }
+  memset(buf, 'x', bufsize);
+
+  struct epoll_event events[EPOLL_BATCH];
+  int started = 0, pending = 0, established = 0, failed = 0;
+  double start = Now();
+
+  // Фаза 1: установка соединений, не больше MAX_PENDING_CONNECTS сразу
+  while (established + failed < conns) {
+    while (started < conns && pending < MAX_PENDING_CONNECTS) {
+      int fd = socket(addr->ss.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      if (fd < 0) {
+        perror("socket");
+        fds[started++] = -1;
+        failed++;
+        continue;
+      }
+      fds[started] = fd;
+      if (connect(fd, (SADDR *)&addr->ss, addr->len) < 0 && errno != EINPROGRESS) {
+        perror("connect");
+        close(fd);
+        fds[started++] = -1;
+        failed++;
+        continue;
+      }
+      struct epoll_event ev = {.events = EPOLLOUT, .data.u32 = started};
+      epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+      started++;
+      pending++;
+    }
+    if (pending == 0) continue;
+
+    int n = epoll_wait(epfd, events, EPOLL_BATCH, 5000);
+    if (n == 0) {
+      fprintf(stderr, "Timed out waiting for %d connects\n", pending);
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      int index = events[i].data.u32;
+      int err = 0;
+      socklen_t len = sizeof(err);
+      getsockopt(fds[index], SOL_SOCKET, SO_ERROR, &err, &len);
+      pending--;
+      if (err != 0) {
+        fprintf(stderr, "connect: %s\n", strerror(err));
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fds[index], NULL);
+        close(fds[index]);
+        fds[index] = -1;
+        failed++;
+        continue;
+      }
+      // До конца фазы соединение молчит
+      struct epoll_event ev = {.events = 0, .data.u32 = index};
+      epoll_ctl(epfd, EPOLL_CTL_MOD, fds[index], &ev);
+      established++;
+    }
+  }
+  double connect_time = Now() - start;
+  printf("Connected %d of %d in %.3f s: %.0f connections/s\n", established,
+         conns, connect_time, connect_time > 0 ? established / connect_time : 0.0);
 
-  if (inet_pton(AF_INET, ip, &servaddr.sin_addr) <= 0) {
-    perror("bad address");
+  // Фаза 2: все соединения одновременно пишут до истечения duration
+  for (int i = 0; i < conns; i++) {
+    if (fds[i] < 0) continue;
+    struct epoll_event ev = {.events = EPOLLOUT, .data.u32 = i};
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fds[i], &ev);
+  }
+  unsigned long long sent = 0;
+  int broken = 0;
+  start = Now();
+  double deadline = start + duration;
+  while (Now() < deadline && established - broken > 0) {
+    int n = epoll_wait(epfd, events, EPOLL_BATCH, 100);
+    for (int i = 0; i < n; i++) {
+      int index = events[i].data.u32;
+      ssize_t written = send(fds[index], buf, bufsize, MSG_NOSIGNAL);
+      if (written > 0) {
+        sent += written;
+      } else if (written < 0 && errno != EAGAIN && errno != EINTR) {
+        perror("send");
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fds[index], NULL);
+        close(fds[index]);
+        fds[index] = -1;
+        broken++;
+      }
+    }
+  }
+  double elapsed = Now() - start;
+  printf("Sent %llu bytes over %d connections in %.3f s: %.2f Gbit/s",
+         sent, established - broken, elapsed, sent * 8 / elapsed / 1e9);
+  printf(", %d failed\n", failed + broken);
+
+  for (int i = 0; i < conns; i++) {
+    if (fds[i] >= 0) close(fds[i]);
+  }
+  free(fds);
+  free(buf);
+  close(epfd);
+  return failed + broken > 0 ? 2 : 0;
+}
+
+// Скорость установки соединений: connect и сразу закрытие со сбросом
+// (SO_LINGER 0), чтобы не копить TIME_WAIT и не исчерпать порты
+static int RunConnectChurn(const struct NetAddr *addr, double duration) {
+  unsigned long long done = 0, failed = 0;
+  struct linger reset = {.l_onoff = 1, .l_linger = 0};
+  double start = Now();
+  double deadline = start + duration;
+  while (Now() < deadline) {
+    int fd = socket(addr->ss.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+      perror("socket");
+      return 1;
+    }
+    if (connect(fd, (SADDR *)&addr->ss, addr->len) < 0) {
+      failed++;
+    } else {
+      setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+      done++;
+    }
+    close(fd);
+  }
+  double elapsed = Now() - start;
+  printf("Opened and closed %llu connections in %.3f s: %.0f connections/s, "
+         "%llu failed\n", done, elapsed, done / elapsed, failed);
+  return failed > 0 ? 2 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *bulk = NULL;
+  int sndbuf = 0;
+  bool zerocopy = false;
+  int conns = 0;
+  double duration = 5;
+  bool churn = false;
+  int family = NET_ANY;
+
+  while (1) {
+    static struct option options[] = {{"bulk", required_argument, 0, 0},
+                                      {"sndbuf", required_argument, 0, 0},
+                                      {"zerocopy", no_argument, 0, 0},
+                                      {"conns", required_argument, 0, 0},
+                                      {"duration", required_argument, 0, 0},
+                                      {"churn", no_argument, 0, 0},
+                                      {"family", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            bulk = optarg;
+            break;
+          case 1:
+            sndbuf = atoi(optarg);
+            break;
+          case 2:
+            zerocopy = true;
+            break;
+          case 3:
+            conns = atoi(optarg);
+            break;
+          case 4:
+            duration = atof(optarg);
+            break;
+          case 5:
+            churn = true;
+            break;
+          case 6:
+            family = NetParseFamily(optarg);
+            break;
+        }
+        break;
+      default:
+        exit(1);
+    }
+  }
+
+  if (argc - optind < 3 || family < 0) {
+    printf("Usage: %s <host> <port> <buffer_size> [--bulk <file>|-] "
+           "[--sndbuf <bytes>] [--zerocopy]\n"
+           "       %s <host> <port> <buffer_size> --conns <n> [--duration <s>]\n"
+           "       %s <host> <port> <buffer_size> --churn [--duration <s>]\n"
+           "       common: [--family any|ipv4|ipv6]\n",
+           argv[0], argv[0], argv[0]);
     exit(1);
   }
 
-  servaddr.sin_port = htons(port);
+  char *host = argv[optind];
+  char *port = argv[optind + 1];
+  int bufsize = atoi(argv[optind + 2]);
+  if (bufsize <= 0) {
+    printf("buffer_size must be positive\n");
+    exit(1);
+  }
 
-  if (connect(fd, (SADDR *)&servaddr, sizeof(servaddr)) < 0) {
-    perror("connect");
+  int fd = -1;
+  int nread;
+  struct NetAddr addrs[NET_MAX_ADDRS];
+  int naddrs = NetResolve(host, port, SOCK_STREAM, family, addrs, NET_MAX_ADDRS);
+  if (naddrs < 0) {
+    fprintf(stderr, "%s:%s: %s\n", host, port, gai_strerror(naddrs));
     exit(1);
   }
 
-  write(1, "Input message to send\n", 22);
-  while ((nread = read(0, buf, bufsize)) > 0) {
-    if (write(fd, buf, nread) < 0) {
-      perror("write");
+  // Режимы нагрузки открывают собственные сокеты к первому адресу
+  if (conns > 0 || churn) {
+    return conns > 0 ? RunManyConnections(&addrs[0], conns, duration, bufsize)
+                     : RunConnectChurn(&addrs[0], duration);
+  }
+
+  // Адреса перебираются по порядку getaddrinfo (IPv6 обычно первым)
+  for (int i = 0; i < naddrs && fd < 0; i++) {
+    if ((fd = socket(addrs[i].ss.ss_family, SOCK_STREAM, 0)) < 0) {
+      perror("socket creating");
+      exit(1);
+    }
+
+    // Размер буфера задается до connect, чтобы окно TCP согласовалось с ним
+    if (sndbuf > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
+      perror("setsockopt SO_SNDBUF");
+      exit(1);
+    }
+
+    if (connect(fd, (SADDR *)&addrs[i].ss, addrs[i].len) < 0) {
+      if (i == naddrs - 1) {
+        perror("connect");
+        exit(1);
+      }
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  if (bulk == NULL) {
+    char *buf = malloc(bufsize);
+    if (buf == NULL) {
+      perror("malloc");
       exit(1);
     }
+    write(1, "Input message to send\n", 22);
+    while ((nread = read(0, buf, bufsize)) > 0) {
+      if (write(fd, buf, nread) < 0) {
+        perror("write");
+        exit(1);
+      }
+    }
+    free(buf);
+    close(fd);
+    exit(0);
+  }
+
+  int in = strcmp(bulk, "-") == 0 ? 0 : open(bulk, O_RDONLY);
+  struct stat st;
+  if (in < 0 || fstat(in, &st) < 0) {
+    perror(bulk);
+    exit(1);
+  }
+
+  double start = Now();
+  long long sent;
+  if (S_ISREG(st.st_mode))
+    sent = zerocopy ? SendZerocopy(fd, in, st.st_size, bufsize)
+                    : SendFile(fd, in, st.st_size);
+  else if (S_ISFIFO(st.st_mode))
+    sent = SplicePipe(fd, in, bufsize);
+  else {
+    fprintf(stderr, "%s: bulk mode needs a regular file or a pipe\n", bulk);
+    exit(1);
   }
 
+  // Время считается до подтверждения сервером: он закрывает соединение,
+  // прочитав все данные
+  shutdown(fd, SHUT_WR);
+  char tail;
+  while (read(fd, &tail, 1) > 0) {
+  }
+  double elapsed = Now() - start;
+
+  int actual = 0;
+  socklen_t len = sizeof(actual);
+  getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &actual, &len);
+  fprintf(stderr, "Sent %lld bytes in %.3f s: %.2f Gbit/s (SO_SNDBUF %d)\n",
+          sent, elapsed, elapsed > 0 ? sent * 8 / elapsed / 1e9 : 0.0, actual);
+
   close(fd);
   exit(0);
 }
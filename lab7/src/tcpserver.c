@@ -1,65 +1,335 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "arena.h"
+#include "netaddr.h"
+#include "pgo.h"
+
 #define SADDR struct sockaddr
 
+// Сколько событий забирает один epoll_wait
+#define EPOLL_BATCH 512
+// Объектов в одном слябе пула соединений
+#define CLIENTS_PER_SLAB 64
+
+// Соединение и его буфер - один объект пула
+struct Client {
+  int fd;
+  char buf[];
+};
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Данные из сокета попадают в файл через канал: splice сокет -> канал ->
+// файл перекладывает страницы, не копируя их в процесс
+static long long SpliceToFile(int cfd, int out, int pipefd[2], int bufsize) {
+  long long total = 0;
+  while (1) {
+    ssize_t n = splice(cfd, NULL, pipefd[1], NULL, bufsize,
+                       SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("splice from socket");
+      return -1;
+    }
+    if (n == 0) break;
+    total += n;
+    while (n > 0) {
+      ssize_t m = splice(pipefd[0], NULL, out, NULL, n, SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (m < 0) {
+        if (errno == EINTR) continue;
+        perror("splice to output");
+        return -1;
+      }
+      n -= m;
+    }
+  }
+  return total;
+}
+
+static void CloseClient(int epfd, struct Pool *pool, struct Client *client) {
+  epoll_ctl(epfd, EPOLL_CTL_DEL, client->fd, NULL);
+  close(client->fd);
+  PoolFree(pool, client);
+}
+
+// Все клиенты обслуживаются одновременно в одном потоке. Ошибка на
+// соединении закрывает только его; ошибки accept (например, кончились
+// дескрипторы) печатаются, и сервер продолжает работу
+static void RunEpollServer(int lfd, int bufsize) {
+  int epfd = epoll_create1(0);
+  if (epfd < 0) {
+    perror("epoll_create1");
+    exit(1);
+  }
+  fcntl(lfd, F_SETFL, fcntl(lfd, F_GETFL) | O_NONBLOCK);
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev) < 0) {
+    perror("epoll_ctl");
+    exit(1);
+  }
+
+  struct Pool pool;
+  PoolInit(&pool, sizeof(struct Client) + bufsize, CLIENTS_PER_SLAB);
+
+  // Запасной дескриптор: когда лимит исчерпан, он освобождается, чтобы
+  // принять и сразу закрыть соединение, иначе оно будет будить epoll вечно
+  int spare_fd = open("/dev/null", O_RDONLY);
+  // Запасного нет, а лимит исчерпан: слушающий сокет снят с EPOLLIN, иначе
+  // level-triggered epoll будил бы цикл без конца
+  bool listen_paused = false;
+
+  struct epoll_event events[EPOLL_BATCH];
+  unsigned long long accepted = 0, accepted_reported = 0;
+  unsigned long long received = 0, received_reported = 0;
+  double reported_at = Now();
+
+  while (1) {
+    // Пробуем вернуть запасной на каждом проходе: хоть раз в секунду
+    // (таймаут epoll_wait) или после закрытия клиента
+    if (spare_fd < 0) spare_fd = open("/dev/null", O_RDONLY);
+    if (listen_paused && spare_fd >= 0) {
+      epoll_ctl(epfd, EPOLL_CTL_MOD, lfd, &ev);
+      listen_paused = false;
+    }
+
+    int n = epoll_wait(epfd, events, EPOLL_BATCH, 1000);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      exit(1);
+    }
+
+    for (int i = 0; i < n; i++) {
+      struct Client *client = events[i].data.ptr;
+
+      if (client == NULL) {
+        // Принимаем всех ожидающих разом
+        while (1) {
+          int cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK);
+          if (cfd < 0) {
+            if ((errno == EMFILE || errno == ENFILE) && spare_fd >= 0) {
+              fprintf(stderr, "accept: out of descriptors, dropping a client\n");
+              close(spare_fd);
+              close(accept(lfd, NULL, NULL));
+              spare_fd = open("/dev/null", O_RDONLY);
+              continue;
+            }
+            if (errno == EMFILE || errno == ENFILE) {
+              fprintf(stderr, "accept: out of descriptors, pausing accept\n");
+              struct epoll_event off = {.events = 0, .data.ptr = NULL};
+              epoll_ctl(epfd, EPOLL_CTL_MOD, lfd, &off);
+              listen_paused = true;
+              break;
+            }
+            if (errno != EAGAIN && errno != EINTR && errno != ECONNABORTED)
+              perror("accept");
+            break;
+          }
+          client = PoolAlloc(&pool);
+          if (client == NULL) {
+            fprintf(stderr, "Out of memory for client\n");
+            close(cfd);
+            continue;
+          }
+          client->fd = cfd;
+          struct epoll_event cev = {.events = EPOLLIN | EPOLLRDHUP, .data.ptr = client};
+          if (epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &cev) < 0) {
+            perror("epoll_ctl");
+            close(cfd);
+            PoolFree(&pool, client);
+            continue;
+          }
+          accepted++;
+        }
+        continue;
+      }
+
+      // Одно чтение на событие: клиенты получают процессор по очереди
+      ssize_t nread = read(client->fd, client->buf, bufsize);
+      if (nread > 0) {
+        received += nread;
+        if (write(1, client->buf, nread) < 0 && errno != EAGAIN) {
+          perror("write");
+          exit(1);
+        }
+      } else if (nread == 0 || (errno != EAGAIN && errno != EINTR)) {
+        // Сброс соединения клиентом (SO_LINGER 0) - штатное завершение
+        if (nread < 0 && errno != ECONNRESET) perror("read");
+        CloseClient(epfd, &pool, client);
+      }
+    }
+
+    double now = Now();
+    if (now - reported_at >= 1.0) {
+      if (accepted != accepted_reported || received != received_reported) {
+        double span = now - reported_at;
+        fprintf(stderr,
+                "clients: %zu active, %zu peak, %.0f accepted/s; "
+                "received %.2f Gbit/s\n",
+                pool.in_use, pool.peak, (accepted - accepted_reported) / span,
+                (received - received_reported) * 8 / span / 1e9);
+      }
+      accepted_reported = accepted;
+      received_reported = received;
+      reported_at = now;
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
-  if (argc < 3) {
-    printf("Usage: %s <port> <buffer_size>\n", argv[0]);
+  const char *bulk = NULL;
+  int rcvbuf = 0;
+  bool use_epoll = false;
+  int family = NET_ANY;
+
+  while (1) {
+    static struct option options[] = {{"bulk", required_argument, 0, 0},
+                                      {"rcvbuf", required_argument, 0, 0},
+                                      {"epoll", no_argument, 0, 0},
+                                      {"family", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            bulk = optarg;
+            break;
+          case 1:
+            rcvbuf = atoi(optarg);
+            break;
+          case 2:
+            use_epoll = true;
+            break;
+          case 3:
+            family = NetParseFamily(optarg);
+            break;
+        }
+        break;
+      default:
+        exit(1);
+    }
+  }
+
+  if (argc - optind < 2 || family < 0) {
+    printf("Usage: %s <port> <buffer_size> [--bulk <file>|-] [--rcvbuf <bytes>] "
+           "[--epoll] [--family any|ipv4|ipv6]\n",
+           argv[0]);
+    exit(1);
+  }
+
+  const char *port = argv[optind];
+  int bufsize = atoi(argv[optind + 1]);
+  if (bufsize <= 0) {
+    printf("buffer_size must be positive\n");
     exit(1);
   }
 
-  int port = atoi(argv[1]);
-  int bufsize = atoi(argv[2]);
-  
   int lfd, cfd;
-  int nread;
-  char buf[bufsize];
-  struct sockaddr_in servaddr;
-  struct sockaddr_in cliaddr;
+  ssize_t nread;
+  char *buf = malloc(bufsize);
+  struct sockaddr_storage cliaddr;
 
-  if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-    perror("socket");
+  if (buf == NULL) {
+    perror("malloc");
     exit(1);
   }
 
-  memset(&servaddr, 0, sizeof(servaddr));
-  servaddr.sin_family = AF_INET;
-  servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-  servaddr.sin_port = htons(port);
+  // Очередь ожидающих соединений - по максимуму системы, иначе при
+  // всплеске подключений клиенты ждут повторной отправки SYN. Без
+  // --family сокет двухстековый
+  if ((lfd = NetListen(NULL, port, SOCK_STREAM, family, SOMAXCONN, 0)) < 0) exit(1);
 
-  if (bind(lfd, (SADDR *)&servaddr, sizeof(servaddr)) < 0) {
-    perror("bind");
+  // Принятые сокеты наследуют SO_RCVBUF, а окно TCP выбирается при
+  // установке соединения - поэтому размер задается до первого клиента
+  if (rcvbuf > 0 &&
+      setsockopt(lfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
+    perror("setsockopt SO_RCVBUF");
     exit(1);
   }
 
-  if (listen(lfd, 5) < 0) {
-    perror("listen");
-    exit(1);
+  // Закрывшийся клиент не должен ронять сервер через SIGPIPE
+  signal(SIGPIPE, SIG_IGN);
+  PgoDumpOnSignal();
+
+  if (use_epoll) {
+    NetRaiseFileLimit();
+    RunEpollServer(lfd, bufsize);
+  }
+
+  int pipefd[2];
+  if (bulk != NULL) {
+    if (pipe(pipefd) < 0) {
+      perror("pipe");
+      exit(1);
+    }
+    // Канал побольше - меньше переключений между двумя splice
+    fcntl(pipefd[1], F_SETPIPE_SZ, 1 << 20);
   }
 
   while (1) {
-    unsigned int clilen = sizeof(cliaddr);
+    socklen_t clilen = sizeof(cliaddr);
 
     if ((cfd = accept(lfd, (SADDR *)&cliaddr, &clilen)) < 0) {
       perror("accept");
-      exit(1);
+      continue;
     }
-    printf("connection established\n");
+    // В режиме bulk stdout может оказаться приемником данных
+    fprintf(bulk != NULL ? stderr : stdout, "connection established\n");
+    fflush(stdout);
 
-    while ((nread = read(cfd, buf, bufsize)) > 0) {
-      write(1, &buf, nread);
+    if (bulk != NULL) {
+      int out = strcmp(bulk, "-") == 0
+                    ? 1
+                    : open(bulk, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (out < 0) {
+        perror(bulk);
+        exit(1);
+      }
+      double start = Now();
+      long long received = SpliceToFile(cfd, out, pipefd, bufsize);
+      double elapsed = Now() - start;
+      if (out != 1) close(out);
+
+      int actual = 0;
+      socklen_t len = sizeof(actual);
+      getsockopt(cfd, SOL_SOCKET, SO_RCVBUF, &actual, &len);
+      if (received >= 0)
+        fprintf(stderr, "Received %lld bytes in %.3f s: %.2f Gbit/s (SO_RCVBUF %d)\n",
+                received, elapsed, elapsed > 0 ? received * 8 / elapsed / 1e9 : 0.0,
+                actual);
+      close(cfd);
+      continue;
     }
 
-    if (nread == -1) {
-      perror("read");
-      exit(1);
+    while ((nread = read(cfd, buf, bufsize)) > 0) {
+      write(1, buf, nread);
     }
+
+    // Оборванное соединение - забота только этого клиента
+    if (nread == -1 && errno != ECONNRESET) perror("read");
     close(cfd);
   }
 }
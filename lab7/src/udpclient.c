@@ -1,55 +1,362 @@
+#define _GNU_SOURCE
+
 #include <netinet/in.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <arpa/inet.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "hist.h"
+#include "netaddr.h"
+
 #define SADDR struct sockaddr
 
+// Датаграмм в одном sendmmsg/recvmmsg
+#define LOAD_BURST 32
+
+// Заголовок каждой датаграммы нагрузки; сервер возвращает его как есть
+struct Probe {
+  uint64_t seq;
+  uint64_t sent_ns;
+};
+
+// Ячейка кольца неотвеченных: sent_ns == 0 - ячейка свободна
+struct Pending {
+  uint64_t seq;
+  uint64_t sent_ns;
+};
+
+struct LoadStats {
+  unsigned long long sent, received, lost, late, reordered;
+  // Старший полученный номер на каждом сокете: порядок имеет смысл только
+  // внутри одного потока датаграмм
+  uint64_t *max_seq;
+  struct Hist rtt;
+};
+
+struct LoadOptions {
+  int bufsize;
+  int sockets;
+  int duration;
+  int window;
+  double rate;
+  int timeout_ms;
+  int busy_poll;
+};
+
+static void FillHeaders(struct mmsghdr *msgs, struct iovec *iovs, char *buffers,
+                        int bufsize) {
+  memset(msgs, 0, LOAD_BURST * sizeof(*msgs));
+  for (int i = 0; i < LOAD_BURST; i++) {
+    iovs[i].iov_base = buffers + (size_t)i * bufsize;
+    iovs[i].iov_len = bufsize;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+// Ответ сверяется с кольцом по номеру; ответ на уже списанную по таймауту
+// или уже полученную датаграмму считается опоздавшим
+static void TakeReply(struct LoadStats *st, struct Pending *ring, uint64_t mask,
+                      const struct Probe *probe, int socket, uint64_t now,
+                      int *inflight) {
+  struct Pending *slot = &ring[probe->seq & mask];
+  if (slot->sent_ns == 0 || slot->seq != probe->seq) {
+    st->late++;
+    return;
+  }
+  slot->sent_ns = 0;
+  (*inflight)--;
+  st->received++;
+  HistRecord(&st->rtt, now - probe->sent_ns);
+  // В max_seq хранится seq + 1, чтобы ноль означал "ответов еще не было"
+  if (probe->seq + 1 < st->max_seq[socket])
+    st->reordered++;
+  else
+    st->max_seq[socket] = probe->seq + 1;
+}
+
+// Нагрузочный режим: окно из window неотвеченных датаграмм с номерами и
+// временем отправки. Неотвеченная дольше timeout считается потерянной.
+// С rate > 0 датаграммы уходят по расписанию, иначе - как позволяет окно
+static void RunLoad(const struct NetAddr *servaddr, const struct LoadOptions *opt) {
+  int sockets = opt->sockets, bufsize = opt->bufsize;
+  uint64_t ring_size = 1;
+  while (ring_size < (uint64_t)opt->window * 4) ring_size <<= 1;
+  uint64_t mask = ring_size - 1;
+
+  int *fds = malloc(sockets * sizeof(int));
+  struct pollfd *pfds = calloc(sockets, sizeof(struct pollfd));
+  struct Pending *ring = calloc(ring_size, sizeof(struct Pending));
+  struct LoadStats *st = calloc(1, sizeof(struct LoadStats));
+  char *buffers = calloc(LOAD_BURST, bufsize);
+  struct mmsghdr msgs[LOAD_BURST];
+  struct iovec iovs[LOAD_BURST];
+  if (fds == NULL || pfds == NULL || ring == NULL || st == NULL || buffers == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  st->max_seq = calloc(sockets, sizeof(uint64_t));
+  if (st->max_seq == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  HistInit(&st->rtt);
+
+  // У каждого сокета свой порт, значит SO_REUSEPORT раскидает их по
+  // потокам сервера
+  for (int i = 0; i < sockets; i++) {
+    if ((fds[i] = socket(servaddr->ss.ss_family, SOCK_DGRAM | SOCK_NONBLOCK, 0)) < 0 ||
+        connect(fds[i], (SADDR *)&servaddr->ss, servaddr->len) < 0) {
+      perror("socket problem");
+      exit(1);
+    }
+    if (opt->busy_poll > 0 && NetTune(fds[i], NET_BUSY_POLL, opt->busy_poll) < 0)
+      perror("setsockopt SO_BUSY_POLL");
+    pfds[i].fd = fds[i];
+    pfds[i].events = POLLIN;
+  }
+
+  uint64_t timeout_ns = (uint64_t)opt->timeout_ms * 1000000ull;
+  uint64_t start = MonotonicNs();
+  uint64_t stop_sending = start + (uint64_t)opt->duration * 1000000000ull;
+  uint64_t next_seq = 0, oldest = 0, next_report = start + 1000000000ull;
+  unsigned long long reported_sent = 0, reported_received = 0;
+  int inflight = 0, next_socket = 0;
+
+  while (1) {
+    uint64_t now = MonotonicNs();
+    if (now >= stop_sending && inflight == 0) break;
+
+    // Списываем просроченные; в кольце не должно быть двух живых номеров
+    // в одной ячейке
+    while (oldest < next_seq) {
+      struct Pending *slot = &ring[oldest & mask];
+      if (slot->sent_ns != 0 && slot->seq == oldest) {
+        if (now - slot->sent_ns < timeout_ns && next_seq - oldest < ring_size) break;
+        slot->sent_ns = 0;
+        inflight--;
+        st->lost++;
+      }
+      oldest++;
+    }
+
+    // Сколько можно отправить: свободное место в окне и, при заданной
+    // скорости, сколько датаграмм уже положено по расписанию
+    uint64_t can_send = 0;
+    if (now < stop_sending && inflight < opt->window) {
+      can_send = opt->window - inflight;
+      if (opt->rate > 0) {
+        uint64_t due = (uint64_t)((now - start) / 1e9 * opt->rate) + 1;
+        can_send = due > st->sent ? (due - st->sent < can_send ? due - st->sent : can_send)
+                                  : 0;
+      }
+      if (next_seq + can_send - oldest > ring_size) can_send = ring_size - (next_seq - oldest);
+      if (can_send > LOAD_BURST) can_send = LOAD_BURST;
+    }
+
+    int progress = 0;
+    if (can_send > 0) {
+      FillHeaders(msgs, iovs, buffers, bufsize);
+      for (uint64_t i = 0; i < can_send; i++) {
+        struct Probe probe = {.seq = next_seq + i, .sent_ns = now};
+        memcpy(iovs[i].iov_base, &probe, sizeof(probe));
+      }
+      int n = sendmmsg(fds[next_socket], msgs, can_send, 0);
+      next_socket = (next_socket + 1) % sockets;
+      for (int i = 0; i < n; i++) {
+        struct Pending *slot = &ring[(next_seq + i) & mask];
+        slot->seq = next_seq + i;
+        slot->sent_ns = now;
+      }
+      if (n > 0) {
+        next_seq += n;
+        inflight += n;
+        st->sent += n;
+        progress = 1;
+      }
+    }
+
+    for (int s = 0; s < sockets; s++) {
+      FillHeaders(msgs, iovs, buffers, bufsize);
+      int n = recvmmsg(fds[s], msgs, LOAD_BURST, MSG_DONTWAIT, NULL);
+      if (n <= 0) continue;
+      now = MonotonicNs();
+      for (int i = 0; i < n; i++) {
+        struct Probe probe;
+        if (msgs[i].msg_len < sizeof(probe)) continue;
+        memcpy(&probe, iovs[i].iov_base, sizeof(probe));
+        TakeReply(st, ring, mask, &probe, s, now, &inflight);
+      }
+      progress = 1;
+    }
+
+    if (now >= next_report) {
+      fprintf(stderr, "%llu sent/s, %llu received/s, %d in flight, %llu lost so far\n",
+              st->sent - reported_sent, st->received - reported_received, inflight,
+              st->lost);
+      reported_sent = st->sent;
+      reported_received = st->received;
+      next_report += 1000000000ull;
+    }
+
+    // Ничего не произошло: ждем ответа до ближайшей отправки по расписанию
+    if (!progress) {
+      int wait_ms = 1;
+      if (inflight >= opt->window || now >= stop_sending) wait_ms = 10;
+      poll(pfds, sockets, wait_ms);
+    }
+  }
+
+  double elapsed = (MonotonicNs() - start) / 1e9;
+  double sent = st->sent > 0 ? st->sent : 1;
+  double received = st->received > 0 ? st->received : 1;
+  printf("Load: %d sockets, window %d, %d-byte datagrams, %.1f s\n", sockets,
+         opt->window, bufsize, elapsed);
+  printf("sent %llu (%.0f pps), received %llu (%.0f pps)\n", st->sent,
+         st->sent / elapsed, st->received, st->received / elapsed);
+  printf("lost %llu (%.3f%%), late %llu, reordered %llu (%.3f%%)\n", st->lost,
+         100.0 * st->lost / sent, st->late, st->reordered,
+         100.0 * st->reordered / received);
+  HistPrint(stdout, "RTT", &st->rtt, 1000.0, "us");
+
+  for (int i = 0; i < sockets; i++) close(fds[i]);
+  free(fds);
+  free(pfds);
+  free(ring);
+  free(st->max_seq);
+  free(st);
+  free(buffers);
+}
+
 int main(int argc, char **argv) {
-  if (argc != 4) {
-    printf("Usage: %s <ip> <port> <buffer_size>\n", argv[0]);
+  struct LoadOptions load = {
+      .sockets = 1, .duration = 0, .window = 64, .rate = 0, .timeout_ms = 1000};
+  int family = NET_ANY;
+
+  while (1) {
+    static struct option options[] = {{"load", required_argument, 0, 0},
+                                      {"window", required_argument, 0, 0},
+                                      {"rate", required_argument, 0, 0},
+                                      {"timeout", required_argument, 0, 0},
+                                      {"sockets", required_argument, 0, 0},
+                                      {"family", required_argument, 0, 0},
+                                      {"busy-poll", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            load.duration = atoi(optarg);
+            break;
+          case 1:
+            load.window = atoi(optarg);
+            break;
+          case 2:
+            load.rate = atof(optarg);
+            break;
+          case 3:
+            load.timeout_ms = atoi(optarg);
+            break;
+          case 4:
+            load.sockets = atoi(optarg);
+            break;
+          case 5:
+            family = NetParseFamily(optarg);
+            break;
+          case 6:
+            load.busy_poll = atoi(optarg);
+            break;
+        }
+        break;
+      default:
+        exit(1);
+    }
+  }
+
+  if (argc - optind != 3 || load.sockets < 1 || load.window < 1 ||
+      load.timeout_ms < 1 || load.rate < 0 || family < 0) {
+    printf("Usage: %s <host> <port> <buffer_size> [--timeout <ms>] "
+           "[--family any|ipv4|ipv6]\n"
+           "       [--load <seconds> [--window <n>] [--rate <pps>] [--sockets <n>]\n"
+           "        [--busy-poll <us>]]\n",
+           argv[0]);
     exit(1);
   }
 
-  char *ip = argv[1];
-  int port = atoi(argv[2]);
-  int bufsize = atoi(argv[3]);
+  char *host = argv[optind];
+  char *port = argv[optind + 1];
+  int bufsize = atoi(argv[optind + 2]);
+  if (bufsize <= 0) {
+    printf("buffer_size must be positive\n");
+    exit(1);
+  }
   
   int sockfd, n;
   char sendline[bufsize], recvline[bufsize + 1];
-  struct sockaddr_in servaddr;
-
-  memset(&servaddr, 0, sizeof(servaddr));
-  servaddr.sin_family = AF_INET;
-  servaddr.sin_port = htons(port);
+  struct NetAddr servaddr;
 
-  if (inet_pton(AF_INET, ip, &servaddr.sin_addr) < 0) {
-    perror("inet_pton problem");
+  int status = NetResolve(host, port, SOCK_DGRAM, family, &servaddr, 1);
+  if (status < 0) {
+    fprintf(stderr, "%s:%s: %s\n", host, port, gai_strerror(status));
     exit(1);
   }
+
+  if (load.duration > 0) {
+    if (bufsize < (int)sizeof(struct Probe)) {
+      printf("buffer_size must be at least %zu for --load\n", sizeof(struct Probe));
+      exit(1);
+    }
+    load.bufsize = bufsize;
+    RunLoad(&servaddr, &load);
+    return 0;
+  }
   
-  if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+  if ((sockfd = socket(servaddr.ss.ss_family, SOCK_DGRAM, 0)) < 0) {
     perror("socket problem");
     exit(1);
   }
 
+  // Потерянная датаграмма не должна вешать клиента навсегда
+  struct timeval tv = {.tv_sec = load.timeout_ms / 1000,
+                       .tv_usec = load.timeout_ms % 1000 * 1000};
+  if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+    perror("setsockopt SO_RCVTIMEO");
+    exit(1);
+  }
+
   write(1, "Enter string\n", 13);
 
   while ((n = read(0, sendline, bufsize)) > 0) {
-    if (sendto(sockfd, sendline, n, 0, (SADDR *)&servaddr, sizeof(servaddr)) == -1) {
+    if (sendto(sockfd, sendline, n, 0, (SADDR *)&servaddr.ss, servaddr.len) == -1) {
       perror("sendto problem");
       exit(1);
     }
 
-    if (recvfrom(sockfd, recvline, bufsize, 0, NULL, NULL) == -1) {
+    if ((n = recvfrom(sockfd, recvline, bufsize, 0, NULL, NULL)) == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        printf("No reply within %d ms\n", load.timeout_ms);
+        continue;
+      }
       perror("recvfrom problem");
       exit(1);
     }
+    recvline[n] = 0;
 
     printf("REPLY FROM SERVER= %s\n", recvline);
   }
@@ -1,5 +1,10 @@
-#include <arpa/inet.h>
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,54 +13,230 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "netaddr.h"
+#include "pgo.h"
+
 #define SADDR struct sockaddr
 
-int main(int argc, char *argv[]) {
-  if (argc < 3) {
-    printf("Usage: %s <port> <buffer_size>\n", argv[0]);
-    exit(1);
-  }
+#define MAX_BATCH 1024
+#define CACHE_LINE 64
+
+// Счетчики пишет только свой поток: каждый работник на своей кэш-линии,
+// чтобы соседи по SO_REUSEPORT не гоняли ее между ядрами
+struct Worker {
+  int sockfd;
+  int bufsize;
+  int batch;
+  bool verbose;
+  unsigned long long packets;
+  unsigned long long bytes;
+  pthread_t thread;
+} __attribute__((aligned(CACHE_LINE)));
 
-  int port = atoi(argv[1]);
-  int bufsize = atoi(argv[2]);
-  
-  int sockfd, n;
-  char mesg[bufsize], ipadr[16];
-  struct sockaddr_in servaddr;
-  struct sockaddr_in cliaddr;
+// Обычная запись, атомарная лишь для потока, печатающего статистику
+static void Count(unsigned long long *counter, unsigned long long n) {
+  __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
 
-  if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-    perror("socket problem");
+static void LogRequest(const char *mesg, int n, const struct sockaddr_storage *cliaddr) {
+  char peer[NET_ADDRSTRLEN];
+  printf("REQUEST %.*s      FROM %s\n", n, mesg,
+         NetFormat((const SADDR *)cliaddr, peer, sizeof(peer)));
+}
+
+// Исходный цикл: по одному recvfrom и sendto на датаграмму
+static void *ServeSingle(void *arg) {
+  struct Worker *w = arg;
+  char *mesg = malloc(w->bufsize);
+  struct sockaddr_storage cliaddr;
+  if (mesg == NULL) {
+    perror("malloc");
     exit(1);
   }
 
-  memset(&servaddr, 0, sizeof(servaddr));
-  servaddr.sin_family = AF_INET;
-  servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-  servaddr.sin_port = htons(port);
+  while (1) {
+    socklen_t len = sizeof(cliaddr);
+    int n = recvfrom(w->sockfd, mesg, w->bufsize, 0, (SADDR *)&cliaddr, &len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("recvfrom");
+      exit(1);
+    }
 
-  if (bind(sockfd, (SADDR *)&servaddr, sizeof(servaddr)) < 0) {
-    perror("bind problem");
+    if (w->verbose) LogRequest(mesg, n, &cliaddr);
+
+    // Клиент мог уже закрыть сокет - это не повод останавливать сервер
+    if (sendto(w->sockfd, mesg, n, 0, (SADDR *)&cliaddr, len) < 0)
+      perror("sendto");
+    Count(&w->packets, 1);
+    Count(&w->bytes, n);
+  }
+  return NULL;
+}
+
+// Пакетный цикл: recvmmsg забирает все, что накопилось (до batch), и
+// тот же массив заголовков уходит обратно одним sendmmsg
+static void *ServeBatched(void *arg) {
+  struct Worker *w = arg;
+  int batch = w->batch;
+  struct mmsghdr *msgs = calloc(batch, sizeof(struct mmsghdr));
+  struct iovec *iovs = calloc(batch, sizeof(struct iovec));
+  struct sockaddr_storage *addrs = calloc(batch, sizeof(struct sockaddr_storage));
+  char *buffers = malloc((size_t)batch * w->bufsize);
+  if (msgs == NULL || iovs == NULL || addrs == NULL || buffers == NULL) {
+    perror("malloc");
     exit(1);
   }
-  printf("SERVER starts...\n");
 
   while (1) {
-    unsigned int len = sizeof(cliaddr);
+    for (int i = 0; i < batch; i++) {
+      iovs[i].iov_base = buffers + (size_t)i * w->bufsize;
+      iovs[i].iov_len = w->bufsize;
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
 
-    if ((n = recvfrom(sockfd, mesg, bufsize, 0, (SADDR *)&cliaddr, &len)) < 0) {
-      perror("recvfrom");
+    // MSG_WAITFORONE: ждем только первую датаграмму, остальные - если есть
+    int n = recvmmsg(w->sockfd, msgs, batch, MSG_WAITFORONE, NULL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("recvmmsg");
       exit(1);
     }
-    mesg[n] = 0;
 
-    printf("REQUEST %s      FROM %s : %d\n", mesg,
-           inet_ntop(AF_INET, (void *)&cliaddr.sin_addr.s_addr, ipadr, 16),
-           ntohs(cliaddr.sin_port));
+    unsigned long long bytes = 0;
+    for (int i = 0; i < n; i++) {
+      iovs[i].iov_len = msgs[i].msg_len;
+      bytes += msgs[i].msg_len;
+      if (w->verbose) LogRequest(iovs[i].iov_base, msgs[i].msg_len, &addrs[i]);
+    }
 
-    if (sendto(sockfd, mesg, n, 0, (SADDR *)&cliaddr, len) < 0) {
-      perror("sendto");
+    int sent = 0;
+    while (sent < n) {
+      int m = sendmmsg(w->sockfd, msgs + sent, n - sent, 0);
+      if (m < 0) {
+        if (errno == EINTR) continue;
+        // Датаграмма недоставима - пропускаем ее, остальные отправляем
+        perror("sendmmsg");
+        sent++;
+        continue;
+      }
+      sent += m;
+    }
+    Count(&w->packets, n);
+    Count(&w->bytes, bytes);
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  int batch = 1;
+  int workers = 1;
+  bool verbose = false;
+  int family = NET_ANY;
+  int busy_poll = 0;
+
+  while (1) {
+    static struct option options[] = {{"batch", required_argument, 0, 0},
+                                      {"workers", required_argument, 0, 0},
+                                      {"verbose", no_argument, 0, 0},
+                                      {"family", required_argument, 0, 0},
+                                      {"busy-poll", required_argument, 0, 0},
+                                      {0, 0, 0, 0}};
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1) break;
+
+    switch (c) {
+      case 0:
+        switch (option_index) {
+          case 0:
+            batch = atoi(optarg);
+            break;
+          case 1:
+            workers = atoi(optarg);
+            break;
+          case 2:
+            verbose = true;
+            break;
+          case 3:
+            family = NetParseFamily(optarg);
+            break;
+          case 4:
+            busy_poll = atoi(optarg);
+            break;
+        }
+        break;
+      default:
+        exit(1);
+    }
+  }
+
+  if (argc - optind < 2 || batch < 1 || batch > MAX_BATCH || workers < 1 || family < 0 ||
+      busy_poll < 0) {
+    printf("Usage: %s <port> <buffer_size> [--batch 1..%d] [--workers <n>] "
+           "[--verbose]\n"
+           "       [--family any|ipv4|ipv6] [--busy-poll <us>]\n",
+           argv[0], MAX_BATCH);
+    exit(1);
+  }
+
+  const char *port = argv[optind];
+  int bufsize = atoi(argv[optind + 1]);
+  if (bufsize <= 0) {
+    printf("buffer_size must be positive\n");
+    exit(1);
+  }
+
+  PgoDumpOnSignal();
+
+  // У каждого потока свой сокет на том же порту: ядро распределяет
+  // датаграммы по хешу адреса клиента, и потоки не делят очередь
+  struct Worker *pool = aligned_alloc(CACHE_LINE, workers * sizeof(struct Worker));
+  if (pool == NULL) {
+    perror("aligned_alloc");
+    exit(1);
+  }
+  memset(pool, 0, workers * sizeof(struct Worker));
+  for (int i = 0; i < workers; i++) {
+    int sockfd = NetListen(NULL, port, SOCK_DGRAM, family, 0, workers > 1 ? NET_REUSEPORT : 0);
+    if (sockfd < 0) exit(1);
+    // Опрос очереди устройства вместо сна в recvmmsg: меньше задержка
+    // ценой занятого процессора
+    if (busy_poll > 0 && NetTune(sockfd, NET_BUSY_POLL, busy_poll) < 0)
+      perror("setsockopt SO_BUSY_POLL");
+    pool[i].sockfd = sockfd;
+    pool[i].bufsize = bufsize;
+    pool[i].batch = batch;
+    pool[i].verbose = verbose;
+  }
+  printf("SERVER starts... (batch %d, workers %d)\n", batch, workers);
+  fflush(stdout);
+
+  for (int i = 0; i < workers; i++) {
+    if (pthread_create(&pool[i].thread, NULL, batch > 1 ? ServeBatched : ServeSingle,
+                       &pool[i]) != 0) {
+      perror("pthread_create");
       exit(1);
     }
   }
+
+  // Раз в секунду - сколько датаграмм обработано всеми потоками
+  unsigned long long last_packets = 0, last_bytes = 0;
+  while (1) {
+    sleep(1);
+    unsigned long long packets = 0, bytes = 0;
+    for (int i = 0; i < workers; i++) {
+      packets += __atomic_load_n(&pool[i].packets, __ATOMIC_RELAXED);
+      bytes += __atomic_load_n(&pool[i].bytes, __ATOMIC_RELAXED);
+    }
+    if (packets != last_packets)
+      fprintf(stderr, "%llu packets/s echoed, %.1f MB/s\n", packets - last_packets,
+              (bytes - last_bytes) / 1e6);
+    last_packets = packets;
+    last_bytes = bytes;
+  }
 }
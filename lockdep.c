@@ -0,0 +1,415 @@
+#define _GNU_SOURCE
+#ifndef LOCKDEP
+#define LOCKDEP
+#endif
+#define LOCKDEP_IMPL
+
+#include "lockdep.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define LOCKDEP_MAX_LOCKS 4096 /* степень двойки */
+#define LOCKDEP_MAX_HELD 32
+#define LOCKDEP_MAX_THREADS 1024
+
+// Ребро графа: кто-то захватил to, удерживая from
+struct Edge {
+  int to;
+  pid_t tid;
+  const char *file; /* где захвачена to */
+  int line;
+  const char *held_file; /* где была захвачена from */
+  int held_line;
+};
+
+struct LockNode {
+  const void *addr;
+  const char *name;
+  struct Edge *edges;
+  int nedges;
+  int cap;
+};
+
+struct HeldLock {
+  int node;
+  const char *file;
+  int line;
+};
+
+struct ThreadState {
+  pid_t tid;
+  int nheld;
+  struct HeldLock held[LOCKDEP_MAX_HELD];
+  int waiting; /* узел, который поток ждет, или -1 */
+  const char *wait_file;
+  int wait_line;
+};
+
+// Весь граф и состояния потоков защищены одним настоящим мьютексом:
+// детектор - отладочный режим, и простота здесь важнее скорости
+static pthread_mutex_t graph_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct LockNode nodes[LOCKDEP_MAX_LOCKS];
+static int nnodes;
+static int table[LOCKDEP_MAX_LOCKS]; /* адрес -> узел + 1, 0 - пусто */
+static struct ThreadState *threads[LOCKDEP_MAX_THREADS];
+static int nthreads;
+
+static pthread_once_t config_once = PTHREAD_ONCE_INIT;
+static int abort_on_report;
+static long timeout_ms;
+
+static __thread struct ThreadState *self;
+static pthread_key_t self_key;
+
+// Поиск в глубину: пометки и родители для восстановления пути
+static int visit_mark[LOCKDEP_MAX_LOCKS];
+static int visit_parent[LOCKDEP_MAX_LOCKS];
+static int visit_edge[LOCKDEP_MAX_LOCKS];
+static int visit_epoch;
+static int dfs_stack[LOCKDEP_MAX_LOCKS];
+
+// Завершившийся поток убирается из списка, чтобы не занимать места
+static void ForgetThread(void *arg) {
+  struct ThreadState *ts = arg;
+  pthread_mutex_lock(&graph_mutex);
+  for (int t = 0; t < nthreads; t++) {
+    if (threads[t] == ts) {
+      threads[t] = threads[--nthreads];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&graph_mutex);
+  free(ts);
+}
+
+static void ReadConfig(void) {
+  pthread_key_create(&self_key, ForgetThread);
+  const char *value = getenv("LOCKDEP_ABORT");
+  abort_on_report = value != NULL && atoi(value) != 0;
+  value = getenv("LOCKDEP_TIMEOUT_MS");
+  timeout_ms = value != NULL ? atol(value) : 0;
+}
+
+// Вызывается под graph_mutex
+static struct ThreadState *Self(void) {
+  if (self == NULL) {
+    pthread_once(&config_once, ReadConfig);
+    self = calloc(1, sizeof(struct ThreadState));
+    if (self == NULL) abort();
+    self->tid = (pid_t)syscall(SYS_gettid);
+    self->waiting = -1;
+    pthread_setspecific(self_key, self);
+    if (nthreads < LOCKDEP_MAX_THREADS) threads[nthreads++] = self;
+  }
+  return self;
+}
+
+static const char *Basename(const char *path) {
+  const char *slash = strrchr(path, '/');
+  return slash != NULL ? slash + 1 : path;
+}
+
+// Узел для адреса; name запоминается при первом появлении блокировки
+static int NodeFor(const void *addr, const char *name) {
+  uint64_t hash = (uint64_t)(uintptr_t)addr * 0x9E3779B97F4A7C15ull;
+  unsigned slot = (unsigned)(hash >> 52) & (LOCKDEP_MAX_LOCKS - 1);
+  while (table[slot] != 0) {
+    if (nodes[table[slot] - 1].addr == addr) return table[slot] - 1;
+    slot = (slot + 1) & (LOCKDEP_MAX_LOCKS - 1);
+  }
+  if (nnodes == LOCKDEP_MAX_LOCKS - 1) {
+    fprintf(stderr, "lockdep: too many locks, tracking disabled for %s\n", name);
+    return -1;
+  }
+  nodes[nnodes].addr = addr;
+  nodes[nnodes].name = name;
+  table[slot] = ++nnodes;
+  return nnodes - 1;
+}
+
+static struct Edge *FindEdge(int from, int to) {
+  for (int i = 0; i < nodes[from].nedges; i++) {
+    if (nodes[from].edges[i].to == to) return &nodes[from].edges[i];
+  }
+  return NULL;
+}
+
+// Есть ли путь from -> ... -> to; при успехе visit_parent хранит путь
+static int Reachable(int from, int to) {
+  int top = 0;
+  visit_epoch++;
+  visit_mark[from] = visit_epoch;
+  visit_parent[from] = -1;
+  dfs_stack[top++] = from;
+  while (top > 0) {
+    int node = dfs_stack[--top];
+    if (node == to) return 1;
+    for (int i = 0; i < nodes[node].nedges; i++) {
+      int next = nodes[node].edges[i].to;
+      if (visit_mark[next] == visit_epoch) continue;
+      visit_mark[next] = visit_epoch;
+      visit_parent[next] = node;
+      visit_edge[next] = i;
+      dfs_stack[top++] = next;
+    }
+  }
+  return 0;
+}
+
+static void PrintEdge(int from, const struct Edge *edge) {
+  fprintf(stderr, "    %s -> %s: thread %d took it at %s:%d, holding since %s:%d\n",
+          nodes[from].name, nodes[edge->to].name, (int)edge->tid,
+          Basename(edge->file), edge->line, Basename(edge->held_file),
+          edge->held_line);
+}
+
+static void DumpThreadsLocked(void) {
+  for (int t = 0; t < nthreads; t++) {
+    struct ThreadState *ts = threads[t];
+    if (ts->nheld == 0 && ts->waiting < 0) continue;
+    fprintf(stderr, "  thread %d", (int)ts->tid);
+    if (ts->waiting >= 0)
+      fprintf(stderr, " waits for %s at %s:%d", nodes[ts->waiting].name,
+              Basename(ts->wait_file), ts->wait_line);
+    fprintf(stderr, "\n");
+    for (int i = 0; i < ts->nheld; i++)
+      fprintf(stderr, "    holds %s (taken at %s:%d)\n",
+              nodes[ts->held[i].node].name, Basename(ts->held[i].file),
+              ts->held[i].line);
+  }
+}
+
+// Новое ребро held -> node замыкает цикл node -> ... -> held
+static void ReportCycle(struct ThreadState *ts, const struct HeldLock *held,
+                        int node, const char *file, int line) {
+  fprintf(stderr,
+          "lockdep: lock order inversion\n"
+          "  thread %d takes %s at %s:%d while holding %s (taken at %s:%d)\n"
+          "  but the opposite order was already seen:\n",
+          (int)ts->tid, nodes[node].name, Basename(file), line,
+          nodes[held->node].name, Basename(held->file), held->line);
+
+  // Путь восстанавливается с конца, печатаем с начала
+  int path[LOCKDEP_MAX_LOCKS];
+  int len = 0;
+  for (int n = held->node; n != node; n = visit_parent[n]) path[len++] = n;
+  for (int i = len - 1; i >= 0; i--) {
+    int to = path[i];
+    int from = visit_parent[to];
+    PrintEdge(from, &nodes[from].edges[visit_edge[to]]);
+  }
+  fprintf(stderr, "  current lock state:\n");
+  DumpThreadsLocked();
+}
+
+static void AddEdge(int from, int to, pid_t tid, const char *file, int line,
+                    const struct HeldLock *held) {
+  struct LockNode *n = &nodes[from];
+  if (n->nedges == n->cap) {
+    n->cap = n->cap ? n->cap * 2 : 4;
+    n->edges = realloc(n->edges, n->cap * sizeof(struct Edge));
+    if (n->edges == NULL) abort();
+  }
+  struct Edge *e = &n->edges[n->nedges++];
+  e->to = to;
+  e->tid = tid;
+  e->file = file;
+  e->line = line;
+  e->held_file = held->file;
+  e->held_line = held->line;
+}
+
+// Перед блокирующим захватом: проверить и дополнить граф порядка
+static int BeforeAcquire(const void *addr, const char *name, const char *file,
+                         int line) {
+  pthread_once(&config_once, ReadConfig);
+  int reported = 0;
+
+  pthread_mutex_lock(&graph_mutex);
+  struct ThreadState *ts = Self();
+  int node = NodeFor(addr, name);
+  if (node >= 0) {
+    ts->waiting = node;
+    ts->wait_file = file;
+    ts->wait_line = line;
+    for (int i = 0; i < ts->nheld; i++) {
+      int from = ts->held[i].node;
+      if (from == node || FindEdge(from, node) != NULL) continue;
+      if (Reachable(node, from)) {
+        ReportCycle(ts, &ts->held[i], node, file, line);
+        reported = 1;
+      }
+      // Ребро добавляется и при цикле, чтобы не сообщать о нем повторно
+      AddEdge(from, node, ts->tid, file, line, &ts->held[i]);
+    }
+  }
+  pthread_mutex_unlock(&graph_mutex);
+
+  if (reported && abort_on_report) abort();
+  return node;
+}
+
+static void AfterAcquire(int node, const char *file, int line) {
+  pthread_mutex_lock(&graph_mutex);
+  struct ThreadState *ts = Self();
+  ts->waiting = -1;
+  if (node >= 0 && ts->nheld < LOCKDEP_MAX_HELD) {
+    ts->held[ts->nheld].node = node;
+    ts->held[ts->nheld].file = file;
+    ts->held[ts->nheld].line = line;
+    ts->nheld++;
+  }
+  pthread_mutex_unlock(&graph_mutex);
+}
+
+static void AcquireFailed(void) {
+  pthread_mutex_lock(&graph_mutex);
+  Self()->waiting = -1;
+  pthread_mutex_unlock(&graph_mutex);
+}
+
+// Блокировки не обязаны отпускаться в обратном порядке
+static void Release(const void *addr) {
+  pthread_mutex_lock(&graph_mutex);
+  struct ThreadState *ts = Self();
+  for (int i = ts->nheld - 1; i >= 0; i--) {
+    if (nodes[ts->held[i].node].addr != addr) continue;
+    memmove(&ts->held[i], &ts->held[i + 1],
+            (ts->nheld - i - 1) * sizeof(struct HeldLock));
+    ts->nheld--;
+    break;
+  }
+  pthread_mutex_unlock(&graph_mutex);
+}
+
+static void TimedOut(const char *what, const char *file, int line, long ms) {
+  pthread_mutex_lock(&graph_mutex);
+  fprintf(stderr, "lockdep: thread %d gave up waiting for %s at %s:%d",
+          (int)Self()->tid, what, Basename(file), line);
+  if (ms > 0) fprintf(stderr, " after %ld ms", ms);
+  fprintf(stderr, "\n");
+  DumpThreadsLocked();
+  pthread_mutex_unlock(&graph_mutex);
+}
+
+int LockdepMutexLock(pthread_mutex_t *mutex, const char *name,
+                     const char *file, int line) {
+  int node = BeforeAcquire(mutex, name, file, line);
+  int ret;
+  if (timeout_ms > 0) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    ret = pthread_mutex_timedlock(mutex, &deadline);
+    if (ret == ETIMEDOUT) {
+      TimedOut(name, file, line, timeout_ms);
+      abort();
+    }
+  } else {
+    ret = pthread_mutex_lock(mutex);
+  }
+  if (ret == 0)
+    AfterAcquire(node, file, line);
+  else
+    AcquireFailed();
+  return ret;
+}
+
+// trylock не ждет, поэтому взаимной блокировки создать не может:
+// ребра не добавляются, но блокировка учитывается как удерживаемая
+int LockdepMutexTrylock(pthread_mutex_t *mutex, const char *name,
+                        const char *file, int line) {
+  int ret = pthread_mutex_trylock(mutex);
+  if (ret == 0) {
+    pthread_once(&config_once, ReadConfig);
+    pthread_mutex_lock(&graph_mutex);
+    int node = NodeFor(mutex, name);
+    pthread_mutex_unlock(&graph_mutex);
+    AfterAcquire(node, file, line);
+  }
+  return ret;
+}
+
+int LockdepMutexTimedlock(pthread_mutex_t *mutex,
+                          const struct timespec *abstime, const char *name,
+                          const char *file, int line) {
+  int node = BeforeAcquire(mutex, name, file, line);
+  int ret = pthread_mutex_timedlock(mutex, abstime);
+  if (ret == 0) {
+    AfterAcquire(node, file, line);
+    return 0;
+  }
+  if (ret == ETIMEDOUT) {
+    TimedOut(name, file, line, 0);
+    if (abort_on_report) abort();
+  }
+  AcquireFailed();
+  return ret;
+}
+
+int LockdepMutexUnlock(pthread_mutex_t *mutex) {
+  Release(mutex);
+  return pthread_mutex_unlock(mutex);
+}
+
+// На время ожидания условия мьютекс отпущен
+int LockdepCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                    const char *file, int line) {
+  pthread_mutex_lock(&graph_mutex);
+  int node = NodeFor(mutex, "mutex");
+  pthread_mutex_unlock(&graph_mutex);
+  Release(mutex);
+  int ret = pthread_cond_wait(cond, mutex);
+  AfterAcquire(node, file, line);
+  return ret;
+}
+
+int LockdepCondTimedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                         const struct timespec *abstime, const char *file,
+                         int line) {
+  pthread_mutex_lock(&graph_mutex);
+  int node = NodeFor(mutex, "mutex");
+  pthread_mutex_unlock(&graph_mutex);
+  Release(mutex);
+  int ret = pthread_cond_timedwait(cond, mutex, abstime);
+  AfterAcquire(node, file, line);
+  return ret;
+}
+
+// Семафор учитывается как блокировка того, кто его дождался
+int LockdepSemWait(sem_t *sem, const char *name, const char *file, int line) {
+  int node = BeforeAcquire(sem, name, file, line);
+  int ret = sem_wait(sem);
+  if (ret == 0)
+    AfterAcquire(node, file, line);
+  else
+    AcquireFailed();
+  return ret;
+}
+
+int LockdepSemPost(sem_t *sem) {
+  Release(sem);
+  return sem_post(sem);
+}
+
+void LockdepDump(void) {
+  pthread_mutex_lock(&graph_mutex);
+  fprintf(stderr, "lockdep: %d locks, order graph:\n", nnodes);
+  for (int n = 0; n < nnodes; n++) {
+    for (int i = 0; i < nodes[n].nedges; i++) PrintEdge(n, &nodes[n].edges[i]);
+  }
+  fprintf(stderr, "lockdep: held locks:\n");
+  DumpThreadsLocked();
+  pthread_mutex_unlock(&graph_mutex);
+}
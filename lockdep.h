@@ -0,0 +1,61 @@
+#ifndef LOCKDEP_H
+#define LOCKDEP_H
+
+/*
+ * Детектор нарушений порядка захвата блокировок.
+ *
+ * Подключается после <pthread.h>/<semaphore.h>. Без -DLOCKDEP заголовок
+ * пуст, и программа вызывает pthread напрямую. С -DLOCKDEP вызовы
+ * pthread_mutex_*, pthread_cond_*wait и sem_wait/sem_post подменяются
+ * обертками из lockdep.c: они строят граф "захвачено A, затем B" и при
+ * появлении цикла печатают замешанные блокировки, потоки и места в коде.
+ *
+ * Переменные окружения:
+ *   LOCKDEP_ABORT=1       - abort() сразу после отчета о цикле или
+ *                           после истекшего pthread_mutex_timedlock;
+ *   LOCKDEP_TIMEOUT_MS=N  - pthread_mutex_lock ждет не дольше N мс, затем
+ *                           печатает, кто что держит и ждет, и abort().
+ */
+
+#ifdef LOCKDEP
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+int LockdepMutexLock(pthread_mutex_t *mutex, const char *name,
+                     const char *file, int line);
+int LockdepMutexTrylock(pthread_mutex_t *mutex, const char *name,
+                        const char *file, int line);
+int LockdepMutexTimedlock(pthread_mutex_t *mutex,
+                          const struct timespec *abstime, const char *name,
+                          const char *file, int line);
+int LockdepMutexUnlock(pthread_mutex_t *mutex);
+int LockdepCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                    const char *file, int line);
+int LockdepCondTimedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                         const struct timespec *abstime, const char *file,
+                         int line);
+int LockdepSemWait(sem_t *sem, const char *name, const char *file, int line);
+int LockdepSemPost(sem_t *sem);
+
+/* Печатает граф порядка и блокировки, удерживаемые каждым потоком. */
+void LockdepDump(void);
+
+#ifndef LOCKDEP_IMPL
+#define pthread_mutex_lock(m) LockdepMutexLock((m), #m, __FILE__, __LINE__)
+#define pthread_mutex_trylock(m) \
+  LockdepMutexTrylock((m), #m, __FILE__, __LINE__)
+#define pthread_mutex_timedlock(m, t) \
+  LockdepMutexTimedlock((m), (t), #m, __FILE__, __LINE__)
+#define pthread_mutex_unlock(m) LockdepMutexUnlock(m)
+#define pthread_cond_wait(c, m) LockdepCondWait((c), (m), __FILE__, __LINE__)
+#define pthread_cond_timedwait(c, m, t) \
+  LockdepCondTimedwait((c), (m), (t), __FILE__, __LINE__)
+#define sem_wait(s) LockdepSemWait((s), #s, __FILE__, __LINE__)
+#define sem_post(s) LockdepSemPost(s)
+#endif
+
+#endif /* LOCKDEP */
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef LOCKPROF
+#define LOCKPROF
+#endif
+#define LOCKPROF_IMPL
+
+#include "lockprof.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LOCKPROF_TSC 1
+#endif
+
+#define LOCKPROF_SLOTS 64 /* блокировок на поток, степень двойки */
+#define LOCKPROF_GLOBAL_SLOTS 1024
+#define LOCKPROF_MAX_HELD 32
+#define LOCKPROF_BUCKETS 64 /* корзина i: значения [2^(i-1), 2^i) тиков */
+
+struct LockStats {
+  const void *addr;
+  const char *name;
+  uint64_t acquired;
+  uint64_t contended;
+  uint64_t wait_total;
+  uint64_t wait_max;
+  uint64_t hold_total;
+  uint64_t hold_max;
+  uint64_t holds;
+  uint32_t wait_hist[LOCKPROF_BUCKETS];
+  uint32_t hold_hist[LOCKPROF_BUCKETS];
+};
+
+struct HeldLock {
+  const void *addr;
+  struct LockStats *stats;
+  uint64_t since;
+};
+
+struct ThreadProfile {
+  struct LockStats slots[LOCKPROF_SLOTS];
+  struct HeldLock held[LOCKPROF_MAX_HELD];
+  int nheld;
+  uint64_t dropped;
+};
+
+static pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct LockStats global[LOCKPROF_GLOBAL_SLOTS];
+static uint64_t global_dropped;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static pthread_key_t profile_key;
+static uint64_t start_ticks;
+static struct timespec start_time;
+
+static __thread struct ThreadProfile *profile;
+
+static inline uint64_t Ticks(void) {
+#ifdef LOCKPROF_TSC
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Значения от 2^63 попадают в последнюю корзину
+static inline int Bucket(uint64_t value) {
+  int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+  return bucket < LOCKPROF_BUCKETS ? bucket : LOCKPROF_BUCKETS - 1;
+}
+
+// TSC разных ядер может расходиться: при переезде потока конец
+// получается раньше начала, такой интервал считаем нулевым
+static inline uint64_t Elapsed(uint64_t start, uint64_t end) {
+  return end > start ? end - start : 0;
+}
+
+static struct LockStats *FindSlot(struct LockStats *table, unsigned size,
+                                  const void *addr, const char *name) {
+  uint64_t hash = (uint64_t)(uintptr_t)addr * 0x9E3779B97F4A7C15ull;
+  unsigned slot = (unsigned)(hash >> 40) & (size - 1);
+  for (unsigned probe = 0; probe < size; probe++) {
+    struct LockStats *s = &table[slot];
+    if (s->addr == addr) return s;
+    if (s->addr == NULL) {
+      s->addr = addr;
+      s->name = name;
+      return s;
+    }
+    slot = (slot + 1) & (size - 1);
+  }
+  return NULL;
+}
+
+static void MergeStats(struct LockStats *dst, const struct LockStats *src) {
+  dst->acquired += src->acquired;
+  dst->contended += src->contended;
+  dst->wait_total += src->wait_total;
+  dst->hold_total += src->hold_total;
+  dst->holds += src->holds;
+  if (src->wait_max > dst->wait_max) dst->wait_max = src->wait_max;
+  if (src->hold_max > dst->hold_max) dst->hold_max = src->hold_max;
+  for (int i = 0; i < LOCKPROF_BUCKETS; i++) {
+    dst->wait_hist[i] += src->wait_hist[i];
+    dst->hold_hist[i] += src->hold_hist[i];
+  }
+}
+
+// Данные потока сливаются в общую таблицу один раз - при его завершении
+static void MergeProfile(struct ThreadProfile *p) {
+  pthread_mutex_lock(&global_mutex);
+  for (int i = 0; i < LOCKPROF_SLOTS; i++) {
+    if (p->slots[i].addr == NULL) continue;
+    struct LockStats *dst = FindSlot(global, LOCKPROF_GLOBAL_SLOTS,
+                                     p->slots[i].addr, p->slots[i].name);
+    if (dst != NULL)
+      MergeStats(dst, &p->slots[i]);
+    else
+      global_dropped += p->slots[i].acquired;
+  }
+  global_dropped += p->dropped;
+  pthread_mutex_unlock(&global_mutex);
+}
+
+static void ThreadExit(void *arg) {
+  MergeProfile(arg);
+  free(arg);
+}
+
+static void Init(void) {
+  pthread_key_create(&profile_key, ThreadExit);
+  start_ticks = Ticks();
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  atexit(LockprofReport);
+}
+
+static struct ThreadProfile *Profile(void) {
+  if (profile == NULL) {
+    pthread_once(&init_once, Init);
+    profile = calloc(1, sizeof(struct ThreadProfile));
+    if (profile == NULL) abort();
+    pthread_setspecific(profile_key, profile);
+  }
+  return profile;
+}
+
+static void Acquired(struct ThreadProfile *p, const void *addr,
+                     const char *name, uint64_t start, int contended) {
+  uint64_t now = Ticks();
+  struct LockStats *s = FindSlot(p->slots, LOCKPROF_SLOTS, addr, name);
+  if (s == NULL) {
+    p->dropped++;
+  } else {
+    uint64_t wait = Elapsed(start, now);
+    s->acquired++;
+    s->contended += contended;
+    s->wait_total += wait;
+    if (wait > s->wait_max) s->wait_max = wait;
+    s->wait_hist[Bucket(wait)]++;
+  }
+  if (p->nheld < LOCKPROF_MAX_HELD) {
+    p->held[p->nheld].addr = addr;
+    p->held[p->nheld].stats = s;
+    p->held[p->nheld].since = now;
+    p->nheld++;
+  }
+}
+
+// Время удержания учитывается, только если отпускает тот же поток
+static void Released(const void *addr) {
+  struct ThreadProfile *p = profile;
+  if (p == NULL) return;
+  for (int i = p->nheld - 1; i >= 0; i--) {
+    if (p->held[i].addr != addr) continue;
+    struct LockStats *s = p->held[i].stats;
+    if (s != NULL) {
+      uint64_t hold = Elapsed(p->held[i].since, Ticks());
+      s->holds++;
+      s->hold_total += hold;
+      if (hold > s->hold_max) s->hold_max = hold;
+      s->hold_hist[Bucket(hold)]++;
+    }
+    p->held[i] = p->held[--p->nheld];
+    return;
+  }
+}
+
+int LockprofMutexLock(pthread_mutex_t *mutex, const char *name) {
+  struct ThreadProfile *p = Profile();
+  uint64_t start = Ticks();
+  // Неудачный trylock отличает ожидание от свободного захвата
+  int ret = pthread_mutex_trylock(mutex);
+  int contended = ret == EBUSY;
+  if (contended) ret = pthread_mutex_lock(mutex);
+  if (ret == 0) Acquired(p, mutex, name, start, contended);
+  return ret;
+}
+
+int LockprofMutexTrylock(pthread_mutex_t *mutex, const char *name) {
+  struct ThreadProfile *p = Profile();
+  uint64_t start = Ticks();
+  int ret = pthread_mutex_trylock(mutex);
+  if (ret == 0) Acquired(p, mutex, name, start, 0);
+  return ret;
+}
+
+int LockprofMutexTimedlock(pthread_mutex_t *mutex,
+                           const struct timespec *abstime, const char *name) {
+  struct ThreadProfile *p = Profile();
+  uint64_t start = Ticks();
+  int ret = pthread_mutex_trylock(mutex);
+  int contended = ret == EBUSY;
+  if (contended) ret = pthread_mutex_timedlock(mutex, abstime);
+  if (ret == 0) Acquired(p, mutex, name, start, contended);
+  return ret;
+}
+
+int LockprofMutexUnlock(pthread_mutex_t *mutex) {
+  Released(mutex);
+  return pthread_mutex_unlock(mutex);
+}
+
+// Ожидание условия разрывает удержание на два интервала
+int LockprofCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+  struct ThreadProfile *p = Profile();
+  Released(mutex);
+  int ret = pthread_cond_wait(cond, mutex);
+  Acquired(p, mutex, "mutex", Ticks(), 0);
+  return ret;
+}
+
+int LockprofCondTimedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                          const struct timespec *abstime) {
+  struct ThreadProfile *p = Profile();
+  Released(mutex);
+  int ret = pthread_cond_timedwait(cond, mutex, abstime);
+  Acquired(p, mutex, "mutex", Ticks(), 0);
+  return ret;
+}
+
+int LockprofSemWait(sem_t *sem, const char *name) {
+  struct ThreadProfile *p = Profile();
+  uint64_t start = Ticks();
+  int ret = sem_trywait(sem);
+  int contended = ret != 0 && errno == EAGAIN;
+  if (contended) {
+    while ((ret = sem_wait(sem)) != 0 && errno == EINTR) {
+    }
+  }
+  if (ret == 0) Acquired(p, sem, name, start, contended);
+  return ret;
+}
+
+int LockprofSemPost(sem_t *sem) {
+  Released(sem);
+  return sem_post(sem);
+}
+
+// Верхняя граница корзины, в которую попадает заданный перцентиль,
+// но не больше наблюдавшегося максимума
+static uint64_t Percentile(const uint32_t *hist, uint64_t total, uint64_t max,
+                           double pct) {
+  uint64_t rank = (uint64_t)(total * pct / 100.0);
+  uint64_t seen = 0;
+  for (int i = 0; i < LOCKPROF_BUCKETS; i++) {
+    seen += hist[i];
+    if (seen > rank) {
+      uint64_t bound = i == 0 ? 0 : (i >= 63 ? UINT64_MAX : (1ull << i) - 1);
+      return bound < max ? bound : max;
+    }
+  }
+  return max;
+}
+
+static int CompareWait(const void *a, const void *b) {
+  const struct LockStats *x = a, *y = b;
+  if (x->wait_total != y->wait_total) return x->wait_total < y->wait_total ? 1 : -1;
+  return 0;
+}
+
+void LockprofReport(void) {
+  static int reported = 0;
+  if (profile != NULL) {
+    MergeProfile(profile);
+    memset(profile->slots, 0, sizeof(profile->slots));
+    profile->dropped = 0;
+  }
+
+  pthread_mutex_lock(&global_mutex);
+  if (reported++) {
+    pthread_mutex_unlock(&global_mutex);
+    return;
+  }
+
+  // Перевод тиков в наносекунды по длительности всего прогона
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed_ns = (now.tv_sec - start_time.tv_sec) * 1e9 +
+                      (now.tv_nsec - start_time.tv_nsec);
+  uint64_t ticks = Ticks() - start_ticks;
+  double ns_per_tick = ticks > 0 ? elapsed_ns / ticks : 1.0;
+
+  static struct LockStats sorted[LOCKPROF_GLOBAL_SLOTS];
+  int count = 0;
+  for (int i = 0; i < LOCKPROF_GLOBAL_SLOTS; i++) {
+    if (global[i].addr != NULL) sorted[count++] = global[i];
+  }
+  qsort(sorted, count, sizeof(struct LockStats), CompareWait);
+
+  FILE *out = stderr;
+  const char *path = getenv("LOCKPROF_OUT");
+  if (path != NULL && (out = fopen(path, "w")) == NULL) out = stderr;
+
+  fprintf(out, "lockprof: %d locks, times in microseconds, sorted by total wait\n",
+          count);
+  fprintf(out, "%-20s %10s %6s %11s %9s %9s %9s %11s %9s %9s %9s\n", "lock",
+          "acquired", "cont%", "wait total", "wait p50", "wait p99", "wait max",
+          "hold total", "hold p50", "hold p99", "hold max");
+  for (int i = 0; i < count; i++) {
+    struct LockStats *s = &sorted[i];
+    double us = ns_per_tick / 1000.0;
+    fprintf(out,
+            "%-20.20s %10llu %6.1f %11.1f %9.2f %9.2f %9.2f %11.1f %9.2f %9.2f %9.2f\n",
+            s->name, (unsigned long long)s->acquired,
+            s->acquired ? 100.0 * s->contended / s->acquired : 0.0,
+            s->wait_total * us,
+            Percentile(s->wait_hist, s->acquired, s->wait_max, 50) * us,
+            Percentile(s->wait_hist, s->acquired, s->wait_max, 99) * us,
+            s->wait_max * us, s->hold_total * us,
+            Percentile(s->hold_hist, s->holds, s->hold_max, 50) * us,
+            Percentile(s->hold_hist, s->holds, s->hold_max, 99) * us,
+            s->hold_max * us);
+  }
+  if (global_dropped > 0)
+    fprintf(out, "lockprof: %llu acquisitions not tracked (table full)\n",
+            (unsigned long long)global_dropped);
+  if (out != stderr) fclose(out);
+  pthread_mutex_unlock(&global_mutex);
+}
@@ -0,0 +1,54 @@
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+/*
+ * Профилировщик блокировок: сколько потоки ждут захвата и сколько
+ * удерживают каждый мьютекс и семафор.
+ *
+ * Подключается после <pthread.h>/<semaphore.h>. Без -DLOCKPROF заголовок
+ * пуст. С -DLOCKPROF вызовы pthread_mutex_*, pthread_cond_*wait и
+ * sem_wait/sem_post подменяются обертками из lockprof.c. Времена
+ * снимаются rdtsc (на x86) или CLOCK_MONOTONIC и копятся в гистограммах
+ * каждого потока без общих блокировок; при выходе потока они сливаются
+ * в общую таблицу, а при выходе из программы в stderr печатается отчет
+ * (или в файл из LOCKPROF_OUT).
+ */
+
+#ifdef LOCKPROF
+
+#ifdef LOCKDEP
+#error "LOCKDEP and LOCKPROF wrap the same calls, enable only one of them"
+#endif
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+int LockprofMutexLock(pthread_mutex_t *mutex, const char *name);
+int LockprofMutexTrylock(pthread_mutex_t *mutex, const char *name);
+int LockprofMutexTimedlock(pthread_mutex_t *mutex,
+                           const struct timespec *abstime, const char *name);
+int LockprofMutexUnlock(pthread_mutex_t *mutex);
+int LockprofCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+int LockprofCondTimedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                          const struct timespec *abstime);
+int LockprofSemWait(sem_t *sem, const char *name);
+int LockprofSemPost(sem_t *sem);
+
+/* Печатает отчет сразу; вызывается и автоматически при exit. */
+void LockprofReport(void);
+
+#ifndef LOCKPROF_IMPL
+#define pthread_mutex_lock(m) LockprofMutexLock((m), #m)
+#define pthread_mutex_trylock(m) LockprofMutexTrylock((m), #m)
+#define pthread_mutex_timedlock(m, t) LockprofMutexTimedlock((m), (t), #m)
+#define pthread_mutex_unlock(m) LockprofMutexUnlock(m)
+#define pthread_cond_wait(c, m) LockprofCondWait((c), (m))
+#define pthread_cond_timedwait(c, m, t) LockprofCondTimedwait((c), (m), (t))
+#define sem_wait(s) LockprofSemWait((s), #s)
+#define sem_post(s) LockprofSemPost(s)
+#endif
+
+#endif /* LOCKPROF */
+
+#endif
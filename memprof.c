@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+#include "memprof.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static FILE *OpenProc(pid_t pid, const char *name) {
+  char path[64];
+  if (pid == 0)
+    snprintf(path, sizeof(path), "/proc/self/%s", name);
+  else
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, name);
+  return fopen(path, "r");
+}
+
+// Строка поля: "Rss:                1408 kB". Возвращает false, если это
+// не поле, а заголовок области
+static bool ParseField(const char *line, struct MemUsage *usage) {
+  const char *colon = strchr(line, ':');
+  const char *space = strchr(line, ' ');
+  if (colon == NULL || (space != NULL && space < colon)) return false;
+
+  size_t key_len = (size_t)(colon - line);
+  uint64_t value = strtoull(colon + 1, NULL, 10);
+#define FIELD(name) (key_len == sizeof(name) - 1 && memcmp(line, name, key_len) == 0)
+  if (FIELD("Size"))
+    usage->size_kb = value;
+  else if (FIELD("Rss"))
+    usage->rss_kb = value;
+  else if (FIELD("Pss"))
+    usage->pss_kb = value;
+  else if (FIELD("Anonymous"))
+    usage->anon_kb = value;
+  else if (FIELD("Swap"))
+    usage->swap_kb = value;
+  else if (FIELD("AnonHugePages") || FIELD("ShmemPmdMapped") || FIELD("FilePmdMapped") ||
+           FIELD("Shared_Hugetlb") || FIELD("Private_Hugetlb"))
+    usage->huge_kb += value;
+#undef FIELD
+  return true;
+}
+
+static void Finish(struct MemUsage *usage) {
+  usage->file_kb = usage->rss_kb > usage->anon_kb ? usage->rss_kb - usage->anon_kb : 0;
+}
+
+int MemprofReadRollup(pid_t pid, struct MemUsage *usage) {
+  FILE *f = OpenProc(pid, "smaps_rollup");
+  if (f == NULL) return -1;
+  memset(usage, 0, sizeof(*usage));
+  char line[512];
+  while (fgets(line, sizeof(line), f) != NULL) ParseField(line, usage);
+  fclose(f);
+  Finish(usage);
+  return 0;
+}
+
+// "7f12a000-7f12c000 rw-p 00000000 00:00 0    /path"
+static void ParseHeader(const char *line, struct MemRegion *region) {
+  memset(region, 0, sizeof(*region));
+  unsigned long long start = 0, end = 0;
+  int path_at = 0;
+  sscanf(line, "%llx-%llx %4s %*s %*s %*s %n", &start, &end, region->perms, &path_at);
+  region->start = start;
+  region->end = end;
+  if (path_at > 0) {
+    const char *path = line + path_at;
+    size_t len = strcspn(path, "\n");
+    if (len >= sizeof(region->path)) len = sizeof(region->path) - 1;
+    memcpy(region->path, path, len);
+    region->path[len] = '\0';
+  }
+}
+
+int MemprofReadRegions(pid_t pid, MemRegionFn fn, void *arg) {
+  FILE *f = OpenProc(pid, "smaps");
+  if (f == NULL) return -1;
+
+  struct MemRegion region;
+  bool have = false;
+  char *line = NULL;
+  size_t cap = 0;
+  while (getline(&line, &cap, f) != -1) {
+    if (ParseField(line, &region.usage)) continue;
+    if (have) {
+      Finish(&region.usage);
+      fn(&region, arg);
+    }
+    ParseHeader(line, &region);
+    have = true;
+  }
+  if (have) {
+    Finish(&region.usage);
+    fn(&region, arg);
+  }
+  free(line);
+  fclose(f);
+  return 0;
+}
+
+struct Phase {
+  char name[32];
+  uint64_t start_rss_kb;
+  uint64_t end_rss_kb;
+  uint64_t peak_rss_kb;
+  uint64_t start_ns;
+  uint64_t elapsed_ns;
+  bool exact;
+};
+
+static struct Phase phases[MEMPROF_MAX_PHASES];
+static int phase_count;
+static bool phase_open;
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// VmRSS и VmHWM из /proc/self/status
+static void ReadStatus(uint64_t *rss_kb, uint64_t *hwm_kb) {
+  *rss_kb = 0;
+  *hwm_kb = 0;
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f == NULL) return;
+  char line[256];
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "VmHWM:", 6) == 0) *hwm_kb = strtoull(line + 6, NULL, 10);
+    if (strncmp(line, "VmRSS:", 6) == 0) *rss_kb = strtoull(line + 6, NULL, 10);
+  }
+  fclose(f);
+}
+
+// "5" в clear_refs приравнивает пик RSS к текущему RSS
+static bool ResetPeak(void) {
+  int fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd == -1) return false;
+  bool ok = write(fd, "5", 1) == 1;
+  close(fd);
+  return ok;
+}
+
+void MemprofPhaseBegin(const char *name) {
+  if (phase_open) MemprofPhaseEnd();
+  if (phase_count == MEMPROF_MAX_PHASES) return;
+
+  struct Phase *phase = &phases[phase_count];
+  memset(phase, 0, sizeof(*phase));
+  snprintf(phase->name, sizeof(phase->name), "%s", name);
+  phase->exact = ResetPeak();
+  uint64_t hwm;
+  ReadStatus(&phase->start_rss_kb, &hwm);
+  phase->start_ns = NowNs();
+  phase_open = true;
+}
+
+void MemprofPhaseEnd(void) {
+  if (!phase_open) return;
+  struct Phase *phase = &phases[phase_count++];
+  phase->elapsed_ns = NowNs() - phase->start_ns;
+  ReadStatus(&phase->end_rss_kb, &phase->peak_rss_kb);
+  phase_open = false;
+}
+
+void MemprofPhaseReport(FILE *out) {
+  if (phase_open) MemprofPhaseEnd();
+  fprintf(out, "%-20s %12s %12s %12s %12s\n", "phase", "start_kb", "end_kb", "peak_kb",
+          "time_ms");
+  for (int i = 0; i < phase_count; i++) {
+    const struct Phase *phase = &phases[i];
+    // Без clear_refs пик - максимум с начала процесса
+    fprintf(out, "%-20s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "%s %11.2f\n", phase->name,
+            phase->start_rss_kb, phase->end_rss_kb, phase->peak_rss_kb,
+            phase->exact ? "" : "*", phase->elapsed_ns / 1e6);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef MEMPROF_H
+#define MEMPROF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Память процесса по /proc/<pid>/smaps и smaps_rollup: сколько страниц
+ * резидентно (RSS), доля с учетом общих страниц (PSS), сколько из них
+ * анонимных, сколько отображено из файлов, сколько в огромных страницах
+ * и в свопе. Все значения в килобайтах; pid 0 - сам вызывающий процесс.
+ *
+ * Вторая часть - пиковая память по фазам внутри самой программы:
+ * MemprofPhaseBegin сбрасывает пик RSS ядра (VmHWM) через
+ * /proc/self/clear_refs, MemprofPhaseEnd снимает его, так что у каждой
+ * фазы свой пик, а не максимум с начала работы.
+ */
+
+struct MemUsage {
+  uint64_t size_kb;   /* виртуальный размер; в rollup не считается */
+  uint64_t rss_kb;
+  uint64_t pss_kb;
+  uint64_t anon_kb;
+  uint64_t file_kb;   /* резидентные страницы файлов и shmem: Rss - Anonymous */
+  uint64_t huge_kb;   /* THP и hugetlbfs */
+  uint64_t swap_kb;
+};
+
+struct MemRegion {
+  uint64_t start;
+  uint64_t end;
+  char perms[5];
+  char path[256];     /* пусто для анонимной памяти, [heap], [stack]... */
+  struct MemUsage usage;
+};
+
+typedef void (*MemRegionFn)(const struct MemRegion *region, void *arg);
+
+/* Итог по всем областям из smaps_rollup; 0 или -1 с errno. */
+int MemprofReadRollup(pid_t pid, struct MemUsage *usage);
+
+/* Разбирает smaps и вызывает fn на каждую область; 0 или -1 с errno. */
+int MemprofReadRegions(pid_t pid, MemRegionFn fn, void *arg);
+
+/* Фазы: не больше MEMPROF_MAX_PHASES, вызовы из одного потока. Фаза
+ * длится до MemprofPhaseEnd или до начала следующей. */
+#define MEMPROF_MAX_PHASES 32
+
+void MemprofPhaseBegin(const char *name);
+void MemprofPhaseEnd(void);
+
+/* Таблица фаз: RSS в начале и в конце, пик, время. */
+void MemprofPhaseReport(FILE *out);
+
+#endif
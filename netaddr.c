@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+
+#include "netaddr.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NET_CACHE_SIZE 32
+#define NET_NAME_MAX 256
+
+// Запись кеша: ключ запроса и ответ на него
+struct CacheEntry {
+  char host[NET_NAME_MAX];
+  char port[32];
+  int socktype;
+  int family;
+  time_t expires;
+  int count;
+  struct NetAddr addrs[NET_MAX_ADDRS];
+};
+
+static struct CacheEntry cache[NET_CACHE_SIZE];
+static int cache_next;
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int NetParseFamily(const char *name) {
+  if (strcmp(name, "any") == 0) return NET_ANY;
+  if (strcmp(name, "ipv4") == 0 || strcmp(name, "4") == 0) return NET_IPV4;
+  if (strcmp(name, "ipv6") == 0 || strcmp(name, "6") == 0) return NET_IPV6;
+  return -1;
+}
+
+static int FamilyToAf(int family) {
+  return family == NET_IPV4 ? AF_INET : family == NET_IPV6 ? AF_INET6 : AF_UNSPEC;
+}
+
+static time_t Seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+static struct CacheEntry *CacheFind(const char *host, const char *port, int socktype,
+                                    int family, time_t now) {
+  for (int i = 0; i < NET_CACHE_SIZE; i++) {
+    struct CacheEntry *e = &cache[i];
+    if (e->count > 0 && e->expires > now && e->socktype == socktype &&
+        e->family == family && strcmp(e->host, host) == 0 && strcmp(e->port, port) == 0)
+      return e;
+  }
+  return NULL;
+}
+
+int NetResolve(const char *host, const char *port, int socktype, int family,
+               struct NetAddr *addrs, int max) {
+  const char *key = host != NULL ? host : "";
+  int cacheable = strlen(key) < NET_NAME_MAX && strlen(port) < sizeof(cache[0].port);
+  time_t now = Seconds();
+
+  if (cacheable) {
+    pthread_mutex_lock(&cache_mutex);
+    struct CacheEntry *e = CacheFind(key, port, socktype, family, now);
+    if (e != NULL) {
+      int n = e->count < max ? e->count : max;
+      memcpy(addrs, e->addrs, n * sizeof(struct NetAddr));
+      pthread_mutex_unlock(&cache_mutex);
+      return n;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+  }
+
+  struct addrinfo hints, *res, *ai;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = FamilyToAf(family);
+  hints.ai_socktype = socktype;
+  // Без узла - адрес для bind; с узлом - только семейства, которые
+  // настроены на машине (на чисто IPv6-сети не пробуем IPv4)
+  hints.ai_flags = host == NULL ? AI_PASSIVE : AI_ADDRCONFIG;
+
+  int status = getaddrinfo(host, port, &hints, &res);
+  // AI_ADDRCONFIG не считает loopback: на машине без внешних адресов
+  // "localhost" иначе не разрешается
+  if (status == EAI_NONAME || status == EAI_ADDRFAMILY) {
+    hints.ai_flags &= ~AI_ADDRCONFIG;
+    status = getaddrinfo(host, port, &hints, &res);
+  }
+  if (status != 0) return status < 0 ? status : -status;
+
+  struct NetAddr found[NET_MAX_ADDRS];
+  int count = 0;
+  for (ai = res; ai != NULL && count < NET_MAX_ADDRS; ai = ai->ai_next) {
+    if (ai->ai_addrlen > sizeof(found[0].ss)) continue;
+    memcpy(&found[count].ss, ai->ai_addr, ai->ai_addrlen);
+    found[count].len = ai->ai_addrlen;
+    count++;
+  }
+  freeaddrinfo(res);
+  if (count == 0) return EAI_NONAME;
+
+  if (cacheable) {
+    pthread_mutex_lock(&cache_mutex);
+    struct CacheEntry *e = &cache[cache_next];
+    cache_next = (cache_next + 1) % NET_CACHE_SIZE;
+    strcpy(e->host, key);
+    strcpy(e->port, port);
+    e->socktype = socktype;
+    e->family = family;
+    e->expires = now + NET_CACHE_TTL;
+    e->count = count;
+    memcpy(e->addrs, found, count * sizeof(struct NetAddr));
+    pthread_mutex_unlock(&cache_mutex);
+  }
+
+  int n = count < max ? count : max;
+  memcpy(addrs, found, n * sizeof(struct NetAddr));
+  return n;
+}
+
+int NetConnectAddr(const struct NetAddr *addr, int socktype) {
+  int fd = socket(addr->ss.ss_family, socktype, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, (const struct sockaddr *)&addr->ss, addr->len) < 0) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return -1;
+  }
+  return fd;
+}
+
+int NetConnect(const char *host, const char *port, int socktype, int family) {
+  struct NetAddr addrs[NET_MAX_ADDRS];
+  int n = NetResolve(host, port, socktype, family, addrs, NET_MAX_ADDRS);
+  if (n < 0) {
+    fprintf(stderr, "Can not resolve %s:%s: %s\n", host, port, gai_strerror(n));
+    errno = EHOSTUNREACH;
+    return -1;
+  }
+  for (int i = 0; i < n; i++) {
+    int fd = NetConnectAddr(&addrs[i], socktype);
+    if (fd >= 0) return fd;
+  }
+  return -1;
+}
+
+int NetListen(const char *host, const char *port, int socktype, int family,
+              int backlog, int flags) {
+  struct NetAddr addr;
+  // Двухстековый сокет - это IPv6 на "::"; его и просим при NET_ANY
+  int lookup = family == NET_ANY && host == NULL ? NET_IPV6 : family;
+  int n = NetResolve(host, port, socktype, lookup, &addr, 1);
+  if (n < 0 && lookup != family) n = NetResolve(host, port, socktype, family, &addr, 1);
+  if (n < 0) {
+    fprintf(stderr, "Can not resolve %s:%s: %s\n", host != NULL ? host : "*", port,
+            gai_strerror(n));
+    return -1;
+  }
+
+  int fd = socket(addr.ss.ss_family, socktype, 0);
+  if (fd < 0 && addr.ss.ss_family == AF_INET6 && family == NET_ANY && host == NULL) {
+    // Ядро без IPv6 - слушаем только IPv4
+    n = NetResolve(NULL, port, socktype, NET_IPV4, &addr, 1);
+    if (n > 0) fd = socket(AF_INET, socktype, 0);
+  }
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  int one = 1;
+  if ((flags & NET_REUSEADDR) &&
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) {
+    perror("setsockopt SO_REUSEADDR");
+    close(fd);
+    return -1;
+  }
+  if ((flags & NET_REUSEPORT) &&
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+    perror("setsockopt SO_REUSEPORT");
+    close(fd);
+    return -1;
+  }
+  if (addr.ss.ss_family == AF_INET6) {
+    // Значение по умолчанию задает sysctl bindv6only - выставляем явно
+    int v6only = family == NET_IPV6;
+    if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) < 0) {
+      perror("setsockopt IPV6_V6ONLY");
+      close(fd);
+      return -1;
+    }
+  }
+
+  if (bind(fd, (struct sockaddr *)&addr.ss, addr.len) < 0) {
+    perror("bind");
+    close(fd);
+    return -1;
+  }
+  if (socktype == SOCK_STREAM && listen(fd, backlog) < 0) {
+    perror("listen");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int NetTune(int fd, int flags, int busy_poll_us) {
+  int one = 1;
+  int status = 0;
+  int saved = 0;
+  if ((flags & NET_NODELAY) &&
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+    status = -1;
+    saved = errno;
+  }
+  if ((flags & NET_QUICKACK) &&
+      setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one)) < 0) {
+    status = -1;
+    saved = errno;
+  }
+  if ((flags & NET_BUSY_POLL) &&
+      setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) < 0) {
+    status = -1;
+    saved = errno;
+  }
+  if (status < 0) errno = saved;
+  return status;
+}
+
+const char *NetFormat(const struct sockaddr *addr, char *buf, size_t len) {
+  char ip[INET6_ADDRSTRLEN] = "?";
+  if (addr->sa_family == AF_INET) {
+    const struct sockaddr_in *in = (const struct sockaddr_in *)addr;
+    inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip));
+    snprintf(buf, len, "%s:%d", ip, ntohs(in->sin_port));
+  } else if (addr->sa_family == AF_INET6) {
+    const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)addr;
+    if (IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr)) {
+      inet_ntop(AF_INET, &in6->sin6_addr.s6_addr[12], ip, sizeof(ip));
+      snprintf(buf, len, "%s:%d", ip, ntohs(in6->sin6_port));
+    } else {
+      inet_ntop(AF_INET6, &in6->sin6_addr, ip, sizeof(ip));
+      snprintf(buf, len, "[%s]:%d", ip, ntohs(in6->sin6_port));
+    }
+  } else {
+    snprintf(buf, len, "?");
+  }
+  return buf;
+}
+
+int NetSameAddr(const struct sockaddr *a, const struct sockaddr *b) {
+  if (a->sa_family != b->sa_family) return 0;
+  if (a->sa_family == AF_INET) {
+    const struct sockaddr_in *x = (const struct sockaddr_in *)a;
+    const struct sockaddr_in *y = (const struct sockaddr_in *)b;
+    return x->sin_port == y->sin_port && x->sin_addr.s_addr == y->sin_addr.s_addr;
+  }
+  if (a->sa_family == AF_INET6) {
+    const struct sockaddr_in6 *x = (const struct sockaddr_in6 *)a;
+    const struct sockaddr_in6 *y = (const struct sockaddr_in6 *)b;
+    return x->sin6_port == y->sin6_port &&
+           memcmp(&x->sin6_addr, &y->sin6_addr, sizeof(x->sin6_addr)) == 0;
+  }
+  return 0;
+}
+
+void NetRaiseFileLimit(void) {
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+}
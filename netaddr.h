@@ -0,0 +1,79 @@
+#ifndef NETADDR_H
+#define NETADDR_H
+
+#include <stddef.h>
+#include <sys/socket.h>
+
+/*
+ * Адреса и сокеты для сетевых лабораторных без привязки к семейству.
+ * Имена и адреса разрешаются через getaddrinfo, результат кешируется на
+ * NET_CACHE_TTL секунд, так что многократные подключения к одному узлу
+ * не ходят в DNS. Слушающий сокет по умолчанию двухстековый: IPv6 с
+ * IPV6_V6ONLY = 0 принимает и IPv4-клиентов (адреса вида ::ffff:a.b.c.d);
+ * если IPv6 в системе нет, используется IPv4. Опции производительности
+ * сокета задаются в одном месте - NetTune.
+ */
+
+#define NET_CACHE_TTL 30
+// Сколько адресов узла запоминается и перебирается при подключении
+#define NET_MAX_ADDRS 8
+// "[адрес IPv6]:порт" с запасом
+#define NET_ADDRSTRLEN 64
+
+enum NetFamily { NET_ANY, NET_IPV4, NET_IPV6 };
+
+struct NetAddr {
+  struct sockaddr_storage ss;
+  socklen_t len;
+};
+
+// Флаги NetListen
+#define NET_REUSEADDR 1
+#define NET_REUSEPORT 2
+
+// Флаги NetTune
+#define NET_NODELAY 1
+// Действует до следующего приема: в цикле запрос-ответ ставится заново
+#define NET_QUICKACK 2
+// SO_BUSY_POLL на busy_poll_us микросекунд; может потребовать CAP_NET_ADMIN
+#define NET_BUSY_POLL 4
+
+/* "any", "ipv4"/"4", "ipv6"/"6"; -1 - неизвестное значение. */
+int NetParseFamily(const char *name);
+
+/* Адреса host:port для сокетов типа socktype (SOCK_STREAM/SOCK_DGRAM),
+ * не больше max. Возвращает число адресов или код ошибки getaddrinfo
+ * (отрицательный, текст - gai_strerror). host == NULL - любой адрес. */
+int NetResolve(const char *host, const char *port, int socktype, int family,
+               struct NetAddr *addrs, int max);
+
+/* Сокет нужного адресу семейства, подключенный к нему; -1 и errno. */
+int NetConnectAddr(const struct NetAddr *addr, int socktype);
+
+/* Перебирает адреса host:port, пока подключение не удастся. -1 - не
+ * удалось ни одно (errno от последней попытки) или не разрешилось имя. */
+int NetConnect(const char *host, const char *port, int socktype, int family);
+
+/* Сокет, привязанный к host:port (host == NULL - все адреса), для
+ * SOCK_STREAM еще и слушающий с очередью backlog. NET_ANY - двухстековый.
+ * -1 и сообщение в stderr при ошибке. */
+int NetListen(const char *host, const char *port, int socktype, int family,
+              int backlog, int flags);
+
+/* Опции NET_NODELAY | NET_QUICKACK | NET_BUSY_POLL. 0 - все приняты,
+ * -1 - хотя бы одна отвергнута (errno от нее), остальные все равно
+ * выставлены. */
+int NetTune(int fd, int flags, int busy_poll_us);
+
+/* Адрес для печати: "a.b.c.d:port" или "[v6]:port". IPv4, пришедший
+ * на двухстековый сокет, печатается как IPv4. */
+const char *NetFormat(const struct sockaddr *addr, char *buf, size_t len);
+
+/* Совпадают ли адрес и порт (для UDP: от того ли пира датаграмма). */
+int NetSameAddr(const struct sockaddr *a, const struct sockaddr *b);
+
+/* Поднимает мягкий лимит открытых дескрипторов до жесткого: тысячам
+ * соединений не хватает стандартных 1024. */
+void NetRaiseFileLimit(void);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef PGO_H
+#define PGO_H
+
+/*
+ * В сборке PGO=gen (release.mk) профиль записывается при выходе из
+ * программы, а серверы останавливают сигналом. PgoDumpOnSignal ставит на
+ * SIGTERM и SIGINT обработчик, который сбрасывает профиль и завершает
+ * процесс. Обработчик есть и в сборке PGO=use, чтобы код совпадал с
+ * тренировочным; __gcov_dump там нет, поэтому ссылка слабая. Без PGO
+ * функция ничего не делает.
+ */
+
+#ifdef PGO
+#include <signal.h>
+#include <unistd.h>
+
+void __gcov_dump(void) __attribute__((weak));
+
+static void PgoDump(int sig) {
+  (void)sig;
+  if (__gcov_dump) __gcov_dump();
+  _exit(0);
+}
+
+static inline void PgoDumpOnSignal(void) {
+  signal(SIGTERM, PgoDump);
+  signal(SIGINT, PgoDump);
+}
+#else
+static inline void PgoDumpOnSignal(void) {}
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+# Сборка для замеров, общая для всех лабораторных (подключается через include
+# после CFLAGS; строки сборки и компоновки должны передавать $(CFLAGS)):
+#   make RELEASE=0           без оптимизации: -O0 поверх -O2/-O3 из
+#                            makefile, точка отсчета для замеров
+#   make RELEASE=1           -O3 и LTO
+#   make RELEASE=1 PGO=gen   то же с инструментированием: запуски программ
+#                            копят профиль в PGO_DIR
+#   make RELEASE=1 PGO=use   пересборка по накопленному профилю
+# При смене режима нужен make clean. Весь цикл - сборки, тренировка и
+# отчет об ускорении - в release.sh в корне репозитория
+
+RELEASE_ROOT := $(abspath $(dir $(lastword $(MAKEFILE_LIST))))
+PGO_DIR ?= $(RELEASE_ROOT)/_pgo
+
+# Из нескольких -O gcc берет последний
+ifeq ($(RELEASE),0)
+CFLAGS += -O0
+endif
+
+ifeq ($(RELEASE),1)
+CFLAGS += -O3 -flto=auto
+# В архивах с LTO-объектами индекс символов строит только обертка с плагином
+AR = gcc-ar
+endif
+
+# Счетчики обновляются атомарно: почти все программы многопоточные.
+# PGO включает сброс профиля по SIGTERM у серверов (pgo.h); задается в обоих
+# режимах, иначе код при тренировке и при пересборке разный и профиль не
+# подходит
+ifeq ($(PGO),gen)
+CFLAGS += -fprofile-generate -fprofile-update=atomic -fprofile-dir=$(PGO_DIR) -DPGO
+endif
+
+# Код, до которого тренировка не дошла, оптимизируется как без профиля
+ifeq ($(PGO),use)
+CFLAGS += -fprofile-use -fprofile-partial-training -fprofile-dir=$(PGO_DIR) -Wno-missing-profile -DPGO
+endif
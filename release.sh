@@ -0,0 +1,175 @@
+#!/bin/bash
+# Сборка для замеров с LTO и PGO и отчет об ускорении по программам.
+#
+# Дерево копируется в отдельный каталог (собранные программы в репозитории
+# не трогаем) и собирается по очереди:
+#   base    - make RELEASE=0: -O0 везде, точка отсчета;
+#   default - make без флагов: как собирается по умолчанию (часть
+#             makefile уже задает -O2 или -O3, остальные - без -O);
+#   release - make RELEASE=1: -O3 и LTO (release.mk);
+#   pgo     - make RELEASE=1 PGO=gen, тренировка на тех же нагрузках, что
+#             и замер, но меньшего размера, затем make RELEASE=1 PGO=use.
+# После каждой сборки, кроме инструментированной, идет замер. В конце -
+# таблица: время (ms, меньше - лучше) или пропускная способность (req/s,
+# pps - больше лучше) и ускорение default, release и pgo относительно base.
+#
+#   ./release.sh [каталог]   RUNS=3 - повторов замера, берется лучший
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+WORK=${1:-$(mktemp -d /tmp/os_lab_release.XXXXXX)}
+RUNS=${RUNS:-3}
+DIRS="compute lab3/src lab4/src lab5/src lab6/src lab7/src"
+RESULTS=$WORK/release_results.txt
+
+# Размеры замера; тренировка берет десятую часть
+ARRAY=50000000
+K=100000000
+NET_SECONDS=2
+
+mkdir -p "$WORK"
+tar -C "$ROOT" --exclude=.git -cf - . | tar -C "$WORK" -xf -
+cd "$WORK"
+: > "$RESULTS"
+
+Build() {
+  echo "== make $*"
+  for dir in $DIRS; do
+    make -s -C "$dir" clean > /dev/null 2>&1 || true
+    make -s -C "$dir" "$@" > /dev/null 2> "$WORK/build.log" || {
+      cat "$WORK/build.log"
+      exit 1
+    }
+  done
+}
+
+# Лучший из RUNS замеров: BestOf min|max команда...
+BestOf() {
+  local order=$1
+  shift
+  for i in $(seq "$RUNS"); do "$@"; done | sort -g |
+    if [ "$order" = min ]; then head -1; else tail -1; fi
+}
+
+# Время работы программы целиком, ms
+Wall() {
+  local start end
+  start=$(date +%s%N)
+  "$@" > /dev/null
+  end=$(date +%s%N)
+  awk -v ns=$((end - start)) 'BEGIN { printf "%.1f\n", ns / 1e6 }'
+}
+
+# Время, которое программа сама печатает как "Elapsed time: ...ms"
+Elapsed() {
+  "$@" | sed -n 's/^Elapsed time: \([0-9.]*\)ms$/\1/p' | awk '{ printf "%.1f\n", $1 }'
+}
+
+Port() {
+  echo $((20100 + RANDOM % 800))
+}
+
+# Запросов в секунду у сервера lab6 под loadgen с заданными аргументами
+ServerRps() {
+  local port pid
+  port=$(Port)
+  ./lab6/src/server --port "$port" --tnum 4 > /dev/null 2>&1 &
+  pid=$!
+  sleep 0.5
+  ./lab6/src/loadgen --host ::1 --port "$port" --mode closed --mod 1000000007 "$@" |
+    sed -n 's/^Throughput: \([0-9.]*\) req\/s$/\1/p'
+  kill "$pid"
+  wait "$pid" 2> /dev/null || true
+}
+
+# Датаграмм в секунду, дошедших обратно от эхо-сервера lab7
+UdpPps() {
+  local port pid
+  port=$(Port)
+  ./lab7/src/udpserver "$port" 64 --batch 64 > /dev/null 2>&1 &
+  pid=$!
+  sleep 0.3
+  ./lab7/src/udpclient 127.0.0.1 "$port" 64 --load "$1" --window 256 --sockets 8 2> /dev/null |
+    sed -n 's/.*received [0-9]* (\([0-9]*\) pps).*/\1/p'
+  kill "$pid"
+  wait "$pid" 2> /dev/null || true
+}
+
+# Нагрузки: $1 - доля размера, $2 - длительность сетевых, $3 - обертка
+# замера (для тренировки - просто запуск)
+Workloads() {
+  local div=$1 secs=$2 measure=$3
+  $measure "lab3 sequential_min_max" ms min Wall \
+    ./lab3/src/sequential_min_max 7 $((ARRAY / div))
+  $measure "lab3 parallel_min_max" ms min Elapsed \
+    ./lab3/src/parallel_min_max --seed 7 --array_size $((ARRAY / div)) --pnum 4
+  $measure "lab4 parallel_sum" ms min Elapsed \
+    ./lab4/src/parallel_sum --threads_num 4 --array_size $((ARRAY / div)) --seed 7
+  $measure "lab5 factorial, 32-bit mod" ms min Wall \
+    ./lab5/src/factorial -k $((K / div)) --pnum=4 --mod=1000000007
+  $measure "lab5 factorial, 64-bit mod" ms min Wall \
+    ./lab5/src/factorial -k $((K / div / 5)) --pnum=4 --mod=18446744073709551557
+  $measure "lab6 server, range 100000" req/s max ServerRps \
+    --conns 4 --duration "$secs" --range 100000
+  $measure "lab6 server, batch 64" req/s max ServerRps \
+    --conns 1 --duration "$secs" --batch 64 --range 1
+  $measure "lab7 udp echo, batch 64" pps max UdpPps "$secs"
+}
+
+Measure() {
+  local tool=$1 unit=$2 order=$3
+  shift 3
+  local value
+  value=$(BestOf "$order" "$@")
+  echo "$tool|$unit|$STAGE|$value" >> "$RESULTS"
+  printf "   %-28s %12s %s\n" "$tool" "$value" "$unit"
+}
+
+Train() {
+  shift 3
+  "$@" > /dev/null
+}
+
+Build RELEASE=0
+STAGE=base
+Workloads 1 "$NET_SECONDS" Measure
+
+Build
+STAGE=default
+Workloads 1 "$NET_SECONDS" Measure
+
+Build RELEASE=1
+STAGE=release
+Workloads 1 "$NET_SECONDS" Measure
+
+rm -rf _pgo
+Build RELEASE=1 PGO=gen
+echo "== training"
+Workloads 10 1 Train
+
+Build RELEASE=1 PGO=use
+STAGE=pgo
+Workloads 1 "$NET_SECONDS" Measure
+
+echo
+awk -F'|' '
+  { key = $1; if (!(key in unit)) { order[n++] = key; unit[key] = $2 } value[key, $3] = $4 }
+  function speedup(key, stage) {
+    if (value[key, "base"] == 0 || value[key, stage] == 0) return "-"
+    if (unit[key] == "ms") return sprintf("%.2fx", value[key, "base"] / value[key, stage])
+    return sprintf("%.2fx", value[key, stage] / value[key, "base"])
+  }
+  END {
+    print "base: -O0 everywhere; default: plain make; speedups are relative to base"
+    printf "%-28s %-6s %12s %12s %12s %12s %8s %8s %8s\n", "tool", "unit", "base", "default",
+           "release", "pgo", "default", "release", "pgo"
+    for (i = 0; i < n; i++) {
+      key = order[i]
+      printf "%-28s %-6s %12s %12s %12s %12s %8s %8s %8s\n", key, unit[key], value[key, "base"],
+             value[key, "default"], value[key, "release"], value[key, "pgo"],
+             speedup(key, "default"), speedup(key, "release"), speedup(key, "pgo")
+    }
+  }' "$RESULTS"
+echo
+echo "Release binaries (PGO): $WORK"
@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include "supervisor.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+// Сколько событий забирается одним epoll_wait
+#define SUPERVISOR_BATCH 256
+
+// Живые потомки еще и в двусвязном списке - чтобы SupervisorDestroy
+// закрыл их pidfd
+struct Child {
+  pid_t pid;
+  int pidfd;
+  void *data;
+  uint64_t added_ns;
+  struct Child *prev;
+  struct Child *next;
+};
+
+struct Supervisor {
+  int epfd;
+  size_t live;
+  struct Child *children;
+  SupervisorExitFn on_exit;
+  void *arg;
+};
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+struct Supervisor *SupervisorCreate(SupervisorExitFn on_exit, void *arg) {
+  struct Supervisor *s = calloc(1, sizeof(*s));
+  if (s == NULL) return NULL;
+  s->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (s->epfd == -1) {
+    free(s);
+    return NULL;
+  }
+  s->on_exit = on_exit;
+  s->arg = arg;
+
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  return s;
+}
+
+int SupervisorAdd(struct Supervisor *s, pid_t pid, void *data) {
+  struct Child *child = malloc(sizeof(*child));
+  if (child == NULL) return -1;
+  child->pid = pid;
+  child->data = data;
+  child->added_ns = NowNs();
+  child->pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+  if (child->pidfd == -1) {
+    free(child);
+    return -1;
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = child;
+  if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, child->pidfd, &ev) == -1) {
+    int error = errno;
+    close(child->pidfd);
+    free(child);
+    errno = error;
+    return -1;
+  }
+  child->prev = NULL;
+  child->next = s->children;
+  if (s->children != NULL) s->children->prev = child;
+  s->children = child;
+  s->live++;
+  return 0;
+}
+
+static void Forget(struct Supervisor *s, struct Child *child) {
+  if (child->prev != NULL)
+    child->prev->next = child->next;
+  else
+    s->children = child->next;
+  if (child->next != NULL) child->next->prev = child->prev;
+  // Одного close мало: копия pidfd, унаследованная потомками через fork,
+  // держит регистрацию в epoll, и событие пришло бы на освобожденную память
+  epoll_ctl(s->epfd, EPOLL_CTL_DEL, child->pidfd, NULL);
+  close(child->pidfd);
+  s->live--;
+}
+
+// pidfd готов к чтению, когда процесс завершился, так что wait4 по его
+// pid не ждет и не перебирает остальных детей
+static int Reap(struct Supervisor *s, struct Child *child) {
+  struct ChildExit info;
+  struct rusage ru;
+  pid_t pid;
+  while ((pid = wait4(child->pid, &info.status, WNOHANG, &ru)) == -1 && errno == EINTR) {
+  }
+  if (pid == 0) return 0;
+
+  Forget(s, child);
+  if (pid == -1) {
+    // Потомка собрали в обход супервизора - статуса уже нет
+    free(child);
+    return 0;
+  }
+
+  info.pid = pid;
+  info.data = child->data;
+  info.user_ms = ru.ru_utime.tv_sec * 1000.0 + ru.ru_utime.tv_usec / 1000.0;
+  info.sys_ms = ru.ru_stime.tv_sec * 1000.0 + ru.ru_stime.tv_usec / 1000.0;
+  info.max_rss_kb = ru.ru_maxrss;
+  info.voluntary_switches = ru.ru_nvcsw;
+  info.involuntary_switches = ru.ru_nivcsw;
+  info.lifetime_ns = NowNs() - child->added_ns;
+  free(child);
+  if (s->on_exit != NULL) s->on_exit(&info, s->arg);
+  return 1;
+}
+
+int SupervisorWait(struct Supervisor *s, int timeout_ms) {
+  struct epoll_event events[SUPERVISOR_BATCH];
+  int n = epoll_wait(s->epfd, events, SUPERVISOR_BATCH, timeout_ms);
+  if (n == -1) return -1;
+
+  int reaped = 0;
+  for (int i = 0; i < n; i++) reaped += Reap(s, events[i].data.ptr);
+  return reaped;
+}
+
+size_t SupervisorLive(const struct Supervisor *s) {
+  return s->live;
+}
+
+int SupervisorFd(const struct Supervisor *s) {
+  return s->epfd;
+}
+
+void SupervisorDestroy(struct Supervisor *s) {
+  if (s == NULL) return;
+  while (s->children != NULL) {
+    struct Child *child = s->children;
+    Forget(s, child);
+    free(child);
+  }
+  close(s->epfd);
+  free(s);
+}
+
+void SupervisorPrintExit(FILE *out, const struct ChildExit *info) {
+  if (WIFEXITED(info->status))
+    fprintf(out, "pid %d: exit %d", info->pid, WEXITSTATUS(info->status));
+  else if (WIFSIGNALED(info->status))
+    fprintf(out, "pid %d: signal %d", info->pid, WTERMSIG(info->status));
+  else
+    fprintf(out, "pid %d: status 0x%x", info->pid, info->status);
+  fprintf(out, ", user %.2f ms, sys %.2f ms, max rss %ld KB, csw %ld/%ld, lived %.2f ms\n",
+          info->user_ms, info->sys_ms, info->max_rss_kb, info->voluntary_switches,
+          info->involuntary_switches, info->lifetime_ns / 1e6);
+}
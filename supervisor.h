@@ -0,0 +1,57 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Сборщик потомков: на каждого заводится pidfd в общем epoll, и потомок
+ * собирается, как только завершится, - без опроса и без wait(-1), который
+ * в ядре перебирает весь список детей. Поэтому цена сбора не зависит от
+ * того, сколько потомков еще живо. Вместе со статусом отдается rusage.
+ *
+ * Собирать потомков, отданных супервизору, в обход него (wait, waitpid)
+ * нельзя: pid освободится, а pidfd останется.
+ */
+
+struct ChildExit {
+  pid_t pid;
+  void *data;               /* то, что передали в SupervisorAdd */
+  int status;               /* как у waitpid */
+  double user_ms;
+  double sys_ms;
+  long max_rss_kb;
+  long voluntary_switches;
+  long involuntary_switches;
+  uint64_t lifetime_ns;     /* от SupervisorAdd до сбора */
+};
+
+typedef void (*SupervisorExitFn)(const struct ChildExit *info, void *arg);
+
+struct Supervisor;
+
+/* on_exit вызывается на каждого собранного потомка внутри SupervisorWait.
+ * Поднимает мягкий лимит открытых файлов до жесткого - по fd на потомка. */
+struct Supervisor *SupervisorCreate(SupervisorExitFn on_exit, void *arg);
+
+/* Берет потомка pid под надзор; 0 или -1 с errno. */
+int SupervisorAdd(struct Supervisor *s, pid_t pid, void *data);
+
+/* Ждет до timeout_ms (-1 - без срока) и собирает всех завершившихся.
+ * Возвращает их число или -1 с errno (EINTR - пришел сигнал). */
+int SupervisorWait(struct Supervisor *s, int timeout_ms);
+
+size_t SupervisorLive(const struct Supervisor *s);
+
+/* epoll-дескриптор: его можно добавить в свой цикл событий и звать
+ * SupervisorWait(s, 0), когда он готов. */
+int SupervisorFd(const struct Supervisor *s);
+
+/* Закрывает pidfd; несобранные потомки остаются зомби до выхода. */
+void SupervisorDestroy(struct Supervisor *s);
+
+void SupervisorPrintExit(FILE *out, const struct ChildExit *info);
+
+#endif